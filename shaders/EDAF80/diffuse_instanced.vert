@@ -0,0 +1,33 @@
+#version 410
+
+// Same as diffuse.vert, except that each instance comes with its own
+// transform and colour, read from attributes advancing once per instance
+// rather than once per vertex (see bonobo::instancing). The transform of
+// the instance is applied first, followed by the one of the node.
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+layout (location = 7) in mat4 instance_model_to_world;
+layout (location = 11) in mat3 instance_normal_model_to_world;
+layout (location = 14) in vec4 instance_diffuse_colour;
+
+uniform mat4 vertex_model_to_world;
+uniform mat4 normal_model_to_world;
+uniform mat4 vertex_world_to_clip;
+
+out VS_OUT {
+	vec3 vertex;
+	vec3 normal;
+	vec4 colour;
+} vs_out;
+
+
+void main()
+{
+	vec4 world_vertex = vertex_model_to_world * instance_model_to_world * vec4(vertex, 1.0);
+
+	vs_out.vertex = vec3(world_vertex);
+	vs_out.normal = vec3(normal_model_to_world * vec4(instance_normal_model_to_world * normal, 0.0));
+	vs_out.colour = instance_diffuse_colour;
+
+	gl_Position = vertex_world_to_clip * world_vertex;
+}
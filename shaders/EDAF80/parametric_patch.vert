@@ -0,0 +1,16 @@
+#version 410
+
+// The vertices of the patches only carry their (u, v) coordinates within the
+// parametric domain; the surface itself is only evaluated in
+// parametric_patch.tese, once the patches have been tessellated.
+layout (location = 0) in vec3 vertex;
+
+out VS_OUT {
+	vec2 uv;
+} vs_out;
+
+
+void main()
+{
+	vs_out.uv = vertex.xy;
+}
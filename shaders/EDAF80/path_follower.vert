@@ -0,0 +1,76 @@
+#version 410
+
+// One instance per follower: its position along the path only depends on
+// gl_InstanceID and on the distance travelled by the whole crowd, and its
+// orientation on the tangent of the path at that position.
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+
+uniform samplerBuffer path_coefficients; // four RGB coefficients per segment, the k-th one going with x^k
+uniform samplerBuffer path_parameters;   // curve parameter at regularly spaced distances along the path
+uniform int path_segments_nb;
+uniform float path_length;
+
+uniform float travelled_distance;
+uniform float followers_spacing;
+uniform float lane_radius;
+uniform vec3 follower_scale;
+
+uniform mat4 vertex_world_to_clip;
+
+// Same interface as EDAF80/diffuse.vert, so that EDAF80/diffuse.frag can be
+// used for shading.
+out VS_OUT {
+	vec3 vertex;
+	vec3 normal;
+} vs_out;
+
+uint hash(uint x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+void main()
+{
+	// Distance to curve parameter, by interpolating between the two
+	// closest table entries.
+	float distance = mod(travelled_distance + float(gl_InstanceID) * followers_spacing, path_length);
+	int samples_nb = textureSize(path_parameters);
+	float sample_position = distance / path_length * float(samples_nb - 1);
+	int sample_index = min(int(sample_position), samples_nb - 2);
+	float parameter = mix(texelFetch(path_parameters, sample_index).r,
+	                      texelFetch(path_parameters, sample_index + 1).r,
+	                      sample_position - float(sample_index));
+
+	int segment = clamp(int(parameter), 0, path_segments_nb - 1);
+	float x = parameter - float(segment);
+	vec3 c0 = texelFetch(path_coefficients, 4 * segment + 0).xyz;
+	vec3 c1 = texelFetch(path_coefficients, 4 * segment + 1).xyz;
+	vec3 c2 = texelFetch(path_coefficients, 4 * segment + 2).xyz;
+	vec3 c3 = texelFetch(path_coefficients, 4 * segment + 3).xyz;
+	vec3 position = ((c3 * x + c2) * x + c1) * x + c0;
+	vec3 tangent = (3.0 * c3 * x + 2.0 * c2) * x + c1;
+
+	// Frame following the path, with the model z axis along the tangent.
+	vec3 forward = normalize(tangent);
+	vec3 up = abs(forward.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 right = normalize(cross(up, forward));
+	up = cross(forward, right);
+	mat3 model_to_world = mat3(right, up, forward);
+
+	// Spread the followers uniformly within a disc around the path.
+	uint random = hash(uint(gl_InstanceID));
+	float angle = float(random & 0xFFFFu) * (6.28318530718 / 65536.0);
+	float radius = lane_radius * sqrt(float(random >> 16) / 65536.0);
+	position += radius * (cos(angle) * right + sin(angle) * up);
+
+	vs_out.vertex = position + model_to_world * (follower_scale * vertex);
+	vs_out.normal = model_to_world * (normal / follower_scale);
+
+	gl_Position = vertex_world_to_clip * vec4(vs_out.vertex, 1.0);
+}
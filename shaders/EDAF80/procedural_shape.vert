@@ -0,0 +1,68 @@
+#version 410
+
+// No vertex attributes are used: each instance covers one row of the
+// parametric domain, and each group of six vertices within it one cell,
+// split into two triangles. The surface is then evaluated from the resulting
+// (u, v) coordinates and the parameters below.
+layout (std140) uniform ProceduralShape {
+	vec4 parameters; // see parametric_shapes::surface_type
+	int type;
+	int u_segments;
+	int v_segments;
+} shape;
+
+uniform mat4 vertex_model_to_world;
+uniform mat4 normal_model_to_world;
+uniform mat4 vertex_world_to_clip;
+
+// Same output as diffuse.vert, so that diffuse.frag can be reused as is.
+out VS_OUT {
+	vec3 vertex;
+	vec3 normal;
+} vs_out;
+
+const float pi = 3.14159265359;
+
+// Same triangles as the ones built by the CPU generators.
+const vec2 cell_corners[6] = vec2[6](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                                     vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+// Has to be kept in sync with evaluate_surface() in parametric_patch.tese.
+void evaluate_surface(vec2 uv, out vec3 position, out vec3 normal)
+{
+	if (shape.type == 1) { // sphere
+		float theta = 2.0 * pi * uv.x;
+		float phi = pi * uv.y;
+		normal = vec3(sin(theta) * sin(phi), -cos(phi), cos(theta) * sin(phi));
+		position = shape.parameters.x * normal;
+	} else if (shape.type == 2) { // torus
+		float theta = 2.0 * pi * uv.x;
+		float phi = 2.0 * pi * uv.y;
+		vec3 centre = shape.parameters.x * vec3(sin(theta), 0.0, cos(theta));
+		normal = vec3(cos(phi) * sin(theta), sin(phi), cos(phi) * cos(theta));
+		position = centre + shape.parameters.y * normal;
+	} else if (shape.type == 3) { // circle ring
+		float theta = 2.0 * pi * uv.y;
+		float distance_to_centre = shape.parameters.x + (uv.x - 0.5) * shape.parameters.y;
+		normal = vec3(0.0, 0.0, 1.0);
+		position = distance_to_centre * vec3(cos(theta), sin(theta), 0.0);
+	} else { // quad
+		normal = vec3(0.0, 1.0, 0.0);
+		position = vec3(uv.x * shape.parameters.x, 0.0, uv.y * shape.parameters.y);
+	}
+}
+
+void main()
+{
+	vec2 corner = cell_corners[gl_VertexID % 6];
+	vec2 uv = vec2((float(gl_VertexID / 6) + corner.x) / float(shape.u_segments),
+	               (float(gl_InstanceID) + corner.y) / float(shape.v_segments));
+
+	vec3 position, normal;
+	evaluate_surface(uv, position, normal);
+
+	vs_out.vertex = vec3(vertex_model_to_world * vec4(position, 1.0));
+	vs_out.normal = vec3(normal_model_to_world * vec4(normal, 0.0));
+
+	gl_Position = vertex_world_to_clip * vec4(vs_out.vertex, 1.0);
+}
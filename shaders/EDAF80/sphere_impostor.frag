@@ -0,0 +1,68 @@
+#version 410
+
+uniform mat4 vertex_world_to_clip;
+uniform vec3 camera_position;
+uniform sampler2D diffuse_texture;
+uniform int has_diffuse_texture;
+
+in VS_OUT {
+	vec3 world_position;
+	flat vec4 centre_radius;
+	flat vec4 orientation;
+} fs_in;
+
+out vec4 frag_color;
+
+const float pi = 3.14159265359;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+	vec3 centre = fs_in.centre_radius.xyz;
+	float radius = fs_in.centre_radius.w;
+
+	// Closest intersection between the view ray and the sphere.
+	vec3 ray = normalize(fs_in.world_position - camera_position);
+	vec3 centre_to_camera = camera_position - centre;
+	float b = dot(centre_to_camera, ray);
+	float c = dot(centre_to_camera, centre_to_camera) - radius * radius;
+	float discriminant = b * b - c;
+	bool is_hit = discriminant >= 0.0;
+
+	// Keep going on misses, clamping to the silhouette, as the texture
+	// coordinates derivatives need the neighbouring pixels to still be
+	// running; those fragments get discarded at the end.
+	float t = -b - sqrt(max(discriminant, 0.0));
+	vec3 world_hit = camera_position + t * ray;
+	vec3 world_normal = normalize(world_hit - centre);
+
+	vec4 clip_hit = vertex_world_to_clip * vec4(world_hit, 1.0);
+	gl_FragDepth = 0.5 * (clip_hit.z / clip_hit.w) + 0.5;
+
+	// Same parameterisation as parametric_shapes::createSphere(), where
+	// the model space normal is (sin θ sin φ, -cos φ, cos θ sin φ).
+	vec4 inverse_orientation = vec4(-fs_in.orientation.xyz, fs_in.orientation.w);
+	vec3 normal = rotate(inverse_orientation, world_normal);
+	float theta = atan(normal.x, normal.z);
+	float phi = acos(clamp(-normal.y, -1.0, 1.0));
+
+	// u jumps from 1 back to 0 where θ wraps around, which would make
+	// the derivatives explode and pick the smallest mip level along the
+	// seam; a second u, wrapping on the opposite side, is used there.
+	float u_seam_at_back = fract(theta / (2.0 * pi));
+	float u_seam_at_front = fract(theta / (2.0 * pi) + 0.5) - 0.5;
+	float u = fwidth(u_seam_at_back) <= fwidth(u_seam_at_front) ? u_seam_at_back : u_seam_at_front;
+	vec2 texcoord = vec2(u, phi / pi);
+
+	if (has_diffuse_texture != 0)
+		frag_color = texture(diffuse_texture, texcoord);
+	else
+		frag_color = vec4(1.0);
+
+	if (!is_hit)
+		discard;
+}
@@ -0,0 +1,52 @@
+#version 410
+
+// One instance per sphere; the four corners of its quad are derived from
+// gl_VertexID, and drawn as a triangle strip.
+layout (location = 0) in vec4 centre_radius;
+layout (location = 1) in vec4 orientation; // model to world, as a quaternion
+
+uniform mat4 vertex_world_to_clip;
+uniform vec3 camera_position;
+
+out VS_OUT {
+	vec3 world_position;
+	flat vec4 centre_radius;
+	flat vec4 orientation;
+} vs_out;
+
+const vec2 corners[4] = vec2[4](vec2(-1.0, -1.0), vec2(1.0, -1.0),
+                                vec2(-1.0,  1.0), vec2(1.0,  1.0));
+
+void main()
+{
+	vec3 centre = centre_radius.xyz;
+	float radius = centre_radius.w;
+
+	vs_out.centre_radius = centre_radius;
+	vs_out.orientation = orientation;
+
+	vec3 to_camera = camera_position - centre;
+	float distance_squared = dot(to_camera, to_camera);
+	float radius_squared = radius * radius;
+	// Spheres containing the camera are not drawn: collapse the quad.
+	if (distance_squared <= radius_squared) {
+		vs_out.world_position = centre;
+		gl_Position = vec4(0.0);
+		return;
+	}
+
+	// The quad faces the camera and goes through the centre of the
+	// sphere. Under perspective, the silhouette of the sphere is larger
+	// than its radius: the quad has to cover the cone of rays tangent to
+	// the sphere, whose radius at the centre is r * d / sqrt(d² - r²).
+	vec3 forward = to_camera * inversesqrt(distance_squared);
+	vec3 up = abs(forward.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 right = normalize(cross(up, forward));
+	up = cross(forward, right);
+	float half_size = radius * sqrt(distance_squared / (distance_squared - radius_squared));
+
+	vec2 corner = corners[gl_VertexID];
+	vs_out.world_position = centre + half_size * (corner.x * right + corner.y * up);
+
+	gl_Position = vertex_world_to_clip * vec4(vs_out.world_position, 1.0);
+}
@@ -1,13 +1,20 @@
 #version 410
 
-uniform bool has_diffuse_texture;
-uniform bool has_specular_texture;
-uniform bool has_normals_texture;
-uniform bool has_opacity_texture;
-uniform sampler2D diffuse_texture;
-uniform sampler2D specular_texture;
-uniform sampler2D normals_texture;
-uniform sampler2D opacity_texture;
+struct Material {
+	vec4 diffuse_opacity;
+	vec4 specular_shininess;
+	vec4 ambient_index_of_refraction;
+	vec4 emissive;
+	uvec4 texture_flags; // x: has diffuse (1), specular (2), normals (4), opacity (8) textures
+	uvec4 texture_layers; // diffuse, specular, normals and opacity layers, as (array << 16) | layer
+};
+layout (std140) uniform Materials {
+	Material materials[128];
+};
+uniform int material_index;
+// Diffuse colour and opacity mask are packed together in RGBA, as are
+// normal XY and specular intensity in RGB.
+uniform sampler2DArray texture_arrays[8];
 uniform mat4 normal_model_to_world;
 
 in VS_OUT {
@@ -21,22 +28,46 @@ layout (location = 0) out vec4 geometry_diffuse;
 layout (location = 1) out vec4 geometry_specular;
 layout (location = 2) out vec4 geometry_normal;
 
+// The index only depends on uniforms, which makes it dynamically uniform
+// as required to index an array of samplers.
+vec4 sampleLayer(uint texture_layer, vec2 texcoord)
+{
+	return texture(texture_arrays[texture_layer >> 16u], vec3(texcoord, float(texture_layer & 0xFFFFu)));
+}
 
 void main()
 {
-	if (has_opacity_texture && texture(opacity_texture, fs_in.texcoord).r < 1.0)
+	uint texture_flags = materials[material_index].texture_flags.x;
+	bool has_diffuse_texture = (texture_flags & 1u) != 0u;
+	bool has_specular_texture = (texture_flags & 2u) != 0u;
+	bool has_normals_texture = (texture_flags & 4u) != 0u;
+	bool has_opacity_texture = (texture_flags & 8u) != 0u;
+
+	uvec4 texture_layers = materials[material_index].texture_layers;
+
+	vec4 diffuse_opacity = vec4(0.0, 0.0, 0.0, 1.0);
+	if (has_diffuse_texture || has_opacity_texture)
+		diffuse_opacity = sampleLayer(has_diffuse_texture ? texture_layers.x : texture_layers.w, fs_in.texcoord);
+
+	if (has_opacity_texture && diffuse_opacity.a < 1.0)
 		discard;
 
+	vec4 normals_specular = vec4(0.5, 0.5, 0.0, 1.0);
+	if (has_normals_texture || has_specular_texture)
+		normals_specular = sampleLayer(has_normals_texture ? texture_layers.z : texture_layers.y, fs_in.texcoord);
+
 	// Diffuse color
 	geometry_diffuse = vec4(0.0f);
 	if (has_diffuse_texture)
-		geometry_diffuse = texture(diffuse_texture, fs_in.texcoord);
+		geometry_diffuse = vec4(diffuse_opacity.rgb, 1.0);
 
 	// Specular color
 	geometry_specular = vec4(0.0f);
 	if (has_specular_texture)
-		geometry_specular = texture(specular_texture, fs_in.texcoord);
+		geometry_specular = vec4(vec3(normals_specular.b), 1.0);
 
 	// Worldspace normal
+	// The tangent-space normal only stores X and Y (in [0,1]); Z can be
+	// reconstructed as sqrt(1 - dot(xy, xy)) once XY is remapped to [-1,1].
 	geometry_normal.xyz = vec3(0.0);
 }
@@ -0,0 +1,65 @@
+#version 410
+
+// Same as fill_gbuffer.vert, with the vertices first moved by up to four
+// joints; see src/core/skinning.hpp for the layout of the palettes.
+
+struct ViewProjTransforms
+{
+	mat4 view_projection;
+	mat4 view_projection_inverse;
+};
+
+layout (std140) uniform CameraViewProjTransforms
+{
+	ViewProjTransforms camera;
+};
+
+uniform mat4 vertex_model_to_world;
+uniform samplerBuffer joint_palettes;
+uniform int palette_offset;
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec3 texcoord;
+layout (location = 3) in vec3 tangent;
+layout (location = 4) in vec3 binormal;
+layout (location = 5) in uvec4 joint_indices;
+layout (location = 6) in vec4 joint_weights;
+
+out VS_OUT {
+	vec3 normal;
+	vec2 texcoord;
+	vec3 tangent;
+	vec3 binormal;
+} vs_out;
+
+
+// Blend the rows of the affine transforms of the influencing joints.
+void getSkinningRows(out vec4 row0, out vec4 row1, out vec4 row2)
+{
+	row0 = vec4(0.0);
+	row1 = vec4(0.0);
+	row2 = vec4(0.0);
+	for (int i = 0; i < 4; ++i) {
+		int base = 3 * (palette_offset + int(joint_indices[i]));
+		row0 += joint_weights[i] * texelFetch(joint_palettes, base + 0);
+		row1 += joint_weights[i] * texelFetch(joint_palettes, base + 1);
+		row2 += joint_weights[i] * texelFetch(joint_palettes, base + 2);
+	}
+}
+
+void main() {
+	vec4 row0, row1, row2;
+	getSkinningRows(row0, row1, row2);
+	vec4 skinned_vertex = vec4(dot(row0, vec4(vertex, 1.0)), dot(row1, vec4(vertex, 1.0)), dot(row2, vec4(vertex, 1.0)), 1.0);
+	vec3 skinned_normal = vec3(dot(row0.xyz, normal), dot(row1.xyz, normal), dot(row2.xyz, normal));
+	vec3 skinned_tangent = vec3(dot(row0.xyz, tangent), dot(row1.xyz, tangent), dot(row2.xyz, tangent));
+	vec3 skinned_binormal = vec3(dot(row0.xyz, binormal), dot(row1.xyz, binormal), dot(row2.xyz, binormal));
+
+	vs_out.normal   = normalize(skinned_normal);
+	vs_out.texcoord = texcoord.xy;
+	vs_out.tangent  = normalize(skinned_tangent);
+	vs_out.binormal = normalize(skinned_binormal);
+
+	gl_Position = camera.view_projection * vertex_model_to_world * skinned_vertex;
+}
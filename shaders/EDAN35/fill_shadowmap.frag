@@ -1,14 +1,32 @@
 #version 410
 
-uniform bool has_opacity_texture;
-uniform sampler2D opacity_texture;
+struct Material {
+	vec4 diffuse_opacity;
+	vec4 specular_shininess;
+	vec4 ambient_index_of_refraction;
+	vec4 emissive;
+	uvec4 texture_flags; // x: has diffuse (1), specular (2), normals (4), opacity (8) textures
+	uvec4 texture_layers; // diffuse, specular, normals and opacity layers, as (array << 16) | layer
+};
+layout (std140) uniform Materials {
+	Material materials[128];
+};
+uniform int material_index;
+uniform sampler2DArray texture_arrays[8]; // diffuse colour in RGB, opacity mask in A
 
 in VS_OUT {
 	vec2 texcoord;
 } fs_in;
 
+// See fill_gbuffer.frag.
+vec4 sampleLayer(uint texture_layer, vec2 texcoord)
+{
+	return texture(texture_arrays[texture_layer >> 16u], vec3(texcoord, float(texture_layer & 0xFFFFu)));
+}
+
 void main()
 {
-	if (has_opacity_texture && texture(opacity_texture, fs_in.texcoord).r < 1.0)
+	bool has_opacity_texture = (materials[material_index].texture_flags.x & 8u) != 0u;
+	if (has_opacity_texture && sampleLayer(materials[material_index].texture_layers.w, fs_in.texcoord).a < 1.0)
 		discard;
 }
@@ -0,0 +1,46 @@
+#version 410
+
+// Same as fill_shadowmap.vert, with the vertices first moved by up to four
+// joints; see src/core/skinning.hpp for the layout of the palettes.
+
+struct ViewProjTransforms
+{
+	mat4 view_projection;
+	mat4 view_projection_inverse;
+};
+
+layout (std140) uniform LightViewProjTransforms
+{
+	ViewProjTransforms lights[4];
+};
+
+uniform int light_index;
+uniform mat4 vertex_model_to_world;
+uniform samplerBuffer joint_palettes;
+uniform int palette_offset;
+
+layout (location = 0) in vec3 vertex;
+layout (location = 2) in vec3 texcoord;
+layout (location = 5) in uvec4 joint_indices;
+layout (location = 6) in vec4 joint_weights;
+
+out VS_OUT {
+	vec2 texcoord;
+} vs_out;
+
+void main()
+{
+	vec4 skinned_vertex = vec4(0.0);
+	for (int i = 0; i < 4; ++i) {
+		int base = 3 * (palette_offset + int(joint_indices[i]));
+		vec4 position = vec4(vertex, 1.0);
+		skinned_vertex.x += joint_weights[i] * dot(texelFetch(joint_palettes, base + 0), position);
+		skinned_vertex.y += joint_weights[i] * dot(texelFetch(joint_palettes, base + 1), position);
+		skinned_vertex.z += joint_weights[i] * dot(texelFetch(joint_palettes, base + 2), position);
+	}
+	skinned_vertex.w = 1.0;
+
+	vs_out.texcoord = texcoord.xy;
+
+	gl_Position = lights[light_index].view_projection * vertex_model_to_world * skinned_vertex;
+}
@@ -3,6 +3,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/trigonometric.hpp>
 
+#include <algorithm>
+
 #include "core/helpers.hpp"
 #include "core/Log.h"
 
@@ -10,6 +12,7 @@ CelestialBody::CelestialBody(bonobo::mesh_data const& shape,
                              GLuint const* program,
                              GLuint diffuse_texture_id)
 {
+	_body.shape = shape;
 	_body.node.set_geometry(shape);
 	_body.node.add_texture("diffuse_texture", diffuse_texture_id, GL_TEXTURE_2D);
 	_body.node.set_program(program);
@@ -18,7 +21,8 @@ CelestialBody::CelestialBody(bonobo::mesh_data const& shape,
 glm::mat4 CelestialBody::render(std::chrono::microseconds elapsed_time,
                                 glm::mat4 const& view_projection,
                                 glm::mat4 const& parent_transform,
-                                bool show_basis)
+                                bool show_basis,
+                                LODSelection const* lod_selection)
 {
 	// Convert the duration from microseconds to seconds.
 	auto const elapsed_time_s = std::chrono::duration<float>(elapsed_time).count();
@@ -35,13 +39,39 @@ glm::mat4 CelestialBody::render(std::chrono::microseconds elapsed_time,
 		bonobo::renderBasis(1.0f, 2.0f, view_projection, world);
 	}
 
-	// Note: The second argument of `node::render()` is supposed to be the
-	// parent transform of the node, not the whole world matrix, as the
-	// node internally manages its local transforms. However in our case we
-	// manage all the local transforms ourselves, so the internal transform
-	// of the node is just the identity matrix and we can forward the whole
-	// world matrix.
-	_body.node.render(view_projection, world);
+	if (_impostors != nullptr) {
+		// The impostor has to match the mesh it replaces, which gets drawn
+		// with the same world matrix.
+		auto radius = 1.0f;
+		if (_lod.lods != nullptr)
+			radius = _lod.lods->radius;
+		else if (_body.shape.bounds.is_valid)
+			radius = _body.shape.bounds.sphere_radius;
+		_impostors->push_back(sphere_impostors::makeInstance(world, radius));
+	} else {
+		if (_lod.lods != nullptr && lod_selection != nullptr && lod_selection->camera != nullptr) {
+			// The radius of the levels gets scaled like the largest axis of
+			// the world matrix.
+			auto const scale = std::max({ glm::length(glm::vec3(world[0])),
+			                              glm::length(glm::vec3(world[1])),
+			                              glm::length(glm::vec3(world[2])) });
+			auto const projected_radius = parametric_shapes::getProjectedRadius(glm::vec3(world[3]), scale * _lod.lods->radius,
+			                                                                    *lod_selection->camera, lod_selection->viewport_height);
+			auto const level = parametric_shapes::selectSphereLOD(*_lod.lods, projected_radius, lod_selection->target_edge_length);
+			if (level != _lod.level) {
+				_lod.level = level;
+				set_body_geometry(_lod.lods->levels[level]);
+			}
+		}
+
+		// Note: The second argument of `node::render()` is supposed to be the
+		// parent transform of the node, not the whole world matrix, as the
+		// node internally manages its local transforms. However in our case we
+		// manage all the local transforms ourselves, so the internal transform
+		// of the node is just the identity matrix and we can forward the whole
+		// world matrix.
+		_body.node.render(view_projection, world);
+	}
 
 	return parent_transform;
 }
@@ -76,6 +106,29 @@ void CelestialBody::set_spin(SpinConfiguration const& configuration)
 	_body.spin.rotation_angle = 0.0f;
 }
 
+void CelestialBody::set_lods(parametric_shapes::sphere_lods const* lods)
+{
+	_lod.lods = (lods != nullptr && !lods->levels.empty()) ? lods : nullptr;
+	_lod.level = 0u;
+	if (_lod.lods != nullptr)
+		set_body_geometry(_lod.lods->levels.front());
+	else
+		_body.node.set_geometry(_body.shape);
+}
+
+void CelestialBody::set_body_geometry(parametric_shapes::shared_mesh_data const& shape)
+{
+	// Levels of detail come without any material, and setting the
+	// geometry would otherwise reset the constants of the body.
+	_body.node.set_geometry(shape);
+	_body.node.set_material_constants(_body.shape.material);
+}
+
+void CelestialBody::set_impostors(std::vector<sphere_impostors::instance>* instances)
+{
+	_impostors = instances;
+}
+
 void CelestialBody::set_ring(bonobo::mesh_data const& shape,
                              GLuint const* program,
                              GLuint diffuse_texture_id,
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "parametric_shapes.hpp"
+#include "sphere_impostors.hpp"
+
+#include "core/FPSCamera.h"
 #include "core/helpers.hpp"
 #include "core/node.hpp"
 
@@ -19,6 +23,15 @@ struct OrbitConfiguration
 	float speed{0.0f};       //!< Rotation speed in radians per second.
 };
 
+//! \brief Information needed to select the level of detail of a
+//!        celestial body, see `CelestialBody::set_lods()`.
+struct LODSelection
+{
+	FPSCameraf const* camera{nullptr}; //!< Camera the main view is rendered from.
+	float viewport_height{0.0f};       //!< Height in pixels of the main view.
+	float target_edge_length{8.0f};    //!< Length in pixels that edges should have at most on screen.
+};
+
 //! \brief Represents a celestial body
 class CelestialBody
 {
@@ -44,12 +57,18 @@ public:
 	//!             local space to world space
 	//! @param [in] show_basis Show a 3D basis transformed by the world matrix
 	//!             of this celestial body
+	//! @param [in] lod_selection If levels of detail were set, select
+	//!             which one to use from how large the body appears in
+	//!             that view; passes rendering from other points of
+	//!             view, like shadow maps or picking, should leave it null
+	//!             to reuse the level selected for the main view
 	//! @return Matrix transforming from this celestial body’s local space
 	//!         to world space
 	glm::mat4 render(std::chrono::microseconds elapsed_time,
 	                 glm::mat4 const& view_projection,
 	                 glm::mat4 const& parent_transform = glm::mat4(1.0f),
-	                 bool show_basis = false);
+	                 bool show_basis = false,
+	                 LODSelection const* lod_selection = nullptr);
 
 	//! \brief Mark another celestial body as being “attached” to the current one.
 	void add_child(CelestialBody* child);
@@ -66,6 +85,25 @@ public:
 	//! \brief Configure the spin parameters for this celestial body.
 	void set_spin(SpinConfiguration const& configuration);
 
+	//! \brief Render this celestial body using one of several levels of
+	//!        detail instead of the shape given to the constructor.
+	//!
+	//! The material constants of the shape given to the constructor
+	//! keep being used with all levels.
+	//!
+	//! @param [in] lods Levels of detail to pick from, which have to
+	//!             outlive this celestial body; null to go back to using
+	//!             the shape given to the constructor
+	void set_lods(parametric_shapes::sphere_lods const* lods);
+
+	//! \brief Have `render()` append this celestial body to |instances|
+	//!        rather than drawing it, so that it can be drawn later as a
+	//!        sphere impostor along with many others.
+	//!
+	//! @param [in] instances Where to append this body, which has to
+	//!             outlive it; null to go back to drawing its mesh
+	void set_impostors(std::vector<sphere_impostors::instance>* instances);
+
 	//! \brief Default constructor for a celestial body.
 	//!
 	//! @param [in] shape Shape used for the rings.
@@ -80,6 +118,10 @@ public:
 	              glm::vec2 const& scale = glm::vec2(1.0f));
 
 private:
+	//! \brief Switch the geometry of the body's node, keeping the material
+	//!        constants of |_body.shape|.
+	void set_body_geometry(parametric_shapes::shared_mesh_data const& shape);
+
 	struct {
 		Node node;
 		struct {
@@ -94,8 +136,16 @@ private:
 			float speed{0.0f};          //!< Rotation speed in radians per second.
 			float rotation_angle{0.0f}; //!< How much has it rotated around its rotational axis; in radians.
 		} spin;
+		bonobo::mesh_data shape;
 	} _body;
 
+	struct {
+		parametric_shapes::sphere_lods const* lods{nullptr};
+		std::size_t level{0u};
+	} _lod;
+
+	std::vector<sphere_impostors::instance>* _impostors{nullptr};
+
 	struct {
 		Node node;
 		glm::vec2 scale{1.0f};
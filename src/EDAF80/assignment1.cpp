@@ -1,16 +1,21 @@
 #include "CelestialBody.hpp"
 #include "config.hpp"
 #include "parametric_shapes.hpp"
+#include "sphere_impostors.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
 #include "core/helpers.hpp"
 #include "core/node.hpp"
 #include "core/ShaderProgramManager.hpp"
+#include "core/transform_hierarchy.hpp"
 
 #include <imgui.h>
 
 #include <clocale>
+#include <cmath>
 #include <cstdlib>
+#include <random>
+#include <vector>
 
 
 int main()
@@ -62,6 +67,9 @@ int main()
 		return EXIT_FAILURE;
 	}
 	bonobo::mesh_data const& sphere = objects.front();
+	// The same sphere at several tessellation levels, so that distant
+	// bodies only cost a few dozen triangles.
+	auto const sphere_lods = parametric_shapes::createSphereLODs(1.0f);
 	auto const saturn_ring_shape = parametric_shapes::createCircleRing(0.675f, 0.45f, 80u, 8u);
 
 
@@ -93,6 +101,13 @@ int main()
 
 		return EXIT_FAILURE;
 	}
+	GLuint sphere_impostor_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Sphere Impostor",
+	                                         { { ShaderType::vertex, "EDAF80/sphere_impostor.vert" },
+	                                           { ShaderType::fragment, "EDAF80/sphere_impostor.frag" } },
+	                                         sphere_impostor_shader);
+	if (sphere_impostor_shader == 0u)
+		LogError("Failed to generate the “Sphere Impostor” shader program: impostors will not be rendered.");
 
 
 	//
@@ -159,16 +174,83 @@ int main()
 	// Set up the celestial bodies.
 	//
 	CelestialBody moon(sphere, &celestial_body_shader, moon_texture);
+	moon.set_lods(&sphere_lods);
 	moon.set_scale(glm::vec3(0.3f));
 	moon.set_spin(moon_spin);
 	moon.set_orbit({1.5f, glm::radians(-66.0f), glm::two_pi<float>() / 1.3f});
 
 	CelestialBody earth(sphere, &celestial_body_shader, earth_texture);
+	earth.set_lods(&sphere_lods);
 	earth.set_spin(earth_spin);
 	earth.set_orbit({-2.5f, glm::radians(45.0f), glm::two_pi<float>() / 10.0f});
 	earth.add_child(&moon);
 
 
+	//
+	// Set up the sphere impostors: one batch per texture, so that each
+	// texture only needs a single draw call.
+	//
+	struct ImpostorGroup
+	{
+		GLuint texture;
+		std::vector<sphere_impostors::instance> instances;
+		sphere_impostors::batch batch;
+	};
+	ImpostorGroup earth_impostors{ earth_texture, {}, sphere_impostors::createBatch() };
+	ImpostorGroup moon_impostors{ moon_texture, {}, sphere_impostors::createBatch() };
+
+	// An asteroid belt between Mars and Jupiter: each asteroid hangs off a
+	// common belt node, which slowly spins around the Sun and carries all
+	// of them along.
+	ImpostorGroup asteroid_impostors{ moon_texture, {}, sphere_impostors::createBatch() };
+	TransformHierarchy asteroid_belt;
+	auto const belt_root = asteroid_belt.add_node(TransformHierarchy::no_parent);
+	std::vector<TransformHierarchy::handle> asteroid_nodes;
+	std::vector<float> asteroid_radii;
+	{
+		auto const asteroids_nb = 20000u;
+		std::mt19937 generator(80u);
+		std::uniform_real_distribution<float> orbit_radius(8.0f, 11.0f);
+		std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+		std::normal_distribution<float> height(0.0f, 0.15f);
+		std::uniform_real_distribution<float> radius(0.005f, 0.03f);
+		asteroid_impostors.instances.reserve(asteroids_nb);
+		asteroid_nodes.reserve(asteroids_nb);
+		asteroid_radii.reserve(asteroids_nb);
+		for (unsigned int i = 0u; i < asteroids_nb; ++i) {
+			// Each value is drawn on its own line, as the order in which
+			// function arguments are evaluated is unspecified, and the belt
+			// should look the same whichever compiler built it.
+			auto const orbit_angle = angle(generator);
+			auto const distance_to_sun = orbit_radius(generator);
+			auto const elevation = height(generator);
+			auto const spin_angle = angle(generator);
+			auto const asteroid_radius = radius(generator);
+			TRSTransformf local;
+			local.SetTranslate(glm::vec3(distance_to_sun * std::cos(orbit_angle),
+			                             elevation,
+			                             distance_to_sun * std::sin(orbit_angle)));
+			local.SetRotateY(spin_angle);
+			asteroid_nodes.push_back(asteroid_belt.add_node(belt_root, local));
+			asteroid_radii.push_back(asteroid_radius);
+		}
+	}
+	float asteroid_belt_angle = 0.0f;
+	float const asteroid_belt_spin_speed = glm::two_pi<float>() / 120.0f; // radians per second
+	auto const update_asteroid_belt = [&](){
+		asteroid_belt.set_rotation(belt_root, glm::mat3(glm::rotate(glm::mat4(1.0f), asteroid_belt_angle,
+		                                                            glm::vec3(0.0f, 1.0f, 0.0f))));
+		asteroid_belt.update_world_matrices();
+
+		asteroid_impostors.instances.clear();
+		for (std::size_t i = 0u; i < asteroid_nodes.size(); ++i)
+			asteroid_impostors.instances.push_back(sphere_impostors::makeInstance(asteroid_belt.get_world_matrix(asteroid_nodes[i]),
+			                                                                      asteroid_radii[i]));
+		sphere_impostors::updateBatch(asteroid_impostors.batch, asteroid_impostors.instances);
+	};
+	update_asteroid_belt();
+
+
 	//
 	// Define the colour and depth used for clearing.
 	//
@@ -185,6 +267,10 @@ int main()
 	bool show_gui = true;
 	bool show_basis = false;
 	float time_scale = 1.0f;
+	LODSelection lod_selection;
+	lod_selection.camera = &camera;
+	bool use_impostors = false;
+	bool show_asteroid_belt = false;
 
 	while (!glfwWindowShouldClose(window)) {
 		//
@@ -224,6 +310,7 @@ int main()
 		int framebuffer_width, framebuffer_height;
 		glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
 		glViewport(0, 0, framebuffer_width, framebuffer_height);
+		lod_selection.viewport_height = static_cast<float>(framebuffer_height);
 
 
 		//
@@ -249,9 +336,30 @@ int main()
 		// TODO: Replace this explicit rendering of the Earth and Moon
 		// with a traversal of the scene graph and rendering of all its
 		// nodes.
-		earth.render(animation_delta_time_us, camera.GetWorldToClipMatrix(), glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)), show_basis);
+		earth_impostors.instances.clear();
+		moon_impostors.instances.clear();
+		earth.set_impostors(use_impostors ? &earth_impostors.instances : nullptr);
+		moon.set_impostors(use_impostors ? &moon_impostors.instances : nullptr);
+
+		earth.render(animation_delta_time_us, camera.GetWorldToClipMatrix(), glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 0.0f)), show_basis, &lod_selection);
 		//moon.render(animation_delta_time_us, camera.GetWorldToClipMatrix(), glm::mat4(1.0f), show_basis);
 
+		for (auto* group : { &earth_impostors, &moon_impostors }) {
+			if (group->instances.empty())
+				continue;
+			sphere_impostors::updateBatch(group->batch, group->instances);
+			sphere_impostors::drawBatch(group->batch, sphere_impostor_shader, camera.GetWorldToClipMatrix(),
+			                            camera.mWorld.GetTranslation(), group->texture);
+		}
+		if (show_asteroid_belt && animation_delta_time_us.count() != 0) {
+			asteroid_belt_angle = std::fmod(asteroid_belt_angle + asteroid_belt_spin_speed * std::chrono::duration<float>(animation_delta_time_us).count(),
+			                                glm::two_pi<float>());
+			update_asteroid_belt();
+		}
+		if (show_asteroid_belt)
+			sphere_impostors::drawBatch(asteroid_impostors.batch, sphere_impostor_shader, camera.GetWorldToClipMatrix(),
+			                            camera.mWorld.GetTranslation(), asteroid_impostors.texture);
+
 
 		//
 		// Add controls to the scene.
@@ -263,6 +371,9 @@ int main()
 			ImGui::SliderFloat("Time scale", &time_scale, 1e-1f, 10.0f);
 			ImGui::Separator();
 			ImGui::Checkbox("Show basis", &show_basis);
+			ImGui::SliderFloat("LOD target edge length (px)", &lod_selection.target_edge_length, 1.0f, 64.0f);
+			ImGui::Checkbox("Render bodies as impostors", &use_impostors);
+			ImGui::Checkbox("Show asteroid belt (impostors)", &show_asteroid_belt);
 		}
 		ImGui::End();
 
@@ -281,6 +392,10 @@ int main()
 		glfwSwapBuffers(window);
 	}
 
+	sphere_impostors::destroyBatch(asteroid_impostors.batch);
+	sphere_impostors::destroyBatch(moon_impostors.batch);
+	sphere_impostors::destroyBatch(earth_impostors.batch);
+
 	glDeleteTextures(1, &neptune_texture);
 	glDeleteTextures(1, &uranus_texture);
 	glDeleteTextures(1, &saturn_ring_texture);
@@ -1,10 +1,12 @@
 #include "assignment2.hpp"
 #include "interpolation.hpp"
 #include "parametric_shapes.hpp"
+#include "path_followers.hpp"
 
 #include "config.hpp"
 #include "core/Bonobo.h"
 #include "core/FPSCamera.h"
+#include "core/instancing.hpp"
 #include "core/node.hpp"
 #include "core/ShaderProgramManager.hpp"
 #include <imgui.h>
@@ -14,9 +16,19 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <array>
+#include <chrono>
 #include <clocale>
 #include <cstdlib>
 #include <stdexcept>
+#include <vector>
+
+namespace
+{
+	//! \brief Compare evaluating Catmull-Rom segments one point at a
+	//!        time against the batched SoA version, for several batch
+	//!        sizes, and log the throughput of each.
+	void benchmarkSplineEvaluation(float tension);
+}
 
 edaf80::Assignment2::Assignment2(WindowManager& windowManager) :
 	mCamera(0.5f * glm::half_pi<float>(),
@@ -72,6 +84,14 @@ edaf80::Assignment2::run()
 	if (diffuse_shader == 0u)
 		LogError("Failed to load diffuse shader");
 
+	GLuint diffuse_instanced_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Diffuse (instanced)",
+	                                         { { ShaderType::vertex, "EDAF80/diffuse_instanced.vert" },
+	                                           { ShaderType::fragment, "EDAF80/diffuse_instanced.frag" } },
+	                                         diffuse_instanced_shader);
+	if (diffuse_instanced_shader == 0u)
+		LogError("Failed to load instanced diffuse shader: control points will not be rendered.");
+
 	GLuint normal_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Normal",
 	                                         { { ShaderType::vertex, "EDAF80/normal.vert" },
@@ -104,6 +124,14 @@ edaf80::Assignment2::run()
 	if (texcoord_shader == 0u)
 		LogError("Failed to load texcoord shader");
 
+	GLuint path_follower_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Path followers",
+	                                         { { ShaderType::vertex, "EDAF80/path_follower.vert" },
+	                                           { ShaderType::fragment, "EDAF80/diffuse.frag" } },
+	                                         path_follower_shader);
+	if (path_follower_shader == 0u)
+		LogError("Failed to load path follower shader: path followers will not be rendered.");
+
 	auto const light_position = glm::vec3(-2.0f, 4.0f, 2.0f);
 	auto const set_uniforms = [&light_position](GLuint program){
 		glUniform3fv(glGetUniformLocation(program, "light_position"), 1, glm::value_ptr(light_position));
@@ -139,7 +167,7 @@ edaf80::Assignment2::run()
 	glEnable(GL_DEPTH_TEST);
 
 
-	auto const control_point_sphere = parametric_shapes::createSphere(0.1f, 10u, 10u);
+	auto const control_point_sphere = parametric_shapes::getSphere(0.1f, 10u, 10u);
 	std::array<glm::vec3, 9> control_point_locations = {
 		glm::vec3( 0.0f,  0.0f,  0.0f),
 		glm::vec3( 1.0f,  1.8f,  1.0f),
@@ -151,18 +179,42 @@ edaf80::Assignment2::run()
 		glm::vec3(-2.0f, -1.2f, -2.0f),
 		glm::vec3(-1.0f, -1.8f, -1.0f)
 	};
-	std::array<Node, control_point_locations.size()> control_points;
-	for (std::size_t i = 0; i < control_point_locations.size(); ++i) {
-		auto& control_point = control_points[i];
-		control_point.set_geometry(control_point_sphere);
-		control_point.set_program(&diffuse_shader, set_uniforms);
-		control_point.get_transform().SetTranslate(control_point_locations[i]);
+	// All control points share the same sphere, and are drawn at once as
+	// instances of it.
+	auto control_point_instances = bonobo::instancing::createInstances(*control_point_sphere);
+	{
+		std::vector<bonobo::instancing::instance> instances(control_point_locations.size());
+		for (std::size_t i = 0; i < control_point_locations.size(); ++i)
+			instances[i].model_to_world = glm::translate(glm::mat4(1.0f), control_point_locations[i]);
+		bonobo::instancing::updateInstances(control_point_instances, instances);
 	}
+	Node control_points;
+	control_points.set_geometry(control_point_sphere);
+	control_points.set_instances(&control_point_instances);
+	control_points.set_program(&diffuse_instanced_shader, set_uniforms);
 
 
 	auto lastTime = std::chrono::high_resolution_clock::now();
 
 	std::int32_t program_index = 0;
+	// Path going through all control points, used for moving the shape at a
+	// constant speed; it is rebuilt whenever the tension changes.
+	auto const make_path = [&control_point_locations](float tension){
+		return interpolation::CatmullRomPath(std::vector<glm::vec3>(control_point_locations.begin(), control_point_locations.end()),
+		                                     tension);
+	};
+	float path_tension = catmull_rom_tension;
+	auto path = make_path(path_tension);
+	bool use_constant_speed = false;
+	float path_speed = 2.0f;
+
+	// Crowd animated along the same path by the GPU.
+	auto const follower_shape = parametric_shapes::getSphere(0.05f, 8u, 6u);
+	auto uploaded_path = path_followers::uploadPath(path);
+	path_followers::crowd followers;
+	int followers_nb = static_cast<int>(followers.followers_nb);
+	bool show_followers = false;
+
 	float elapsed_time_s = 0.0f;
 	auto cull_mode = bonobo::cull_mode_t::disabled;
 	auto polygon_mode = bonobo::polygon_mode_t::fill;
@@ -213,10 +265,20 @@ edaf80::Assignment2::run()
 		bonobo::changePolygonMode(polygon_mode);
 
 
+		if (path_tension != catmull_rom_tension) {
+			path_tension = catmull_rom_tension;
+			path = make_path(path_tension);
+			path_followers::destroyPath(uploaded_path);
+			uploaded_path = path_followers::uploadPath(path);
+		}
+
 		if (interpolate) {
 			//! \todo Interpolate the movement of a shape between various
 			//!        control points.
-			if (use_linear) {
+			if (use_constant_speed) {
+				circle_rings_transform_ref.SetTranslate(path.eval_at_distance(path_speed * elapsed_time_s));
+			}
+			else if (use_linear) {
 				//! \todo Compute the interpolated position
 				//!       using the linear interpolation.
 			}
@@ -230,9 +292,14 @@ edaf80::Assignment2::run()
 
 		circle_rings.render(mCamera.GetWorldToClipMatrix());
 		if (show_control_points) {
-			for (auto const& control_point : control_points) {
-				control_point.render(mCamera.GetWorldToClipMatrix());
-			}
+			control_points.render(mCamera.GetWorldToClipMatrix());
+		}
+		if (show_followers) {
+			followers.followers_nb = static_cast<std::size_t>(followers_nb);
+			followers.speed = path_speed;
+			path_followers::drawFollowers(uploaded_path, *follower_shape, path_follower_shader,
+			                              mCamera.GetWorldToClipMatrix(), light_position,
+			                              followers, elapsed_time_s);
 		}
 
 		bool const opened = ImGui::Begin("Scene Controls", nullptr, ImGuiWindowFlags_None);
@@ -251,6 +318,13 @@ edaf80::Assignment2::run()
 			ImGui::Checkbox("Enable interpolation", &interpolate);
 			ImGui::Checkbox("Use linear interpolation", &use_linear);
 			ImGui::SliderFloat("Catmull-Rom tension", &catmull_rom_tension, 0.0f, 1.0f);
+			ImGui::Checkbox("Move at constant speed along the path", &use_constant_speed);
+			ImGui::SliderFloat("Speed along the path (m/s)", &path_speed, 0.0f, 10.0f);
+			ImGui::Checkbox("Show path followers", &show_followers);
+			ImGui::SliderInt("Path followers count", &followers_nb, 1, 100000);
+			ImGui::SliderFloat("Path followers lane radius", &followers.lane_radius, 0.0f, 2.0f);
+			if (ImGui::Button("Benchmark spline evaluation"))
+				benchmarkSplineEvaluation(catmull_rom_tension);
 			ImGui::Separator();
 			ImGui::Checkbox("Show basis", &show_basis);
 			ImGui::SliderFloat("Basis thickness scale", &basis_thickness_scale, 0.0f, 100.0f);
@@ -267,6 +341,69 @@ edaf80::Assignment2::run()
 
 		glfwSwapBuffers(window);
 	}
+
+	path_followers::destroyPath(uploaded_path);
+	bonobo::instancing::destroyInstances(control_point_instances);
+}
+
+namespace
+{
+	void
+	benchmarkSplineEvaluation(float tension)
+	{
+		using clock = std::chrono::high_resolution_clock;
+
+		// Every batch size evaluates the same total amount of points, so
+		// that the timings are comparable.
+		auto const evaluations_nb = std::size_t(1u) << 22u;
+		auto const max_batch_size = std::size_t(1u) << 16u;
+
+		// Random-ish but reproducible control points and distance ratios.
+		std::vector<float> control_points[4][3];
+		for (std::size_t p = 0u; p < 4u; ++p)
+			for (std::size_t c = 0u; c < 3u; ++c) {
+				control_points[p][c].resize(max_batch_size);
+				for (std::size_t i = 0u; i < max_batch_size; ++i)
+					control_points[p][c][i] = static_cast<float>((i * 7919u + p * 104729u + c * 1299709u) % 1000u) * 0.01f;
+			}
+		std::vector<float> xs(max_batch_size);
+		for (std::size_t i = 0u; i < max_batch_size; ++i)
+			xs[i] = static_cast<float>(i % 1024u) / 1024.0f;
+		std::vector<float> output[3] = { std::vector<float>(max_batch_size), std::vector<float>(max_batch_size), std::vector<float>(max_batch_size) };
+
+		interpolation::soa_positions points[4];
+		for (std::size_t p = 0u; p < 4u; ++p)
+			points[p] = { control_points[p][0].data(), control_points[p][1].data(), control_points[p][2].data() };
+		interpolation::soa_output const destination{ output[0].data(), output[1].data(), output[2].data() };
+		auto const basis = interpolation::makeCatmullRomBasis(tension);
+		auto const get_point = [&control_points](std::size_t p, std::size_t i){
+			return glm::vec3(control_points[p][0][i], control_points[p][1][i], control_points[p][2][i]);
+		};
+
+		for (auto const batch_size : { std::size_t(1u), std::size_t(16u), std::size_t(256u), std::size_t(4096u), max_batch_size }) {
+			auto const batches_nb = evaluations_nb / batch_size;
+
+			auto const scalar_start = clock::now();
+			for (std::size_t b = 0u; b < batches_nb; ++b)
+				for (std::size_t i = 0u; i < batch_size; ++i) {
+					auto const position = interpolation::evalCatmullRom(get_point(0u, i), get_point(1u, i), get_point(2u, i), get_point(3u, i),
+					                                                    tension, xs[i]);
+					output[0][i] = position.x;
+					output[1][i] = position.y;
+					output[2][i] = position.z;
+				}
+			auto const batched_start = clock::now();
+			for (std::size_t b = 0u; b < batches_nb; ++b)
+				interpolation::evalCatmullRom(points[0], points[1], points[2], points[3], basis, xs.data(), batch_size, destination);
+			auto const batched_end = clock::now();
+
+			auto const to_throughput = [batches_nb, batch_size](clock::duration const& duration){
+				return static_cast<double>(batches_nb * batch_size) / std::chrono::duration<double, std::micro>(duration).count();
+			};
+			LogInfo("Catmull-Rom, batches of %zu: %.1f M points/s one at a time, %.1f M points/s batched",
+			        batch_size, to_throughput(batched_start - scalar_start), to_throughput(batched_end - batched_start));
+		}
+	}
 }
 
 int main()
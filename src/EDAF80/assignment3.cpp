@@ -14,10 +14,29 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <tinyfiledialogs.h>
 
+#include <algorithm>
+#include <chrono>
 #include <clocale>
+#include <cmath>
 #include <cstdlib>
+#include <functional>
 #include <stdexcept>
 
+namespace
+{
+	//! \brief Draw finely tessellated spheres indexed both as triangle
+	//!        lists and as strips, and log how much index data and how
+	//!        many vertex shader invocations each needs, and how long it
+	//!        takes the GPU to draw them.
+	void benchmarkIndexLayouts(GLuint program, glm::mat4 const& world_to_clip);
+
+	//! \brief Generate spheres and circle rings of increasing resolution,
+	//!        both with the table-driven generators and with a reference
+	//!        calling sin and cos for every vertex, and log the throughput
+	//!        of each in vertices per second.
+	void benchmarkShapeGeneration();
+}
+
 edaf80::Assignment3::Assignment3(WindowManager& windowManager) :
 	mCamera(0.5f * glm::half_pi<float>(),
 	        static_cast<float>(config::resolution_x) / static_cast<float>(config::resolution_y),
@@ -83,6 +102,29 @@ edaf80::Assignment3::run()
 	if (texcoord_shader == 0u)
 		LogError("Failed to load texcoord shader");
 
+	// Kept apart from the other programs, as they can not render regular
+	// meshes.
+	ShaderProgramManager procedural_program_manager;
+	GLuint tessellated_diffuse_shader = 0u;
+	procedural_program_manager.CreateAndRegisterProgram("Diffuse (tessellated)",
+	                                               { { ShaderType::vertex, "EDAF80/parametric_patch.vert" },
+	                                                 { ShaderType::tess_ctrl, "EDAF80/parametric_patch.tesc" },
+	                                                 { ShaderType::tess_eval, "EDAF80/parametric_patch.tese" },
+	                                                 { ShaderType::fragment, "EDAF80/diffuse.frag" } },
+	                                               tessellated_diffuse_shader);
+	if (tessellated_diffuse_shader == 0u)
+		LogError("Failed to load tessellated diffuse shader");
+
+	GLuint procedural_diffuse_shader = 0u;
+	procedural_program_manager.CreateAndRegisterProgram("Diffuse (procedural)",
+	                                                    { { ShaderType::vertex, "EDAF80/procedural_shape.vert" },
+	                                                      { ShaderType::fragment, "EDAF80/diffuse.frag" } },
+	                                                    procedural_diffuse_shader);
+	if (procedural_diffuse_shader == 0u)
+		LogError("Failed to load procedural diffuse shader");
+	else
+		parametric_shapes::bindProceduralShapeBlock(procedural_diffuse_shader);
+
 	auto light_position = glm::vec3(-2.0f, 4.0f, 2.0f);
 	auto const set_uniforms = [&light_position](GLuint program){
 		glUniform3fv(glGetUniformLocation(program, "light_position"), 1, glm::value_ptr(light_position));
@@ -100,7 +142,8 @@ edaf80::Assignment3::run()
 	//
 	// Set up the two spheres used.
 	//
-	auto skybox_shape = parametric_shapes::createSphere(20.0f, 100u, 100u);
+	auto skybox_shape = parametric_shapes::createSphere(20.0f, 100u, 100u,
+	                                                    parametric_shapes::index_layout::triangle_strips);
 	if (skybox_shape.vao == 0u) {
 		LogError("Failed to retrieve the mesh for the skybox");
 		return;
@@ -110,11 +153,16 @@ edaf80::Assignment3::run()
 	skybox.set_geometry(skybox_shape);
 	skybox.set_program(&fallback_shader, set_uniforms);
 
-	auto demo_shape = parametric_shapes::createSphere(1.5f, 40u, 40u);
+	// The demo sphere gets tessellated depending on how large it appears
+	// on screen.
+	auto const demo_sphere_lods = parametric_shapes::createSphereLODs(1.5f, 8u, 256u);
+	auto demo_sphere_lod_level = demo_sphere_lods.levels.size() / 2u;
+	auto const& demo_shape = *demo_sphere_lods.levels[demo_sphere_lod_level];
 	if (demo_shape.vao == 0u) {
 		LogError("Failed to retrieve the mesh for the demo sphere");
 		return;
 	}
+	float lod_target_edge_length = 8.0f;
 
 	bonobo::material_data demo_material;
 	demo_material.ambient = glm::vec3(0.1f, 0.1f, 0.1f);
@@ -123,11 +171,44 @@ edaf80::Assignment3::run()
 	demo_material.shininess = 10.0f;
 
 	Node demo_sphere;
-	demo_sphere.set_geometry(demo_shape);
+	demo_sphere.set_geometry(demo_sphere_lods.levels[demo_sphere_lod_level]);
 	demo_sphere.set_material_constants(demo_material);
 	demo_sphere.set_program(&fallback_shader, phong_set_uniforms);
 
 
+	//
+	// Set up a sphere evaluated on the GPU, from a handful of patches
+	// refined depending on their size on screen.
+	//
+	float target_edge_length = 8.0f;
+	auto framebuffer_size = glm::vec2(config::resolution_x, config::resolution_y);
+	parametric_shapes::surface_uniform_locations tessellated_locations;
+	auto const tessellated_set_uniforms = [&light_position,&target_edge_length,&framebuffer_size,&tessellated_locations](GLuint program){
+		glUniform3fv(glGetUniformLocation(program, "light_position"), 1, glm::value_ptr(light_position));
+		parametric_shapes::setSurfaceUniforms(tessellated_locations, program, parametric_shapes::surface_type::sphere,
+		                                      glm::vec4(1.5f, 0.0f, 0.0f, 0.0f),
+		                                      target_edge_length, framebuffer_size);
+	};
+
+	auto const tessellated_sphere_shape = parametric_shapes::createPatches(8u, 4u);
+	Node tessellated_sphere;
+	tessellated_sphere.set_geometry(tessellated_sphere_shape);
+	tessellated_sphere.set_program(&tessellated_diffuse_shader, tessellated_set_uniforms);
+	tessellated_sphere.get_transform().SetTranslate(glm::vec3(4.0f, 0.0f, 0.0f));
+
+
+	//
+	// Set up a sphere without any vertex data, generated on the fly by the
+	// vertex shader.
+	//
+	int procedural_sphere_segments_count = 40;
+	auto procedural_sphere = parametric_shapes::createProceduralShape(parametric_shapes::surface_type::sphere,
+	                                                                  glm::vec4(1.5f, 0.0f, 0.0f, 0.0f),
+	                                                                  static_cast<unsigned int>(procedural_sphere_segments_count),
+	                                                                  static_cast<unsigned int>(procedural_sphere_segments_count));
+	auto const procedural_sphere_world = glm::translate(glm::mat4(1.0f), glm::vec3(-4.0f, 0.0f, 0.0f));
+
+
 	glClearDepthf(1.0f);
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 	glEnable(GL_DEPTH_TEST);
@@ -143,6 +224,9 @@ edaf80::Assignment3::run()
 	bool show_gui = true;
 	bool shader_reload_failed = false;
 	bool show_basis = false;
+	bool show_tessellated_sphere = false;
+	bool show_procedural_sphere = false;
+	bool run_index_layouts_benchmark = false;
 	float basis_thickness_scale = 1.0f;
 	float basis_length_scale = 1.0f;
 
@@ -166,11 +250,14 @@ edaf80::Assignment3::run()
 
 		if (inputHandler.GetKeycodeState(GLFW_KEY_R) & JUST_PRESSED) {
 			shader_reload_failed = !program_manager.ReloadAllPrograms();
+			shader_reload_failed = !procedural_program_manager.ReloadAllPrograms() || shader_reload_failed;
 			if (shader_reload_failed)
 				tinyfd_notifyPopup("Shader Program Reload Error",
 				                   "An error occurred while reloading shader programs; see the logs for details.\n"
 				                   "Rendering is suspended until the issue is solved. Once fixed, just reload the shaders again.",
 				                   "error");
+			else if (procedural_diffuse_shader != 0u)
+				parametric_shapes::bindProceduralShapeBlock(procedural_diffuse_shader);
 		}
 		if (inputHandler.GetKeycodeState(GLFW_KEY_F3) & JUST_RELEASED)
 			show_logs = !show_logs;
@@ -190,17 +277,44 @@ edaf80::Assignment3::run()
 		int framebuffer_width, framebuffer_height;
 		glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
 		glViewport(0, 0, framebuffer_width, framebuffer_height);
+		framebuffer_size = glm::vec2(framebuffer_width, framebuffer_height);
 
 
 		mWindowManager.NewImGuiFrame();
 
 
+		if (run_index_layouts_benchmark) {
+			benchmarkIndexLayouts(fallback_shader, mCamera.GetWorldToClipMatrix());
+			run_index_layouts_benchmark = false;
+		}
+
 		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 		bonobo::changePolygonMode(polygon_mode);
 
 
+		auto const demo_sphere_projected_radius = parametric_shapes::getProjectedRadius(demo_sphere.get_transform().GetTranslation(), demo_sphere_lods.radius,
+		                                                                               mCamera, framebuffer_size.y);
+		auto const demo_sphere_selected_level = parametric_shapes::selectSphereLOD(demo_sphere_lods, demo_sphere_projected_radius, lod_target_edge_length);
+		if (demo_sphere_selected_level != demo_sphere_lod_level) {
+			demo_sphere_lod_level = demo_sphere_selected_level;
+			demo_sphere.set_geometry(demo_sphere_lods.levels[demo_sphere_lod_level]);
+			demo_sphere.set_material_constants(demo_material);
+		}
+
 		skybox.render(mCamera.GetWorldToClipMatrix());
 		demo_sphere.render(mCamera.GetWorldToClipMatrix());
+		if (show_tessellated_sphere)
+			tessellated_sphere.render(mCamera.GetWorldToClipMatrix());
+		if (show_procedural_sphere && procedural_diffuse_shader != 0u) {
+			auto const normal_model_to_world = glm::transpose(glm::inverse(procedural_sphere_world));
+			glUseProgram(procedural_diffuse_shader);
+			glUniformMatrix4fv(glGetUniformLocation(procedural_diffuse_shader, "vertex_model_to_world"), 1, GL_FALSE, glm::value_ptr(procedural_sphere_world));
+			glUniformMatrix4fv(glGetUniformLocation(procedural_diffuse_shader, "normal_model_to_world"), 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
+			glUniformMatrix4fv(glGetUniformLocation(procedural_diffuse_shader, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(mCamera.GetWorldToClipMatrix()));
+			glUniform3fv(glGetUniformLocation(procedural_diffuse_shader, "light_position"), 1, glm::value_ptr(light_position));
+			parametric_shapes::drawProceduralShape(procedural_sphere);
+			glUseProgram(0u);
+		}
 
 
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -225,6 +339,20 @@ edaf80::Assignment3::run()
 			ImGui::SliderFloat3("Light Position", glm::value_ptr(light_position), -20.0f, 20.0f);
 			ImGui::Separator();
 			ImGui::Checkbox("Use orbit camera", &use_orbit_camera);
+			ImGui::SliderFloat("Demo sphere LOD target edge length (px)", &lod_target_edge_length, 1.0f, 64.0f);
+			ImGui::Text("Demo sphere LOD: %u edges around the equator", demo_sphere_lods.longitude_edges_counts[demo_sphere_lod_level]);
+			ImGui::Separator();
+			ImGui::Checkbox("Show tessellated sphere", &show_tessellated_sphere);
+			ImGui::SliderFloat("Target edge length (px)", &target_edge_length, 1.0f, 64.0f);
+			ImGui::Checkbox("Show procedural sphere", &show_procedural_sphere);
+			if (ImGui::SliderInt("Procedural sphere segments", &procedural_sphere_segments_count, 2, 256))
+				parametric_shapes::setProceduralShapeSegments(procedural_sphere,
+				                                              static_cast<unsigned int>(procedural_sphere_segments_count),
+				                                              static_cast<unsigned int>(procedural_sphere_segments_count));
+			if (ImGui::Button("Benchmark triangle lists vs strips"))
+				run_index_layouts_benchmark = true;
+			if (ImGui::Button("Benchmark shape generation"))
+				benchmarkShapeGeneration();
 			ImGui::Separator();
 			ImGui::Checkbox("Show basis", &show_basis);
 			ImGui::SliderFloat("Basis thickness scale", &basis_thickness_scale, 0.0f, 100.0f);
@@ -248,6 +376,186 @@ edaf80::Assignment3::run()
 
 		glfwSwapBuffers(window);
 	}
+
+	parametric_shapes::destroyProceduralShape(procedural_sphere);
+}
+
+namespace
+{
+	void
+	benchmarkIndexLayouts(GLuint program, glm::mat4 const& world_to_clip)
+	{
+		if (program == 0u)
+			return;
+
+		// Draw each mesh several times, to get a less noisy measure.
+		auto const draws_nb = 16u;
+		GLuint elapsed_time_query = 0u;
+		glGenQueries(1, &elapsed_time_query);
+
+		parametric_shapes::geometry_data geometry;
+		for (auto const split_count : { 127u, 511u, 1023u }) {
+			for (auto const layout : { parametric_shapes::index_layout::triangle_list,
+			                           parametric_shapes::index_layout::triangle_strips }) {
+				parametric_shapes::generateSphere(geometry, 1.5f, split_count, split_count, layout);
+				auto const statistics = parametric_shapes::computeIndexStatistics(geometry);
+				auto const mesh = parametric_shapes::upload(geometry);
+
+				Node sphere;
+				sphere.set_geometry(mesh);
+				glBeginQuery(GL_TIME_ELAPSED, elapsed_time_query);
+				for (unsigned int i = 0u; i < draws_nb; ++i)
+					sphere.render(world_to_clip, glm::mat4(1.0f), program, [](GLuint /*program*/){});
+				glEndQuery(GL_TIME_ELAPSED);
+				GLuint64 elapsed_time = 0u;
+				glGetQueryObjectui64v(elapsed_time_query, GL_QUERY_RESULT, &elapsed_time);
+
+				LogInfo("%ux%u sphere as %s: %.2f MiB of indices, ~%zu vertex shader invocations for %d vertices, %.3f ms per draw",
+				        split_count + 1u, split_count + 1u,
+				        layout == parametric_shapes::index_layout::triangle_list ? "a triangle list" : "triangle strips",
+				        static_cast<double>(statistics.index_bytes) / (1024.0 * 1024.0),
+				        statistics.vertex_shader_invocations, mesh.vertices_nb,
+				        static_cast<double>(elapsed_time) / (1.0e6 * draws_nb));
+
+				glDeleteBuffers(1, &mesh.ibo);
+				glDeleteBuffers(1, &mesh.bo);
+				glDeleteVertexArrays(1, &mesh.vao);
+			}
+		}
+
+		glDeleteQueries(1, &elapsed_time_query);
+	}
+
+	// Straightforward version of `parametric_shapes::generateSphere()`,
+	// evaluating everything for each vertex, as a baseline.
+	void
+	generateReferenceSphere(parametric_shapes::geometry_data& geometry, float const radius,
+	                        unsigned int const longitude_split_count, unsigned int const latitude_split_count)
+	{
+		auto const longitude_edges_count = longitude_split_count + 1u;
+		auto const latitude_edges_count = latitude_split_count + 1u;
+		auto const longitude_vertices_count = longitude_edges_count + 1u;
+		auto const latitude_vertices_count = latitude_edges_count + 1u;
+		geometry.resize(longitude_vertices_count * latitude_vertices_count, 2u * latitude_edges_count * longitude_edges_count);
+
+		float const d_theta = glm::two_pi<float>() / static_cast<float>(longitude_edges_count);
+		float const d_phi = glm::pi<float>() / static_cast<float>(latitude_edges_count);
+		std::size_t index = 0u;
+		for (unsigned int i = 0u; i < longitude_vertices_count; ++i) {
+			float const theta = static_cast<float>(i) * d_theta;
+			for (unsigned int j = 0u; j < latitude_vertices_count; ++j) {
+				float const phi = static_cast<float>(j) * d_phi;
+				auto const t = glm::normalize(glm::vec3(std::cos(theta), 0.0f, -std::sin(theta)));
+				auto const b = glm::normalize(glm::vec3(std::sin(theta) * std::cos(phi), std::sin(phi), std::cos(theta) * std::cos(phi)));
+				geometry.vertices[index] = radius * glm::vec3(std::sin(theta) * std::sin(phi), -std::cos(phi), std::cos(theta) * std::sin(phi));
+				geometry.tangents[index] = t;
+				geometry.binormals[index] = b;
+				geometry.normals[index] = glm::cross(t, b);
+				geometry.texcoords[index] = glm::vec3(static_cast<float>(i) / static_cast<float>(longitude_vertices_count),
+				                                      static_cast<float>(j) / static_cast<float>(latitude_vertices_count),
+				                                      0.0f);
+				++index;
+			}
+		}
+
+		index = 0u;
+		for (unsigned int i = 0u; i < longitude_edges_count; ++i)
+			for (unsigned int j = 0u; j < latitude_edges_count; ++j) {
+				geometry.indices[index++] = glm::uvec3(latitude_vertices_count * (i + 1u) + (j + 1u),
+				                                       latitude_vertices_count * (i + 0u) + (j + 1u),
+				                                       latitude_vertices_count * (i + 0u) + (j + 0u));
+				geometry.indices[index++] = glm::uvec3(latitude_vertices_count * (i + 1u) + (j + 0u),
+				                                       latitude_vertices_count * (i + 1u) + (j + 1u),
+				                                       latitude_vertices_count * (i + 0u) + (j + 0u));
+			}
+	}
+
+	// Straightforward version of `parametric_shapes::generateCircleRing()`,
+	// evaluating everything for each vertex, as a baseline.
+	void
+	generateReferenceCircleRing(parametric_shapes::geometry_data& geometry, float const radius, float const spread_length,
+	                            unsigned int const circle_split_count, unsigned int const spread_split_count)
+	{
+		auto const circle_slice_edges_count = circle_split_count + 1u;
+		auto const spread_slice_edges_count = spread_split_count + 1u;
+		auto const circle_slice_vertices_count = circle_slice_edges_count + 1u;
+		auto const spread_slice_vertices_count = spread_slice_edges_count + 1u;
+		geometry.resize(circle_slice_vertices_count * spread_slice_vertices_count, 2u * circle_slice_edges_count * spread_slice_edges_count);
+
+		float const spread_start = radius - 0.5f * spread_length;
+		float const d_theta = glm::two_pi<float>() / static_cast<float>(circle_slice_edges_count);
+		float const d_spread = spread_length / static_cast<float>(spread_slice_edges_count);
+		std::size_t index = 0u;
+		for (unsigned int i = 0u; i < circle_slice_vertices_count; ++i) {
+			float const theta = static_cast<float>(i) * d_theta;
+			for (unsigned int j = 0u; j < spread_slice_vertices_count; ++j) {
+				float const distance_to_centre = spread_start + static_cast<float>(j) * d_spread;
+				auto const t = glm::vec3(std::cos(theta), std::sin(theta), 0.0f);
+				auto const b = glm::vec3(-std::sin(theta), std::cos(theta), 0.0f);
+				geometry.vertices[index] = distance_to_centre * t;
+				geometry.tangents[index] = t;
+				geometry.binormals[index] = b;
+				geometry.normals[index] = glm::cross(t, b);
+				geometry.texcoords[index] = glm::vec3(static_cast<float>(j) / static_cast<float>(spread_slice_vertices_count),
+				                                      static_cast<float>(i) / static_cast<float>(circle_slice_vertices_count),
+				                                      0.0f);
+				++index;
+			}
+		}
+
+		index = 0u;
+		for (unsigned int i = 0u; i < circle_slice_edges_count; ++i)
+			for (unsigned int j = 0u; j < spread_slice_edges_count; ++j) {
+				geometry.indices[index++] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
+				                                       spread_slice_vertices_count * (i + 0u) + (j + 1u),
+				                                       spread_slice_vertices_count * (i + 1u) + (j + 1u));
+				geometry.indices[index++] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
+				                                       spread_slice_vertices_count * (i + 1u) + (j + 1u),
+				                                       spread_slice_vertices_count * (i + 1u) + (j + 0u));
+			}
+	}
+
+	void
+	benchmarkShapeGeneration()
+	{
+		using clock = std::chrono::high_resolution_clock;
+
+		// Every resolution generates about the same total amount of
+		// vertices, so that the timings are comparable.
+		auto const total_vertices_nb = std::size_t(1u) << 24u;
+
+		parametric_shapes::geometry_data geometry;
+		auto const measure = [&geometry, total_vertices_nb](std::size_t vertices_nb, std::function<void (parametric_shapes::geometry_data&)> const& generate){
+			auto const repetitions_nb = std::max<std::size_t>(total_vertices_nb / vertices_nb, 1u);
+			auto const start = clock::now();
+			for (std::size_t r = 0u; r < repetitions_nb; ++r)
+				generate(geometry);
+			auto const elapsed_s = std::chrono::duration<double>(clock::now() - start).count();
+			return static_cast<double>(repetitions_nb * vertices_nb) / elapsed_s;
+		};
+
+		for (auto const split_count : { 8u, 98u, 998u }) {
+			auto const vertices_nb = static_cast<std::size_t>(split_count + 2u) * (split_count + 2u);
+
+			auto const reference_sphere = measure(vertices_nb, [split_count](parametric_shapes::geometry_data& g){
+				generateReferenceSphere(g, 1.0f, split_count, split_count);
+			});
+			auto const sphere = measure(vertices_nb, [split_count](parametric_shapes::geometry_data& g){
+				parametric_shapes::generateSphere(g, 1.0f, split_count, split_count, parametric_shapes::index_layout::triangle_list);
+			});
+			LogInfo("%ux%u sphere: %.1f Mvertices/s per vertex, %.1f Mvertices/s table-driven (x%.1f)",
+			        split_count + 2u, split_count + 2u, reference_sphere * 1.0e-6, sphere * 1.0e-6, sphere / reference_sphere);
+
+			auto const reference_ring = measure(vertices_nb, [split_count](parametric_shapes::geometry_data& g){
+				generateReferenceCircleRing(g, 1.0f, 0.5f, split_count, split_count);
+			});
+			auto const ring = measure(vertices_nb, [split_count](parametric_shapes::geometry_data& g){
+				parametric_shapes::generateCircleRing(g, 1.0f, 0.5f, split_count, split_count, parametric_shapes::index_layout::triangle_list);
+			});
+			LogInfo("%ux%u circle ring: %.1f Mvertices/s per vertex, %.1f Mvertices/s table-driven (x%.1f)",
+			        split_count + 2u, split_count + 2u, reference_ring * 1.0e-6, ring * 1.0e-6, ring / reference_ring);
+		}
+	}
 }
 
 int main()
@@ -16,6 +16,7 @@
 #include "core/ShaderProgramManager.hpp"
 #include "core/helpers.hpp"
 #include "core/node.hpp"
+#include "core/render_queue.hpp"
 
 edaf80::Assignment5::Assignment5(WindowManager &windowManager)
     : mCamera(0.5f * glm::half_pi<float>(),
@@ -191,32 +192,38 @@ void edaf80::Assignment5::run() {
   wall_floor.set_geometry(wall_floor_shape);
   wall_floor.set_program(&parallax_shader, set_uniforms);
 
-  glm::mat4 wall_ceil_transform = wall_ceil.get_transform().GetMatrix();
-  wall_ceil_transform = glm::translate(wall_ceil_transform, glm::vec3(0, 1, 0));
-  wall_ceil_transform = glm::rotate(wall_ceil_transform, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+  wall_ceil.get_transform().SetTranslate(glm::vec3(0, 1, 0));
+  wall_ceil.get_transform().SetRotate(glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-  glm::mat4 wall_right_transform = wall_right.get_transform().GetMatrix();
-  wall_right_transform = glm::translate(wall_right_transform, glm::vec3(1, 0, 0));
-  wall_right_transform = glm::rotate(wall_right_transform, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  wall_right.get_transform().SetTranslate(glm::vec3(1, 0, 0));
+  wall_right.get_transform().SetRotate(glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-  glm::mat4 wall_left_transform = wall_left.get_transform().GetMatrix();
-  wall_left_transform = glm::translate(wall_left_transform, glm::vec3(-1, 0, 0));
-  wall_left_transform = glm::rotate(wall_left_transform, -glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+  wall_left.get_transform().SetTranslate(glm::vec3(-1, 0, 0));
+  wall_left.get_transform().SetRotate(-glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 
-  glm::mat4 wall_floor_transform = wall_floor.get_transform().GetMatrix();
-  wall_floor_transform = glm::translate(wall_floor_transform, glm::vec3(1, -1, -1));
-  wall_floor_transform = glm::rotate(wall_floor_transform, -glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  wall_floor.get_transform().SetTranslate(glm::vec3(1, -1, -1));
+  wall_floor.get_transform().SetRotate(-glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
-  glm::mat4 wall_back_transform = wall_back.get_transform().GetMatrix();
-  wall_back_transform = glm::translate(wall_back_transform, glm::vec3(0, 0, -1));
-  wall_back_transform = glm::rotate(wall_back_transform, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-  wall_back_transform = glm::rotate(wall_back_transform, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  wall_back.get_transform().SetTranslate(glm::vec3(0, 0, -1));
+  wall_back.get_transform().SetRotate(glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+  wall_back.get_transform().Rotate(glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  // The walls are grouped under the room, so that they can be culled all
+  // at once when the room is out of sight.
+  Node room;
+  room.add_child(&wall_back);
+  room.add_child(&wall_left);
+  room.add_child(&wall_right);
+  room.add_child(&wall_ceil);
+  room.add_child(&wall_floor);
 
   glClearDepthf(1.0f);
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glEnable(GL_DEPTH_TEST);
   glLineWidth(5);
 
+  RenderQueue render_queue;
+
   auto lastTime = std::chrono::high_resolution_clock::now();
   bool use_geometry = false;
   bool show_logs = true;
@@ -277,11 +284,11 @@ void edaf80::Assignment5::run() {
 
     if (!shader_reload_failed) {
 		if(use_geometry) {
-			wall_back.render(mCamera.GetWorldToClipMatrix(), wall_back_transform);
-			wall_left.render(mCamera.GetWorldToClipMatrix(), wall_left_transform);
-			wall_right.render(mCamera.GetWorldToClipMatrix(), wall_right_transform);
-			wall_ceil.render(mCamera.GetWorldToClipMatrix(), wall_ceil_transform);
-			wall_floor.render(mCamera.GetWorldToClipMatrix(), wall_floor_transform);
+			// All walls share the same program, which only needs to be
+			// bound once.
+			render_queue.begin(mCamera.GetWorldToClipMatrix());
+			render_queue.submit_subtree(room);
+			render_queue.execute();
 		} else {
 			wall.render(mCamera.GetWorldToClipMatrix(), wallTransform);
 		}
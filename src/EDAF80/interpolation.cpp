@@ -1,10 +1,105 @@
 #include "interpolation.hpp"
+#include "simd_lanes.hpp"
+
+#include "core/Log.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	using simd::forEachLanes;
+
+	// Evaluate ((a * x + b) * x + c) * x + d.
+	template<typename Lanes>
+	typename Lanes::type
+	evalCubic(typename Lanes::type a, typename Lanes::type b,
+	          typename Lanes::type c, typename Lanes::type d,
+	          typename Lanes::type x)
+	{
+		return Lanes::add(Lanes::mul(Lanes::add(Lanes::mul(Lanes::add(Lanes::mul(a, x), b), x), c), x), d);
+	}
+
+	struct lerp_kernel {
+		interpolation::soa_positions const& p0;
+		interpolation::soa_positions const& p1;
+		float const* xs;
+		interpolation::soa_output const& output;
+
+		template<typename Lanes>
+		void run(std::size_t i) const
+		{
+			auto const x = Lanes::load(xs + i);
+			auto const lerp = [x](float const* a, float const* b){
+				auto const origin = Lanes::load(a);
+				return Lanes::add(origin, Lanes::mul(x, Lanes::sub(Lanes::load(b), origin)));
+			};
+			// Compute everything before storing, in case the output aliases
+			// the input.
+			auto const result_x = lerp(p0.x + i, p1.x + i);
+			auto const result_y = lerp(p0.y + i, p1.y + i);
+			auto const result_z = lerp(p0.z + i, p1.z + i);
+			Lanes::store(output.x + i, result_x);
+			Lanes::store(output.y + i, result_y);
+			Lanes::store(output.z + i, result_z);
+		}
+	};
+
+	struct catmull_rom_segment_kernel {
+		glm::vec3 const (&coefficients)[4]; // coefficients[k] goes with x^k
+		float const* xs;
+		interpolation::soa_output const& output;
+
+		template<typename Lanes>
+		void run(std::size_t i) const
+		{
+			auto const x = Lanes::load(xs + i);
+			for (int c = 0; c < 3; ++c) {
+				auto const result = evalCubic<Lanes>(Lanes::broadcast(coefficients[3][c]), Lanes::broadcast(coefficients[2][c]),
+				                                     Lanes::broadcast(coefficients[1][c]), Lanes::broadcast(coefficients[0][c]),
+				                                     x);
+				Lanes::store((c == 0 ? output.x : c == 1 ? output.y : output.z) + i, result);
+			}
+		}
+	};
+
+	struct catmull_rom_segments_kernel {
+		interpolation::soa_positions const (&points)[4];
+		interpolation::catmull_rom_basis const& basis;
+		float const* xs;
+		interpolation::soa_output const& output;
+
+		template<typename Lanes>
+		void run(std::size_t i) const
+		{
+			auto const x = Lanes::load(xs + i);
+
+			// The weight of each control point only depends on x, and is
+			// shared by all three components.
+			typename Lanes::type weights[4];
+			for (int p = 0; p < 4; ++p)
+				weights[p] = evalCubic<Lanes>(Lanes::broadcast(basis.weights[3][p]), Lanes::broadcast(basis.weights[2][p]),
+				                              Lanes::broadcast(basis.weights[1][p]), Lanes::broadcast(basis.weights[0][p]),
+				                              x);
+
+			auto const weigh = [&weights, i](float const* p0, float const* p1, float const* p2, float const* p3){
+				return Lanes::add(Lanes::add(Lanes::mul(weights[0], Lanes::load(p0 + i)), Lanes::mul(weights[1], Lanes::load(p1 + i))),
+				                  Lanes::add(Lanes::mul(weights[2], Lanes::load(p2 + i)), Lanes::mul(weights[3], Lanes::load(p3 + i))));
+			};
+			auto const result_x = weigh(points[0].x, points[1].x, points[2].x, points[3].x);
+			auto const result_y = weigh(points[0].y, points[1].y, points[2].y, points[3].y);
+			auto const result_z = weigh(points[0].z, points[1].z, points[2].z, points[3].z);
+			Lanes::store(output.x + i, result_x);
+			Lanes::store(output.y + i, result_y);
+			Lanes::store(output.z + i, result_z);
+		}
+	};
+}
 
 glm::vec3
 interpolation::evalLERP(glm::vec3 const& p0, glm::vec3 const& p1, float const x)
 {
-	//! \todo Implement this function
-	return glm::vec3();
+	return p0 + x * (p1 - p0);
 }
 
 glm::vec3
@@ -12,6 +107,225 @@ interpolation::evalCatmullRom(glm::vec3 const& p0, glm::vec3 const& p1,
                               glm::vec3 const& p2, glm::vec3 const& p3,
                               float const t, float const x)
 {
-	//! \todo Implement this function
-	return glm::vec3();
+	auto const basis = makeCatmullRomBasis(t);
+	glm::vec3 result(0.0f);
+	evalCatmullRom(p0, p1, p2, p3, basis, &x, 1u, { &result.x, &result.y, &result.z });
+	return result;
+}
+
+interpolation::catmull_rom_basis
+interpolation::makeCatmullRomBasis(float const t)
+{
+	catmull_rom_basis basis;
+	basis.tension = t;
+	float const weights[4][4] = {
+		{ 0.0f,       1.0f,         0.0f,  0.0f },
+		{   -t,       0.0f,            t,  0.0f },
+		{ 2.0f * t,   t - 3.0f, 3.0f - 2.0f * t,    -t },
+		{   -t,       2.0f - t,     t - 2.0f,     t }
+	};
+	for (int k = 0; k < 4; ++k)
+		for (int i = 0; i < 4; ++i)
+			basis.weights[k][i] = weights[k][i];
+	return basis;
+}
+
+void
+interpolation::evalLERP(soa_positions const& p0, soa_positions const& p1,
+                        float const* xs, std::size_t const count,
+                        soa_output const& output)
+{
+	forEachLanes(count, lerp_kernel{ p0, p1, xs, output });
+}
+
+void
+interpolation::evalCatmullRom(glm::vec3 const& p0, glm::vec3 const& p1,
+                              glm::vec3 const& p2, glm::vec3 const& p3,
+                              catmull_rom_basis const& basis,
+                              float const* xs, std::size_t const count,
+                              soa_output const& output)
+{
+	glm::vec3 coefficients[4];
+	for (int k = 0; k < 4; ++k)
+		coefficients[k] = basis.weights[k][0] * p0 + basis.weights[k][1] * p1
+		                + basis.weights[k][2] * p2 + basis.weights[k][3] * p3;
+
+	forEachLanes(count, catmull_rom_segment_kernel{ coefficients, xs, output });
+}
+
+void
+interpolation::evalCatmullRom(soa_positions const& p0, soa_positions const& p1,
+                              soa_positions const& p2, soa_positions const& p3,
+                              catmull_rom_basis const& basis,
+                              float const* xs, std::size_t const count,
+                              soa_output const& output)
+{
+	soa_positions const points[4] = { p0, p1, p2, p3 };
+	forEachLanes(count, catmull_rom_segments_kernel{ points, basis, xs, output });
+}
+
+namespace
+{
+	// Chords are always split a few times, so that a segment whose
+	// endpoints and midpoint happen to be aligned is not mistaken for a
+	// straight line, and never too many times, to bound the table size.
+	constexpr unsigned int min_subdivision_depth = 2u;
+	constexpr unsigned int max_subdivision_depth = 16u;
+}
+
+interpolation::CatmullRomPath::CatmullRomPath(std::vector<glm::vec3> const& control_points,
+                                              float tension, bool is_closed,
+                                              float tolerance) :
+	_is_closed(is_closed)
+{
+	_table_distances.push_back(0.0f);
+	_table_parameters.push_back(0.0f);
+
+	auto const points_nb = control_points.size();
+	if (points_nb < 2u) {
+		LogError("A path needs at least two control points, but %zu were given.", points_nb);
+		return;
+	}
+
+	auto const get_point = [&control_points, points_nb, is_closed](std::ptrdiff_t i){
+		auto const count = static_cast<std::ptrdiff_t>(points_nb);
+		if (is_closed)
+			return control_points[static_cast<std::size_t>(((i % count) + count) % count)];
+		return control_points[static_cast<std::size_t>(std::min(std::max(i, std::ptrdiff_t(0)), count - 1))];
+	};
+
+	auto const basis = makeCatmullRomBasis(tension);
+	auto const segments_nb = is_closed ? points_nb : points_nb - 1u;
+	_segments.resize(segments_nb);
+	for (std::size_t s = 0u; s < segments_nb; ++s) {
+		auto const i = static_cast<std::ptrdiff_t>(s);
+		glm::vec3 const points[4] = { get_point(i - 1), get_point(i), get_point(i + 1), get_point(i + 2) };
+		for (int k = 0; k < 4; ++k)
+			_segments[s].coefficients[k] = basis.weights[k][0] * points[0] + basis.weights[k][1] * points[1]
+			                             + basis.weights[k][2] * points[2] + basis.weights[k][3] * points[3];
+	}
+
+	for (std::size_t s = 0u; s < segments_nb; ++s)
+		subdivide(s, 0.0f, 1.0f, _segments[s].coefficients[0], get_point(static_cast<std::ptrdiff_t>(s) + 1),
+		          tolerance, 0u);
+}
+
+float
+interpolation::CatmullRomPath::get_length() const
+{
+	return _table_distances.back();
+}
+
+std::size_t
+interpolation::CatmullRomPath::get_segments_nb() const
+{
+	return _segments.size();
+}
+
+bool
+interpolation::CatmullRomPath::is_closed() const
+{
+	return _is_closed;
+}
+
+glm::vec3 const*
+interpolation::CatmullRomPath::get_segment_coefficients(std::size_t segment_index) const
+{
+	return _segments[segment_index].coefficients;
+}
+
+float
+interpolation::CatmullRomPath::get_parameter(float distance) const
+{
+	auto const length = get_length();
+	if (length <= 0.0f)
+		return 0.0f;
+
+	if (_is_closed) {
+		distance = std::fmod(distance, length);
+		if (distance < 0.0f)
+			distance += length;
+	} else {
+		distance = std::min(std::max(distance, 0.0f), length);
+	}
+
+	// Find the entries surrounding |distance|, and interpolate linearly
+	// between their parameters: the table is fine enough for the curve to
+	// be considered straight in-between.
+	auto const next = std::upper_bound(_table_distances.begin() + 1, _table_distances.end() - 1, distance);
+	auto const i = static_cast<std::size_t>(next - _table_distances.begin()) - 1u;
+	auto const span = _table_distances[i + 1u] - _table_distances[i];
+	auto const ratio = span > 0.0f ? (distance - _table_distances[i]) / span : 0.0f;
+	return _table_parameters[i] + ratio * (_table_parameters[i + 1u] - _table_parameters[i]);
+}
+
+glm::vec3
+interpolation::CatmullRomPath::eval(float parameter) const
+{
+	if (_segments.empty())
+		return glm::vec3(0.0f);
+
+	float x = 0.0f;
+	auto const& c = _segments[locate(parameter, x)].coefficients;
+	return ((c[3] * x + c[2]) * x + c[1]) * x + c[0];
+}
+
+glm::vec3
+interpolation::CatmullRomPath::eval_tangent(float parameter) const
+{
+	if (_segments.empty())
+		return glm::vec3(0.0f);
+
+	float x = 0.0f;
+	auto const& c = _segments[locate(parameter, x)].coefficients;
+	return (3.0f * c[3] * x + 2.0f * c[2]) * x + c[1];
+}
+
+glm::vec3
+interpolation::CatmullRomPath::eval_at_distance(float distance) const
+{
+	return eval(get_parameter(distance));
+}
+
+std::size_t
+interpolation::CatmullRomPath::locate(float parameter, float& x) const
+{
+	auto const segments_nb = static_cast<float>(_segments.size());
+	if (_is_closed) {
+		parameter = std::fmod(parameter, segments_nb);
+		if (parameter < 0.0f)
+			parameter += segments_nb;
+	} else {
+		parameter = std::min(std::max(parameter, 0.0f), segments_nb);
+	}
+
+	auto const segment_index = std::min(static_cast<std::size_t>(parameter), _segments.size() - 1u);
+	x = parameter - static_cast<float>(segment_index);
+	return segment_index;
+}
+
+void
+interpolation::CatmullRomPath::subdivide(std::size_t segment_index, float x0, float x1,
+                                         glm::vec3 const& p0, glm::vec3 const& p1,
+                                         float tolerance, unsigned int depth)
+{
+	auto const xm = 0.5f * (x0 + x1);
+	auto const& c = _segments[segment_index].coefficients;
+	auto const pm = ((c[3] * xm + c[2]) * xm + c[1]) * xm + c[0];
+
+	auto const first_half_length = glm::distance(p0, pm);
+	auto const second_half_length = glm::distance(pm, p1);
+	auto const chord_length = glm::distance(p0, p1);
+	auto const is_flat_enough = first_half_length + second_half_length - chord_length <= tolerance;
+	if (depth >= max_subdivision_depth || (depth >= min_subdivision_depth && is_flat_enough)) {
+		auto const segment_start = static_cast<float>(segment_index);
+		_table_distances.push_back(_table_distances.back() + first_half_length);
+		_table_parameters.push_back(segment_start + xm);
+		_table_distances.push_back(_table_distances.back() + second_half_length);
+		_table_parameters.push_back(segment_start + x1);
+		return;
+	}
+
+	subdivide(segment_index, x0, xm, p0, pm, tolerance, depth + 1u);
+	subdivide(segment_index, xm, x1, pm, p1, tolerance, depth + 1u);
 }
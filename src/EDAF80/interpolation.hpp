@@ -2,6 +2,9 @@
 
 #include <glm/glm.hpp>
 
+#include <cstddef>
+#include <vector>
+
 namespace interpolation
 {
 	//! \brief Linearly interpolate a position between two points.
@@ -36,4 +39,154 @@ namespace interpolation
 	glm::vec3 evalCatmullRom(glm::vec3 const&p0, glm::vec3 const&p1,
 	                         glm::vec3 const&p2, glm::vec3 const&p3,
 	                         float const t, float const x);
+
+	//! \brief Catmull-Rom basis matrix for a given tension.
+	//!
+	//! Computing it once per tension, rather than for every evaluation,
+	//! leaves only a cubic polynomial per evaluated point.
+	struct catmull_rom_basis {
+		float tension{0.0f};
+		//! weights[k][i] is the weight of control point i in the
+		//! coefficient of x^k
+		float weights[4][4]{};
+	};
+
+	//! \brief Compute the Catmull-Rom basis matrix for the tension |t|.
+	catmull_rom_basis makeCatmullRomBasis(float const t);
+
+	//! \brief Positions stored as one array per component (SoA), so that
+	//!        several of them can be processed at once using SIMD.
+	struct soa_positions {
+		float const* x{nullptr};
+		float const* y{nullptr};
+		float const* z{nullptr};
+	};
+
+	//! \brief Destination for positions stored as one array per
+	//!        component.
+	struct soa_output {
+		float* x{nullptr};
+		float* y{nullptr};
+		float* z{nullptr};
+	};
+
+	//! \brief Same as `evalLERP()`, for |count| pairs of points, each
+	//!        interpolated at its own distance ratio.
+	//!
+	//! @param [in] p0 origin points
+	//! @param [in] p1 destination points
+	//! @param [in] xs distance ratios, one per pair
+	//! @param [in] count the number of pairs
+	//! @param [out] output the interpolated positions; it can alias |p0|
+	//!              or |p1|
+	void evalLERP(soa_positions const& p0, soa_positions const& p1,
+	              float const* xs, std::size_t const count,
+	              soa_output const& output);
+
+	//! \brief Same as `evalCatmullRom()`, on a single curve segment but at
+	//!        |count| different distance ratios.
+	//!
+	//! This is the fastest way to sample a segment, as the coefficients of
+	//! its polynomial only get computed once.
+	void evalCatmullRom(glm::vec3 const& p0, glm::vec3 const& p1,
+	                    glm::vec3 const& p2, glm::vec3 const& p3,
+	                    catmull_rom_basis const& basis,
+	                    float const* xs, std::size_t const count,
+	                    soa_output const& output);
+
+	//! \brief Same as `evalCatmullRom()`, on |count| different curve
+	//!        segments, each at its own distance ratio.
+	//!
+	//! The i-th segment goes through p1[i] and p2[i], with p0[i] and p3[i]
+	//! being its surrounding control points, and all segments share the
+	//! same tension.
+	void evalCatmullRom(soa_positions const& p0, soa_positions const& p1,
+	                    soa_positions const& p2, soa_positions const& p3,
+	                    catmull_rom_basis const& basis,
+	                    float const* xs, std::size_t const count,
+	                    soa_output const& output);
+
+	//! \brief Catmull-Rom curve going through a list of control points,
+	//!        which can be followed at constant speed.
+	//!
+	//! A table mapping distances along the curve to curve parameters is
+	//! built once, when creating the path, by adaptively subdividing each
+	//! segment until the chords match the curve closely enough. Finding
+	//! the position at a given distance is then a binary search in that
+	//! table, followed by the evaluation of a cubic polynomial whose
+	//! coefficients are also precomputed.
+	//!
+	//! The parameter of the curve goes from 0 to the number of segments,
+	//! with segment i covering [i, i + 1].
+	class CatmullRomPath
+	{
+	public:
+		//! \brief Build a path and its arc-length table.
+		//!
+		//! @param [in] control_points points the path goes through; at
+		//!             least two are needed
+		//! @param [in] tension tension of the Catmull-Rom segments
+		//! @param [in] is_closed whether the path loops back from the last
+		//!             control point to the first one; for open paths, the
+		//!             first and last control points get repeated to
+		//!             compute the end segments
+		//! @param [in] tolerance how much, in world units, the length of a
+		//!             chord in the table can differ from the length of the
+		//!             piece of curve it approximates
+		CatmullRomPath(std::vector<glm::vec3> const& control_points,
+		               float tension, bool is_closed = true,
+		               float tolerance = 1e-4f);
+
+		//! \brief Total length of the path.
+		float get_length() const;
+
+		//! \brief Number of segments, i.e. the largest parameter value.
+		std::size_t get_segments_nb() const;
+
+		//! \brief Whether the path loops back onto its first control point.
+		bool is_closed() const;
+
+		//! \brief Coefficients of the cubic polynomial of a segment, the
+		//!        k-th one going with x^k, x going from 0 to 1 over the
+		//!        segment.
+		//!
+		//! @return a pointer to the four coefficients of segment
+		//!         |segment_index|
+		glm::vec3 const* get_segment_coefficients(std::size_t segment_index) const;
+
+		//! \brief Find the parameter of the point |distance| away from the
+		//!        start of the path, in O(log n).
+		//!
+		//! Distances beyond the ends are wrapped around for closed paths,
+		//! and clamped for open ones.
+		float get_parameter(float distance) const;
+
+		//! \brief Evaluate the position at parameter |parameter|.
+		glm::vec3 eval(float parameter) const;
+
+		//! \brief Evaluate the (non-normalised) derivative of the position
+		//!        with respect to the parameter.
+		glm::vec3 eval_tangent(float parameter) const;
+
+		//! \brief Evaluate the position |distance| away from the start of
+		//!        the path.
+		glm::vec3 eval_at_distance(float distance) const;
+
+	private:
+		//! The cubic polynomial of each segment, coefficients[k] going
+		//! with x^k.
+		struct segment {
+			glm::vec3 coefficients[4];
+		};
+
+		std::size_t locate(float parameter, float& x) const;
+		void subdivide(std::size_t segment_index, float x0, float x1,
+		               glm::vec3 const& p0, glm::vec3 const& p1,
+		               float tolerance, unsigned int depth);
+
+		std::vector<segment> _segments;
+		std::vector<float> _table_distances;   //!< increasing distances from the start of the path
+		std::vector<float> _table_parameters;  //!< parameter at each of those distances
+		bool _is_closed;
+	};
 }
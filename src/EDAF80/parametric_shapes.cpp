@@ -1,159 +1,146 @@
 #include "parametric_shapes.hpp"
+#include "simd_lanes.hpp"
 #include "core/Log.h"
+#include "core/opengl.hpp"
 
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <tuple>
 #include <vector>
 
-bonobo::mesh_data
-parametric_shapes::createQuad(float const width, float const height,
-	unsigned int const horizontal_split_count,
-	unsigned int const vertical_split_count)
+namespace
 {
-	auto const horizontal_edges_count = horizontal_split_count + 1u;
-	auto const vertical_edges_count = vertical_split_count + 1u;
-	auto const horizontal_vertices_count = horizontal_edges_count + 1u;
-	auto const vertical_vertices_count = vertical_edges_count + 1u;
-	auto const vertices_nb = horizontal_vertices_count * vertical_vertices_count;
-
-	auto vertices = std::vector<glm::vec3>(vertices_nb);
-	auto normals = std::vector<glm::vec3>(vertices_nb);
-	auto binormals = std::vector<glm::vec3>(vertices_nb);
-	auto tangents = std::vector<glm::vec3>(vertices_nb);
-	auto texcoords = std::vector<glm::vec3>(vertices_nb);
-
-
-	size_t index = 0u;
-	// for all vertical vertices
-	for (size_t i = 0u; i < vertical_vertices_count; i++)
-	{
-		// for all horizontal vertices
-		for (size_t j = 0u; j < horizontal_vertices_count; j++)
-		{
-			// add vertex
-			vertices[index] = glm::vec3(
-				j * width / horizontal_vertices_count,
-				0,
-				i * height / vertical_vertices_count);
-
-			// tex coords go from 0 to 1 on the 2 axes (static cast to float otherwise they will round to int)
-			texcoords[index] = glm::vec3(
-				static_cast<float>(j) / static_cast<float>(horizontal_edges_count),
-				static_cast<float>(i) / static_cast<float>(vertical_edges_count),
-				0);
+	enum class shape_type : unsigned int {
+		quad = 0u,
+		sphere,
+		circle_ring
+	};
 
+	// Shapes are identified by their generator and all of its parameters;
+	// unused parameters are left at 0.
+	using shape_key = std::tuple<shape_type, float, float, unsigned int, unsigned int, parametric_shapes::index_layout>;
 
-			tangents[index] = glm::vec3(0, 0, 1);
+	std::map<shape_key, std::weak_ptr<bonobo::mesh_data const>> shapes_cache;
 
-			binormals[index] = glm::vec3(1, 0, 0);
-
-			// normals points up (posY)
-			normals[index] = glm::vec3(0, 1, 0);
-
-
-			++index;
+	template<typename Generator>
+	parametric_shapes::shared_mesh_data
+	getOrCreateShape(shape_key const& key, Generator const& generate)
+	{
+		auto const it = shapes_cache.find(key);
+		if (it != shapes_cache.end()) {
+			if (auto mesh = it->second.lock())
+				return mesh;
 		}
 
-	}
-
-	auto index_sets = std::vector<glm::uvec3>(2u * horizontal_edges_count * vertical_edges_count);
-
-	index = 0u;
-	for (size_t i = 0; i < vertical_edges_count; i++)
-	{
-		for (size_t j = 0; j < horizontal_edges_count; j++)
-		{
-			//first edge loop			3  4  5
-			//(counter clockwise)		  /|
-			//							 / |
-			//							0--1  2
-			//
-			// vertex 0: horizontal_vertices_count * (i + 0) + (j + 0)
-			// vertex 1: horizontal_vertices_count * (i + 0) + (j + 1)
-			// vertex 4: horizontal_vertices_count * (i + 1) + (j + 1)
-			index_sets[index] = glm::uvec3(horizontal_vertices_count * (i + 0u) + (j + 0u),
-				horizontal_vertices_count * (i + 0u) + (j + 1u),
-				horizontal_vertices_count * (i + 1u) + (j + 1u));
-			++index;
-
-			//second edge loop			3--4  5 
-			//(counter clockwise)  	    | /
-			//							|/ 
-			//							0  1  2 
-			// vertex 0: horizontal_vertices_count * (i + 0) + (j + 0)
-			// vertex 4: horizontal_vertices_count * (i + 1) + (j + 1)
-			// vertex 3: horizontal_vertices_count * (i + 1) + (j + 0)
-			index_sets[index] = glm::uvec3(horizontal_vertices_count * (i + 0u) + (j + 0u),
-				horizontal_vertices_count * (i + 1u) + (j + 1u),
-				horizontal_vertices_count * (i + 1u) + (j + 0u));
-			++index;
+		// Forget about the shapes nobody uses anymore, before adding a new
+		// one.
+		for (auto entry = shapes_cache.begin(); entry != shapes_cache.end();) {
+			if (entry->second.expired())
+				entry = shapes_cache.erase(entry);
+			else
+				++entry;
 		}
 
+		parametric_shapes::geometry_data geometry;
+		generate(geometry);
+		auto const mesh = parametric_shapes::shared_mesh_data(new bonobo::mesh_data(parametric_shapes::upload(geometry)),
+		                                                      [](bonobo::mesh_data const* data){
+			glDeleteBuffers(1, &data->ibo);
+			glDeleteBuffers(1, &data->bo);
+			glDeleteVertexArrays(1, &data->vao);
+			delete data;
+		});
+		shapes_cache[key] = mesh;
+
+		return mesh;
 	}
+}
 
-	//buffer and data code copied from createCircleRing(), but deleted everything except vertices and texcoords
-
+bonobo::mesh_data
+parametric_shapes::detail::upload(glm::vec3 const* vertices,
+	glm::vec3 const* normals,
+	glm::vec3 const* texcoords,
+	glm::vec3 const* tangents,
+	glm::vec3 const* binormals,
+	std::size_t vertices_nb,
+	glm::uint const* indices,
+	std::size_t indices_nb,
+	GLenum drawing_mode)
+{
 	bonobo::mesh_data data;
+	data.drawing_mode = drawing_mode;
+	data.uses_primitive_restart = drawing_mode == GL_TRIANGLE_STRIP;
+	data.bounds = bonobo::computeBounds(vertices, vertices_nb);
 	glGenVertexArrays(1, &data.vao);
 	assert(data.vao != 0u);
 	glBindVertexArray(data.vao);
 
 	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
+	auto const vertices_size = static_cast<GLsizeiptr>(vertices_nb * sizeof(glm::vec3));
 	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
+	auto const normals_size = normals != nullptr ? vertices_size : 0;
 	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
+	auto const texcoords_size = texcoords != nullptr ? vertices_size : 0;
 	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
+	auto const tangents_size = tangents != nullptr ? vertices_size : 0;
 	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-
-
+	auto const binormals_size = binormals != nullptr ? vertices_size : 0;
 	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
+		+ normals_size
 		+ texcoords_size
 		+ tangents_size
 		+ binormals_size
-		+ normals_size
 		);
 	glGenBuffers(1, &data.bo);
 	assert(data.bo != 0u);
 	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
 	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
 
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
+	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices));
 	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
 	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
 
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+	if (normals != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals));
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
+	}
 
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+	if (texcoords != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords));
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
+	}
 
+	if (tangents != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents));
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+	}
 
+	if (binormals != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals));
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0u);
 
-	data.indices_nb = static_cast<GLsizei>(index_sets.size() * 3u);
+	data.vertices_nb = static_cast<GLsizei>(vertices_nb);
+	data.indices_nb = static_cast<GLsizei>(indices_nb);
 	glGenBuffers(1, &data.ibo);
 	assert(data.ibo != 0u);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_sets.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(index_sets.data()), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices_nb * sizeof(glm::uint)), reinterpret_cast<GLvoid const*>(indices), GL_STATIC_DRAW);
 
 	glBindVertexArray(0u);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
@@ -161,146 +148,132 @@ parametric_shapes::createQuad(float const width, float const height,
 	return data;
 }
 
-bonobo::mesh_data
-parametric_shapes::createSphere(float const radius,
-	unsigned int const longitude_split_count,
-	unsigned int const latitude_split_count)
+parametric_shapes::index_statistics
+parametric_shapes::detail::computeIndexStatistics(glm::uint const* indices,
+	std::size_t indices_nb,
+	std::size_t vertices_nb,
+	bool uses_primitive_restart,
+	unsigned int cache_size)
 {
+	index_statistics statistics;
+	statistics.index_bytes = indices_nb * sizeof(glm::uint);
+
+	// A vertex is still in the FIFO cache if less than |cache_size|
+	// vertices were pushed to it since it last got pushed itself, so
+	// remembering when each vertex got pushed is all that is needed.
+	auto const never_pushed = std::numeric_limits<std::size_t>::max();
+	auto pushed_at = std::vector<std::size_t>(vertices_nb, never_pushed);
+	for (std::size_t i = 0u; i < indices_nb; ++i) {
+		auto const index = indices[i];
+		if (uses_primitive_restart && index == bonobo::primitive_restart_index)
+			continue;
+		assert(index < vertices_nb);
+
+		auto const last_push = pushed_at[index];
+		if (last_push != never_pushed && statistics.vertex_shader_invocations - last_push < cache_size)
+			continue;
+
+		pushed_at[index] = statistics.vertex_shader_invocations;
+		++statistics.vertex_shader_invocations;
+	}
 
-	//! \todo Implement this function
-
-	auto const longitude_edges_count = longitude_split_count + 1u;
-	auto const latitude_edges_count = latitude_split_count + 1u;
-	auto const longitude_vertices_count = longitude_edges_count + 1u;
-	auto const latitude_vertices_count = latitude_edges_count + 1u;
-	auto const vertices_nb = longitude_vertices_count * latitude_vertices_count;
-
-	auto vertices = std::vector<glm::vec3>(vertices_nb);
-	auto normals = std::vector<glm::vec3>(vertices_nb);
-	auto tangents = std::vector<glm::vec3>(vertices_nb);
-	auto binormals = std::vector<glm::vec3>(vertices_nb);
-	auto texcoords = std::vector<glm::vec3>(vertices_nb);
-
-
-	float const d_theta = glm::two_pi<float>() / (static_cast<float>(longitude_edges_count));
-	float const d_phi = glm::pi<float>() / (static_cast<float>(latitude_edges_count));
-
-	size_t index = 0u;
-	float theta = 0.0f;
-	float phi = 0.0f;
-	for (unsigned int i = 0u; i < longitude_vertices_count; ++i) {
-
-		float const cos_theta = std::cos(theta);
-		float const sin_theta = std::sin(theta);
-		phi = 0.0f;
-
-
-		for (unsigned int j = 0u; j < latitude_vertices_count; ++j) {
-			float const cos_phi = std::cos(phi);
-			float const sin_phi = std::sin(phi);
-			auto const v = glm::vec3(radius * sin_theta * sin_phi,
-				-radius * cos_phi,
-				radius * cos_theta * sin_phi);
-			vertices[index] = v;
-
-			auto const t = glm::normalize(glm::vec3(cos_theta,
-				0,
-				-sin_theta));
-			tangents[index] = t;
-
-			auto const b = glm::normalize(glm::vec3(sin_theta * cos_phi,
-				sin_phi,
-				cos_theta * cos_phi));
-			binormals[index] = b;
-
-			texcoords[index] = glm::vec3(static_cast<float>(i) / (static_cast<float>(longitude_vertices_count)),
-				static_cast<float>(j) / (static_cast<float>(latitude_vertices_count)),
-				0.0f);
-
-			normals[index] = glm::cross(t, b);
+	return statistics;
+}
 
-			phi += d_phi;
-			++index;
-		}
+bonobo::mesh_data
+parametric_shapes::createQuad(float const width, float const height,
+	unsigned int const horizontal_split_count,
+	unsigned int const vertical_split_count,
+	index_layout const layout)
+{
+	geometry_data geometry;
+	generateQuad(geometry, width, height, horizontal_split_count, vertical_split_count, layout);
+	return upload(geometry);
+}
 
-		theta += d_theta;
+bonobo::mesh_data
+parametric_shapes::createSphere(float const radius,
+	unsigned int const longitude_split_count,
+	unsigned int const latitude_split_count,
+	index_layout const layout)
+{
+	geometry_data geometry;
+	generateSphere(geometry, radius, longitude_split_count, latitude_split_count, layout);
+	return upload(geometry);
+}
 
-	}
+bonobo::mesh_data
+parametric_shapes::createTorus(float const major_radius,
+	float const minor_radius,
+	unsigned int const major_split_count,
+	unsigned int const minor_split_count)
+{
+	//! \todo (Optional) Implement this function
+	return bonobo::mesh_data();
+}
 
-	// create index array
-	auto index_sets = std::vector<glm::uvec3>(2u * latitude_edges_count * longitude_edges_count);
+bonobo::mesh_data
+parametric_shapes::createCircleRing(float const radius,
+	float const spread_length,
+	unsigned int const circle_split_count,
+	unsigned int const spread_split_count,
+	index_layout const layout)
+{
+	geometry_data geometry;
+	generateCircleRing(geometry, radius, spread_length, circle_split_count, spread_split_count, layout);
+	return upload(geometry);
+}
 
-	// generate indices iteratively
-	index = 0u;
-	for (unsigned int i = 0u; i < longitude_edges_count; ++i)
-	{
-		for (unsigned int j = 0u; j < latitude_edges_count; ++j)
-		{
-			index_sets[index] = glm::uvec3(latitude_vertices_count * (i + 1u) + (j + 1u),
-				latitude_vertices_count * (i + 0u) + (j + 1u),
-				latitude_vertices_count * (i + 0u) + (j + 0u));
-			++index;
-
-			index_sets[index] = glm::uvec3(latitude_vertices_count * (i + 1u) + (j + 0u),
-				latitude_vertices_count * (i + 1u) + (j + 1u),
-				latitude_vertices_count * (i + 0u) + (j + 0u));
-			++index;
+bonobo::mesh_data
+parametric_shapes::createPatches(unsigned int const u_patches_count,
+	unsigned int const v_patches_count)
+{
+	auto const u_vertices_count = u_patches_count + 1u;
+	auto const v_vertices_count = v_patches_count + 1u;
+
+	auto vertices = std::vector<glm::vec3>(u_vertices_count * v_vertices_count);
+	for (unsigned int i = 0u; i < v_vertices_count; ++i)
+		for (unsigned int j = 0u; j < u_vertices_count; ++j)
+			vertices[i * u_vertices_count + j] = glm::vec3(static_cast<float>(j) / static_cast<float>(u_patches_count),
+			                                               static_cast<float>(i) / static_cast<float>(v_patches_count),
+			                                               0.0f);
+
+	// Each patch goes through (u0, v0), (u1, v0), (u1, v1), (u0, v1), as
+	// expected by parametric_patch.tesc.
+	auto indices = std::vector<GLuint>();
+	indices.reserve(4u * u_patches_count * v_patches_count);
+	for (unsigned int i = 0u; i < v_patches_count; ++i) {
+		for (unsigned int j = 0u; j < u_patches_count; ++j) {
+			indices.push_back(u_vertices_count * (i + 0u) + (j + 0u));
+			indices.push_back(u_vertices_count * (i + 0u) + (j + 1u));
+			indices.push_back(u_vertices_count * (i + 1u) + (j + 1u));
+			indices.push_back(u_vertices_count * (i + 1u) + (j + 0u));
 		}
 	}
 
 	bonobo::mesh_data data;
+	data.drawing_mode = GL_PATCHES;
+	data.patch_vertices_nb = 4;
+	// The actual surface is only known once tessellated, so the bounds
+	// are left invalid, and the patches never get culled.
 	glGenVertexArrays(1, &data.vao);
 	assert(data.vao != 0u);
 	glBindVertexArray(data.vao);
 
-	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-		+ normals_size
-		+ texcoords_size
-		+ tangents_size
-		+ binormals_size
-		);
 	glGenBuffers(1, &data.bo);
 	assert(data.bo != 0u);
 	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
-
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3)), static_cast<GLvoid const*>(vertices.data()), GL_STATIC_DRAW);
 	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
 	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
-
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
-
 	glBindBuffer(GL_ARRAY_BUFFER, 0u);
 
-	data.indices_nb = static_cast<GLsizei>(index_sets.size() * 3u);
+	data.vertices_nb = static_cast<GLsizei>(vertices.size());
+	data.indices_nb = static_cast<GLsizei>(indices.size());
 	glGenBuffers(1, &data.ibo);
 	assert(data.ibo != 0u);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_sets.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(index_sets.data()), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(GLuint)), reinterpret_cast<GLvoid const*>(indices.data()), GL_STATIC_DRAW);
 
 	glBindVertexArray(0u);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
@@ -308,153 +281,267 @@ parametric_shapes::createSphere(float const radius,
 	return data;
 }
 
-bonobo::mesh_data
-parametric_shapes::createTorus(float const major_radius,
-	float const minor_radius,
-	unsigned int const major_split_count,
-	unsigned int const minor_split_count)
+namespace
 {
-	//! \todo (Optional) Implement this function
-	return bonobo::mesh_data();
+	// The pattern of |scales| and |offsets| repeats every three floats,
+	// and each group of lanes starts at any of the three phases: they
+	// hold enough repetitions to load a full group from any phase.
+	struct interleaved_row_kernel {
+		float const* table;
+		float* out;
+		float scales[simd::simd_lanes::width + 2u];
+		float offsets[simd::simd_lanes::width + 2u];
+
+		template<typename Lanes>
+		void run(std::size_t i) const
+		{
+			auto const phase = i % 3u;
+			Lanes::store(out + i, Lanes::add(Lanes::mul(Lanes::load(scales + phase), Lanes::load(table + i)),
+			                                 Lanes::load(offsets + phase)));
+		}
+	};
 }
 
-bonobo::mesh_data
-parametric_shapes::createCircleRing(float const radius,
-	float const spread_length,
-	unsigned int const circle_split_count,
-	unsigned int const spread_split_count)
+void
+parametric_shapes::detail::fillRow(glm::vec3* out, glm::vec3 const* table,
+                                   std::size_t vertices_nb,
+                                   glm::vec3 const& scale, glm::vec3 const& offset)
 {
-	auto const circle_slice_edges_count = circle_split_count + 1u;
-	auto const spread_slice_edges_count = spread_split_count + 1u;
-	auto const circle_slice_vertices_count = circle_slice_edges_count + 1u;
-	auto const spread_slice_vertices_count = spread_slice_edges_count + 1u;
-	auto const vertices_nb = circle_slice_vertices_count * spread_slice_vertices_count;
-
-	auto vertices = std::vector<glm::vec3>(vertices_nb);
-	auto normals = std::vector<glm::vec3>(vertices_nb);
-	auto texcoords = std::vector<glm::vec3>(vertices_nb);
-	auto tangents = std::vector<glm::vec3>(vertices_nb);
-	auto binormals = std::vector<glm::vec3>(vertices_nb);
-
-	float const spread_start = radius - 0.5f * spread_length;
-	float const d_theta = glm::two_pi<float>() / (static_cast<float>(circle_slice_edges_count));
-	float const d_spread = spread_length / (static_cast<float>(spread_slice_edges_count));
-
-	// generate vertices iteratively
-	size_t index = 0u;
-	float theta = 0.0f;
-	for (unsigned int i = 0u; i < circle_slice_vertices_count; ++i) {
-		float const cos_theta = std::cos(theta);
-		float const sin_theta = std::sin(theta);
-
-		float distance_to_centre = spread_start;
-		for (unsigned int j = 0u; j < spread_slice_vertices_count; ++j) {
-			// vertex
-			vertices[index] = glm::vec3(distance_to_centre * cos_theta,
-				distance_to_centre * sin_theta,
-				0.0f);
-
-			// texture coordinates
-			texcoords[index] = glm::vec3(static_cast<float>(j) / (static_cast<float>(spread_slice_vertices_count)),
-				static_cast<float>(i) / (static_cast<float>(circle_slice_vertices_count)),
-				0.0f);
-
-			// tangent
-			auto const t = glm::vec3(cos_theta, sin_theta, 0.0f);
-			tangents[index] = t;
-
-			// binormal
-			auto const b = glm::vec3(-sin_theta, cos_theta, 0.0f);
-			binormals[index] = b;
-
-			// normal
-			auto const n = glm::cross(t, b);
-			normals[index] = n;
-
-			distance_to_centre += d_spread;
-			++index;
-		}
+	static_assert(sizeof(glm::vec3) == 3u * sizeof(float), "Attributes are expected to be tightly packed.");
+
+	interleaved_row_kernel kernel;
+	kernel.table = reinterpret_cast<float const*>(table);
+	kernel.out = reinterpret_cast<float*>(out);
+	for (std::size_t k = 0u; k < simd::simd_lanes::width + 2u; ++k) {
+		kernel.scales[k] = scale[static_cast<glm::length_t>(k % 3u)];
+		kernel.offsets[k] = offset[static_cast<glm::length_t>(k % 3u)];
+	}
+	simd::forEachLanes(3u * vertices_nb, kernel);
+}
 
-		theta += d_theta;
+void
+parametric_shapes::setSurfaceUniforms(surface_uniform_locations& locations,
+	GLuint const program, surface_type const type,
+	glm::vec4 const& parameters,
+	float const target_edge_length,
+	glm::vec2 const& framebuffer_size)
+{
+	auto const link_count = utils::opengl::shader::get_link_count();
+	if (program != locations.program || link_count != locations.link_count) {
+		locations.surface_type = glGetUniformLocation(program, "surface_type");
+		locations.surface_parameters = glGetUniformLocation(program, "surface_parameters");
+		locations.target_edge_length = glGetUniformLocation(program, "target_edge_length");
+		locations.framebuffer_size = glGetUniformLocation(program, "framebuffer_size");
+		locations.program = program;
+		locations.link_count = link_count;
 	}
 
-	// create index array
-	auto index_sets = std::vector<glm::uvec3>(2u * circle_slice_edges_count * spread_slice_edges_count);
+	glUniform1i(locations.surface_type, static_cast<GLint>(type));
+	glUniform4fv(locations.surface_parameters, 1, glm::value_ptr(parameters));
+	glUniform1f(locations.target_edge_length, target_edge_length);
+	glUniform2fv(locations.framebuffer_size, 1, glm::value_ptr(framebuffer_size));
+}
 
-	// generate indices iteratively
-	index = 0u;
-	for (unsigned int i = 0u; i < circle_slice_edges_count; ++i)
+namespace
+{
+	// Mirrors the std140 layout of the ProceduralShape uniform block in
+	// procedural_shape.vert.
+	struct ProceduralShapeUniforms
 	{
-		for (unsigned int j = 0u; j < spread_slice_edges_count; ++j)
-		{
-			index_sets[index] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
-				spread_slice_vertices_count * (i + 0u) + (j + 1u),
-				spread_slice_vertices_count * (i + 1u) + (j + 1u));
-			++index;
-
-			index_sets[index] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
-				spread_slice_vertices_count * (i + 1u) + (j + 1u),
-				spread_slice_vertices_count * (i + 1u) + (j + 0u));
-			++index;
-		}
+		glm::vec4 parameters;
+		GLint type;
+		GLint u_segments;
+		GLint v_segments;
+		GLint padding;
+	};
+
+	void
+	uploadProceduralShapeUniforms(parametric_shapes::procedural_shape const& shape)
+	{
+		ProceduralShapeUniforms const uniforms{
+			shape.parameters,
+			static_cast<GLint>(shape.type),
+			static_cast<GLint>(shape.u_segments_count),
+			static_cast<GLint>(shape.v_segments_count),
+			0
+		};
+		glBindBuffer(GL_UNIFORM_BUFFER, shape.ubo);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uniforms), &uniforms);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0u);
 	}
+}
 
-	bonobo::mesh_data data;
-	glGenVertexArrays(1, &data.vao);
-	assert(data.vao != 0u);
-	glBindVertexArray(data.vao);
+parametric_shapes::procedural_shape
+parametric_shapes::createProceduralShape(surface_type const type,
+	glm::vec4 const& parameters,
+	unsigned int const u_segments_count,
+	unsigned int const v_segments_count)
+{
+	procedural_shape shape;
+	shape.type = type;
+	shape.parameters = parameters;
+	shape.u_segments_count = std::max(u_segments_count, 1u);
+	shape.v_segments_count = std::max(v_segments_count, 1u);
+
+	glGenVertexArrays(1, &shape.vao);
+	assert(shape.vao != 0u);
+
+	glGenBuffers(1, &shape.ubo);
+	assert(shape.ubo != 0u);
+	glBindBuffer(GL_UNIFORM_BUFFER, shape.ubo);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ProceduralShapeUniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+	uploadProceduralShapeUniforms(shape);
+
+	return shape;
+}
 
-	auto const vertices_offset = 0u;
-	auto const vertices_size = static_cast<GLsizeiptr>(vertices.size() * sizeof(glm::vec3));
-	auto const normals_offset = vertices_size;
-	auto const normals_size = static_cast<GLsizeiptr>(normals.size() * sizeof(glm::vec3));
-	auto const texcoords_offset = normals_offset + normals_size;
-	auto const texcoords_size = static_cast<GLsizeiptr>(texcoords.size() * sizeof(glm::vec3));
-	auto const tangents_offset = texcoords_offset + texcoords_size;
-	auto const tangents_size = static_cast<GLsizeiptr>(tangents.size() * sizeof(glm::vec3));
-	auto const binormals_offset = tangents_offset + tangents_size;
-	auto const binormals_size = static_cast<GLsizeiptr>(binormals.size() * sizeof(glm::vec3));
-	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-		+ normals_size
-		+ texcoords_size
-		+ tangents_size
-		+ binormals_size
-		);
-	glGenBuffers(1, &data.bo);
-	assert(data.bo != 0u);
-	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
-	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
+void
+parametric_shapes::setProceduralShapeSegments(procedural_shape& shape,
+	unsigned int const u_segments_count,
+	unsigned int const v_segments_count)
+{
+	shape.u_segments_count = std::max(u_segments_count, 1u);
+	shape.v_segments_count = std::max(v_segments_count, 1u);
+	uploadProceduralShapeUniforms(shape);
+}
 
-	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(vertices.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
+void
+parametric_shapes::destroyProceduralShape(procedural_shape& shape)
+{
+	glDeleteBuffers(1, &shape.ubo);
+	glDeleteVertexArrays(1, &shape.vao);
+	shape = procedural_shape();
+}
 
-	glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(normals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
+bool
+parametric_shapes::bindProceduralShapeBlock(GLuint const program, GLuint const binding)
+{
+	auto const block_index = glGetUniformBlockIndex(program, "ProceduralShape");
+	if (block_index == GL_INVALID_INDEX) {
+		LogError("Program %u has no ProceduralShape uniform block; procedural shapes can not be drawn with it.", program);
+		return false;
+	}
 
-	glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(texcoords.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
+	glUniformBlockBinding(program, block_index, binding);
+	return true;
+}
 
-	glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(tangents.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+void
+parametric_shapes::drawProceduralShape(procedural_shape const& shape, GLuint const binding)
+{
+	if (shape.vao == 0u)
+		return;
 
-	glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(binormals.data()));
-	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, shape.ubo);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+	// One instance per row of cells, two triangles per cell.
+	glBindVertexArray(shape.vao);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(6u * shape.u_segments_count),
+	                      static_cast<GLsizei>(shape.v_segments_count));
+	glBindVertexArray(0u);
+}
 
-	data.indices_nb = static_cast<GLsizei>(index_sets.size() * 3u);
-	glGenBuffers(1, &data.ibo);
-	assert(data.ibo != 0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index_sets.size() * sizeof(glm::uvec3)), reinterpret_cast<GLvoid const*>(index_sets.data()), GL_STATIC_DRAW);
+parametric_shapes::shared_mesh_data
+parametric_shapes::getQuad(float const width, float const height,
+	unsigned int const horizontal_split_count,
+	unsigned int const vertical_split_count,
+	index_layout const layout)
+{
+	return getOrCreateShape(shape_key(shape_type::quad, width, height, horizontal_split_count, vertical_split_count, layout),
+	                        [&](geometry_data& geometry){
+		generateQuad(geometry, width, height, horizontal_split_count, vertical_split_count, layout);
+	});
+}
 
-	glBindVertexArray(0u);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+parametric_shapes::shared_mesh_data
+parametric_shapes::getSphere(float const radius,
+	unsigned int const longitude_split_count,
+	unsigned int const latitude_split_count,
+	index_layout const layout)
+{
+	return getOrCreateShape(shape_key(shape_type::sphere, radius, 0.0f, longitude_split_count, latitude_split_count, layout),
+	                        [&](geometry_data& geometry){
+		generateSphere(geometry, radius, longitude_split_count, latitude_split_count, layout);
+	});
+}
 
-	return data;
+parametric_shapes::shared_mesh_data
+parametric_shapes::getCircleRing(float const radius,
+	float const spread_length,
+	unsigned int const circle_split_count,
+	unsigned int const spread_split_count,
+	index_layout const layout)
+{
+	return getOrCreateShape(shape_key(shape_type::circle_ring, radius, spread_length, circle_split_count, spread_split_count, layout),
+	                        [&](geometry_data& geometry){
+		generateCircleRing(geometry, radius, spread_length, circle_split_count, spread_split_count, layout);
+	});
+}
+
+parametric_shapes::sphere_lods
+parametric_shapes::createSphereLODs(float const radius,
+	unsigned int const coarsest_longitude_edges_count,
+	unsigned int const finest_longitude_edges_count)
+{
+	sphere_lods lods;
+	lods.radius = radius;
+
+	// At least 3 edges around the equator and 2 from pole to pole are
+	// needed to get a 3-D shape.
+	for (auto edges_count = std::max(coarsest_longitude_edges_count, 4u);
+	     edges_count <= std::max(finest_longitude_edges_count, 4u);
+	     edges_count *= 2u) {
+		lods.levels.push_back(getSphere(radius, edges_count - 1u, edges_count / 2u - 1u,
+		                                index_layout::triangle_strips));
+		lods.longitude_edges_counts.push_back(edges_count);
+	}
+
+	return lods;
+}
+
+float
+parametric_shapes::getProjectedRadius(glm::vec3 const& centre, float const radius,
+	FPSCameraf const& camera, float const viewport_height)
+{
+	auto const distance = glm::distance(camera.mWorld.GetTranslation(), centre);
+	// From inside the sphere, it covers the whole screen.
+	if (distance <= radius)
+		return std::numeric_limits<float>::max();
+
+	auto const half_height_at_unit_distance = std::tan(0.5f * camera.mFov);
+	return 0.5f * viewport_height * radius / (distance * half_height_at_unit_distance);
+}
+
+float
+parametric_shapes::getProjectedRadius(glm::vec3 const& centre, float const radius,
+	glm::mat4 const& world_to_clip,
+	float const viewport_height)
+{
+	// How much a world space length gets scaled along the clip space Y
+	// axis, before the perspective division; this ignores how the length
+	// is oriented relative to the view.
+	auto const y_scale = glm::length(glm::vec3(world_to_clip[0][1], world_to_clip[1][1], world_to_clip[2][1]));
+	auto const w = (world_to_clip * glm::vec4(centre, 1.0f)).w;
+	if (w <= radius * glm::length(glm::vec3(world_to_clip[0][3], world_to_clip[1][3], world_to_clip[2][3])))
+		return std::numeric_limits<float>::max();
+
+	return 0.5f * viewport_height * radius * y_scale / w;
+}
+
+std::size_t
+parametric_shapes::selectSphereLOD(sphere_lods const& lods,
+	float const projected_radius,
+	float const target_edge_length)
+{
+	assert(!lods.levels.empty());
+
+	// Edges are the longest along the equator, where they split a
+	// circumference of 2πr pixels.
+	auto const projected_circumference = glm::two_pi<float>() * projected_radius;
+	for (std::size_t level = 0u; level < lods.levels.size(); ++level)
+		if (projected_circumference <= target_edge_length * static_cast<float>(lods.longitude_edges_counts[level]))
+			return level;
+
+	return lods.levels.size() - 1u;
 }
@@ -2,8 +2,128 @@
 
 #include "core/helpers.hpp"
 
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace parametric_shapes
 {
+	//! \brief How the triangles of grid-based shapes are indexed.
+	enum class index_layout {
+		triangle_list,  //!< three indices per triangle, drawn as GL_TRIANGLES
+		triangle_strips //!< one strip per row of the grid, separated by
+		                //!< `bonobo::primitive_restart_index`, and drawn as
+		                //!< GL_TRIANGLE_STRIP; this needs about half as
+		                //!< many indices as a list.
+	};
+
+	//! \brief Geometry of a shape, as generated on the CPU.
+	//!
+	//! It does not rely on OpenGL in any way, so it can be generated from
+	//! any thread (or without any OpenGL context at all), kept around and
+	//! reused, before being uploaded using `upload()`.
+	//!
+	//! @tparam Allocator allocator template used for all the arrays, for
+	//!         example to allocate from an arena when generating many
+	//!         shapes in a row
+	template<template<typename> class Allocator = std::allocator>
+	struct basic_geometry_data {
+		template<typename T>
+		using array = std::vector<T, Allocator<T>>;
+
+		array<glm::vec3> vertices;   //!< positions, in model space
+		array<glm::vec3> normals;    //!< one per vertex
+		array<glm::vec3> texcoords;  //!< one per vertex
+		array<glm::vec3> tangents;   //!< one per vertex
+		array<glm::vec3> binormals;  //!< one per vertex
+		array<glm::uvec3> indices;   //!< three vertex indices per triangle
+		array<glm::uint> strip_indices; //!< triangle strips, when generated using
+		                                //!< `index_layout::triangle_strips`; if not
+		                                //!< empty, they are used instead of |indices|
+
+		//! \brief Resize all arrays, keeping their capacity if possible.
+		//!
+		//! The strip indices are emptied, as their size does not only
+		//! depend on the number of triangles.
+		void resize(std::size_t vertices_nb, std::size_t triangles_nb)
+		{
+			vertices.resize(vertices_nb);
+			normals.resize(vertices_nb);
+			texcoords.resize(vertices_nb);
+			tangents.resize(vertices_nb);
+			binormals.resize(vertices_nb);
+			indices.resize(triangles_nb);
+			strip_indices.clear();
+		}
+	};
+	using geometry_data = basic_geometry_data<>;
+
+	//! \brief Upload geometry to OpenGL.
+	//!
+	//! This has to be called from the thread owning the OpenGL context.
+	//!
+	//! @param geometry the geometry to upload; arrays other than the
+	//!                 vertices and indices ones can be left empty
+	//! @return wrapper around OpenGL objects' name containing the geometry
+	//!         data
+	template<template<typename> class Allocator>
+	bonobo::mesh_data upload(basic_geometry_data<Allocator> const& geometry);
+
+	//! \brief Cost of the indices of a mesh.
+	struct index_statistics {
+		std::size_t index_bytes{0u};               //!< size of the index buffer, i.e. what gets fetched for each draw
+		std::size_t vertex_shader_invocations{0u}; //!< estimated using a FIFO post-transform vertex cache
+	};
+
+	//! \brief Estimate the cost of drawing a shape, depending on how it
+	//!        was indexed.
+	//!
+	//! OpenGL 4.1 cannot count vertex shader invocations, so they are
+	//! estimated by running the indices through a FIFO cache of
+	//! |cache_size| vertices, which is how most GPUs reuse the output of
+	//! the vertex shader.
+	template<template<typename> class Allocator>
+	index_statistics computeIndexStatistics(basic_geometry_data<Allocator> const& geometry,
+	                                        unsigned int const cache_size = 32u);
+
+	//! \brief Generate the geometry of a quad, see `createQuad()`.
+	//!
+	//! @param [out] geometry where to write the generated geometry; its
+	//!              previous content is discarded but its memory reused
+	template<template<typename> class Allocator>
+	void generateQuad(basic_geometry_data<Allocator>& geometry,
+	                  float const width, float const height,
+	                  unsigned int const horizontal_split_count = 0u,
+	                  unsigned int const vertical_split_count = 0u,
+	                  index_layout const layout = index_layout::triangle_list);
+
+	//! \brief Generate the geometry of a sphere, see `createSphere()`.
+	//!
+	//! @param [out] geometry where to write the generated geometry; its
+	//!              previous content is discarded but its memory reused
+	template<template<typename> class Allocator>
+	void generateSphere(basic_geometry_data<Allocator>& geometry,
+	                    float const radius,
+	                    unsigned int const longitude_split_count,
+	                    unsigned int const latitude_split_count,
+	                    index_layout const layout = index_layout::triangle_list);
+
+	//! \brief Generate the geometry of a circle ring, see
+	//!        `createCircleRing()`.
+	//!
+	//! @param [out] geometry where to write the generated geometry; its
+	//!              previous content is discarded but its memory reused
+	template<template<typename> class Allocator>
+	void generateCircleRing(basic_geometry_data<Allocator>& geometry,
+	                        float const radius,
+	                        float const spread_length,
+	                        unsigned int const circle_split_count,
+	                        unsigned int const spread_split_count,
+	                        index_layout const layout = index_layout::triangle_list);
+
 	//! \brief Create a quad a given tesselation level and make it
 	//!        available to OpenGL.
 	//!
@@ -17,11 +137,13 @@ namespace parametric_shapes
 	//!                             should be split: 0 means each vertical
 	//!                             line consist of a single edge, 1 gives
 	//!                             you two edges, and so on.
+	//! @param layout how to index the triangles
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
 	bonobo::mesh_data createQuad(float const width, float const height,
 	                             unsigned int const horizontal_split_count = 0u,
-	                             unsigned int const vertical_split_count = 0u);
+	                             unsigned int const vertical_split_count = 0u,
+	                             index_layout const layout = index_layout::triangle_list);
 
 	//! \brief Create a sphere for a given tesselation level and make it
 	//!        available to OpenGL.
@@ -40,11 +162,13 @@ namespace parametric_shapes
 	//!                             edge spanning the full 180°, with 1 you
 	//!                             get two edges (each spanning 90°); 1 is
 	//!                             the minimum for getting a 3-D shape.
+	//! @param layout how to index the triangles
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
 	bonobo::mesh_data createSphere(float const radius,
 	                               unsigned int const longitude_split_count,
-	                               unsigned int const latitude_split_count);
+	                               unsigned int const latitude_split_count,
+	                               index_layout const layout = index_layout::triangle_list);
 
 	//! \brief Create a torus for a given tesselation level and make it
 	//!        available to OpenGL.
@@ -93,10 +217,220 @@ namespace parametric_shapes
 	//!                           single edge spanning the full spread,
 	//!                           with 1 you get two edges (each spanning
 	//!                           half the spread).
+	//! @param layout how to index the triangles
 	//! @return wrapper around OpenGL objects' name containing the geometry
 	//!         data
 	bonobo::mesh_data createCircleRing(float const radius,
 	                                   float const spread_length,
 	                                   unsigned int const circle_split_count,
-	                                   unsigned int const spread_split_count);
+	                                   unsigned int const spread_split_count,
+	                                   index_layout const layout = index_layout::triangle_list);
+
+	//! \brief Parametric surfaces that the `EDAF80/parametric_patch.*`
+	//!        shaders know how to evaluate.
+	//!
+	//! The meaning of the surface parameters depends on the type:
+	//! * quad: width and height;
+	//! * sphere: radius;
+	//! * torus: major and minor radii;
+	//! * circle_ring: radius and spread length.
+	enum class surface_type : int {
+		quad = 0,
+		sphere,
+		torus,
+		circle_ring
+	};
+
+	//! \brief Create a grid of coarse quad patches covering the [0, 1]²
+	//!        parametric domain, to be tessellated on the GPU.
+	//!
+	//! Each vertex only holds its (u, v) coordinates; the actual surface
+	//! is evaluated by the tessellation shaders, using the uniforms set
+	//! by `setSurfaceUniforms()`, and is refined depending on how large
+	//! each patch edge appears on screen.
+	//!
+	//! @param u_patches_count the number of patches along u
+	//! @param v_patches_count the number of patches along v
+	//! @return wrapper around OpenGL objects' name containing the patches,
+	//!         with a drawing mode of GL_PATCHES
+	bonobo::mesh_data createPatches(unsigned int const u_patches_count,
+	                                unsigned int const v_patches_count);
+
+	//! \brief Locations of the uniforms set by `setSurfaceUniforms()`,
+	//!        for the program they were queried from.
+	struct surface_uniform_locations {
+		GLint surface_type{-1};
+		GLint surface_parameters{-1};
+		GLint target_edge_length{-1};
+		GLint framebuffer_size{-1};
+		GLuint program{0u};          //!< program the locations were queried from
+		std::uint32_t link_count{0u}; //!< value of `utils::opengl::shader::get_link_count()` at that time
+	};
+
+	//! \brief Set the uniforms used by the `EDAF80/parametric_patch.*`
+	//!        shaders.
+	//!
+	//! @param locations cache of the uniform locations, only queried
+	//!                  again when |program| differs from the one they
+	//!                  come from, or when a program got linked since
+	//! @param program the OpenGL shader program, which should be in use
+	//! @param type the surface to evaluate
+	//! @param parameters the parameters of that surface, see `surface_type`
+	//! @param target_edge_length the length, in pixels, that edges should
+	//!                           have once tessellated
+	//! @param framebuffer_size the size in pixels of the framebuffer
+	//!                         rendered to
+	void setSurfaceUniforms(surface_uniform_locations& locations,
+	                        GLuint const program, surface_type const type,
+	                        glm::vec4 const& parameters,
+	                        float const target_edge_length,
+	                        glm::vec2 const& framebuffer_size);
+
+	//! \brief Shape generated entirely by the
+	//!        `EDAF80/procedural_shape.vert` shader, from `gl_VertexID`
+	//!        and `gl_InstanceID`, without any vertex data.
+	struct procedural_shape {
+		GLuint vao{0u};                            //!< empty Vertex Array Object, as one has to be bound when drawing
+		GLuint ubo{0u};                            //!< Uniform Buffer Object holding the parameters below
+		surface_type type{surface_type::quad};     //!< surface to evaluate
+		glm::vec4 parameters{0.0f};                //!< parameters of that surface, see `surface_type`
+		unsigned int u_segments_count{1u};         //!< number of cells along u
+		unsigned int v_segments_count{1u};         //!< number of cells along v
+	};
+
+	//! \brief Create a procedural shape.
+	//!
+	//! @param type the surface to evaluate
+	//! @param parameters the parameters of that surface, see `surface_type`
+	//! @param u_segments_count the number of cells along u
+	//! @param v_segments_count the number of cells along v
+	//! @return the OpenGL objects needed to draw the shape
+	procedural_shape createProceduralShape(surface_type const type,
+	                                       glm::vec4 const& parameters,
+	                                       unsigned int const u_segments_count,
+	                                       unsigned int const v_segments_count);
+
+	//! \brief Change the tessellation of a procedural shape.
+	//!
+	//! Only a few bytes of uniform data get updated, so this can be done
+	//! every frame.
+	void setProceduralShapeSegments(procedural_shape& shape,
+	                                unsigned int const u_segments_count,
+	                                unsigned int const v_segments_count);
+
+	//! \brief Release the OpenGL objects of a procedural shape.
+	void destroyProceduralShape(procedural_shape& shape);
+
+	//! \brief Assign the `ProceduralShape` block of |program| to
+	//!        |binding|.
+	//!
+	//! This has to be done again whenever |program| gets linked again.
+	//!
+	//! @return whether |program| has a `ProceduralShape` block
+	bool bindProceduralShapeBlock(GLuint const program, GLuint const binding = 0u);
+
+	//! \brief Draw a procedural shape using the currently bound program.
+	//!
+	//! @param shape the shape to draw
+	//! @param binding the uniform buffer binding point the
+	//!                `ProceduralShape` block of the program in use was
+	//!                assigned to, see `bindProceduralShapeBlock()`
+	void drawProceduralShape(procedural_shape const& shape, GLuint const binding = 0u);
+
+	//! \brief Mesh shared between all users asking for the same shape;
+	//!        its OpenGL objects are deleted once the last reference to
+	//!        it is released.
+	using shared_mesh_data = std::shared_ptr<bonobo::mesh_data const>;
+
+	//! \brief Same as `createQuad()`, but returns the mesh created by a
+	//!        previous call with the same parameters if it is still in use.
+	//!
+	//! Like all the `get*()` functions, it should only be called from the
+	//! thread owning the OpenGL context.
+	shared_mesh_data getQuad(float const width, float const height,
+	                         unsigned int const horizontal_split_count = 0u,
+	                         unsigned int const vertical_split_count = 0u,
+	                         index_layout const layout = index_layout::triangle_list);
+
+	//! \brief Same as `createSphere()`, but returns the mesh created by a
+	//!        previous call with the same parameters if it is still in use.
+	shared_mesh_data getSphere(float const radius,
+	                           unsigned int const longitude_split_count,
+	                           unsigned int const latitude_split_count,
+	                           index_layout const layout = index_layout::triangle_list);
+
+	//! \brief Same as `createCircleRing()`, but returns the mesh created by
+	//!        a previous call with the same parameters if it is still in
+	//!        use.
+	shared_mesh_data getCircleRing(float const radius,
+	                               float const spread_length,
+	                               unsigned int const circle_split_count,
+	                               unsigned int const spread_split_count,
+	                               index_layout const layout = index_layout::triangle_list);
+
+	//! \brief The same sphere at several tessellation levels.
+	struct sphere_lods {
+		float radius{0.0f};                                //!< radius shared by all levels
+		std::vector<shared_mesh_data> levels;              //!< from the coarsest to the finest
+		std::vector<unsigned int> longitude_edges_counts;  //!< number of edges around the equator of each level
+	};
+
+	//! \brief Create levels of detail for a sphere, doubling the number of
+	//!        edges from one level to the next.
+	//!
+	//! The levels are indexed as triangle strips, and come from the shared
+	//! cache, so several sets with the same radius share their meshes.
+	//!
+	//! @param radius radius of the sphere
+	//! @param coarsest_longitude_edges_count the number of edges around
+	//!                                       the equator of the coarsest
+	//!                                       level, with half as many
+	//!                                       from pole to pole
+	//! @param finest_longitude_edges_count the upper bound for the number
+	//!                                     of edges around the equator of
+	//!                                     the finest level
+	sphere_lods createSphereLODs(float const radius,
+	                             unsigned int const coarsest_longitude_edges_count = 8u,
+	                             unsigned int const finest_longitude_edges_count = 256u);
+
+	//! \brief Compute the radius, in pixels, of a sphere seen through a
+	//!        camera.
+	//!
+	//! Only the distance to the camera is used, and not where the sphere
+	//! lies in the view, so that turning the camera does not change the
+	//! levels of detail selected.
+	//!
+	//! @param centre the centre of the sphere, in world space
+	//! @param radius the radius of the sphere, in world space
+	//! @param camera the camera the sphere is seen through
+	//! @param viewport_height the height in pixels of the viewport
+	float getProjectedRadius(glm::vec3 const& centre, float const radius,
+	                         FPSCameraf const& camera, float const viewport_height);
+
+	//! \brief Same as above, for any world-to-clip transform, such as the
+	//!        one of a light.
+	//!
+	//! Both perspective and orthographic projections are supported.
+	float getProjectedRadius(glm::vec3 const& centre, float const radius,
+	                         glm::mat4 const& world_to_clip,
+	                         float const viewport_height);
+
+	//! \brief Select the coarsest level of detail whose edges, once
+	//!        projected, are at most |target_edge_length| pixels long.
+	//!
+	//! To keep shadows and picking consistent with what is on screen, the
+	//! selection should be done once per frame for the main view, and the
+	//! same level reused by the other passes drawing the sphere.
+	//!
+	//! @param lods the levels to choose from; must not be empty
+	//! @param projected_radius the radius of the sphere in pixels, see
+	//!                         `getProjectedRadius()`
+	//! @param target_edge_length the length, in pixels, that edges should
+	//!                           have at most on screen
+	//! @return the index of the selected level
+	std::size_t selectSphereLOD(sphere_lods const& lods,
+	                            float const projected_radius,
+	                            float const target_edge_length);
 }
+
+#include "parametric_shapes.inl"
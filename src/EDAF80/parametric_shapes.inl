@@ -0,0 +1,498 @@
+#include "parametric_shapes.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace parametric_shapes
+{
+	namespace detail
+	{
+		//! \brief Upload tightly packed attribute arrays to OpenGL; any
+		//!        attribute pointer but |vertices| can be null.
+		//!
+		//! Primitive restart gets enabled for GL_TRIANGLE_STRIP.
+		bonobo::mesh_data upload(glm::vec3 const* vertices,
+		                         glm::vec3 const* normals,
+		                         glm::vec3 const* texcoords,
+		                         glm::vec3 const* tangents,
+		                         glm::vec3 const* binormals,
+		                         std::size_t vertices_nb,
+		                         glm::uint const* indices,
+		                         std::size_t indices_nb,
+		                         GLenum drawing_mode);
+
+		//! \brief See `parametric_shapes::computeIndexStatistics()`.
+		index_statistics computeIndexStatistics(glm::uint const* indices,
+		                                        std::size_t indices_nb,
+		                                        std::size_t vertices_nb,
+		                                        bool uses_primitive_restart,
+		                                        unsigned int cache_size);
+
+		//! \brief Fill |table| with the cosine of |count| angles, going
+		//!        from 0 in steps of |step|, followed by their sine.
+		//!
+		//! The generators then only need O(rows + columns) calls to the
+		//! trigonometric functions instead of one per vertex.
+		template<template<typename> class Allocator>
+		void fillAngleTable(std::vector<float, Allocator<float>>& table,
+		                    unsigned int count, float step);
+
+		//! \brief Fill |vertices_nb| attributes of a grid row, each one
+		//!        computed as |scale| * |table|[j] + |offset|,
+		//!        component-wise.
+		//!
+		//! Everything varying along the row comes from |table|, and
+		//! everything varying from one row to the next from |scale| and
+		//! |offset|; the attributes are then processed as one flat array
+		//! of floats, several at a time using SIMD instructions, despite
+		//! their interleaved layout.
+		void fillRow(glm::vec3* out, glm::vec3 const* table,
+		             std::size_t vertices_nb,
+		             glm::vec3 const& scale, glm::vec3 const& offset);
+
+		//! \brief Fill |strip_indices| with one triangle strip per row of
+		//!        a grid of |rows_nb| by |row_edges_nb| cells, separated by
+		//!        `bonobo::primitive_restart_index`.
+		//!
+		//! Vertex (i, j) of the grid is expected to be found at index
+		//! i * (|row_edges_nb| + 1) + j.
+		//!
+		//! @param next_row_first whether each strip starts on row i + 1
+		//!                       rather than on row i, which flips the
+		//!                       winding of all triangles
+		template<template<typename> class Allocator>
+		void fillGridStrips(std::vector<glm::uint, Allocator<glm::uint>>& strip_indices,
+		                    unsigned int rows_nb, unsigned int row_edges_nb,
+		                    bool next_row_first);
+
+		//! \brief Call |kernel(first_row, end_row)| over [0, |rows_nb|),
+		//!        splitting the rows across threads when they contain
+		//!        enough vertices for it to pay off.
+		template<typename Kernel>
+		void forEachRowRange(unsigned int rows_nb, std::size_t vertices_per_row,
+		                     Kernel const& kernel);
+
+		//! Below this amount of vertices, spawning threads costs more than
+		//! it saves.
+		constexpr std::size_t min_vertices_per_thread = 16384u;
+	}
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+void
+parametric_shapes::detail::fillAngleTable(std::vector<float, Allocator<float>>& table,
+                                          unsigned int count, float step)
+{
+	table.resize(2u * count);
+	for (unsigned int i = 0u; i < count; ++i) {
+		// Computing the angle from the index rather than accumulating the
+		// step avoids drifting away from the expected final angle.
+		float const angle = static_cast<float>(i) * step;
+		table[i] = std::cos(angle);
+		table[count + i] = std::sin(angle);
+	}
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+void
+parametric_shapes::detail::fillGridStrips(std::vector<glm::uint, Allocator<glm::uint>>& strip_indices,
+                                          unsigned int rows_nb, unsigned int row_edges_nb,
+                                          bool next_row_first)
+{
+	auto const row_vertices_nb = row_edges_nb + 1u;
+	// Two indices per vertex of the row, plus the restart index, which
+	// the last strip does not need.
+	auto const strip_length = 2u * static_cast<std::size_t>(row_vertices_nb);
+	strip_indices.resize(rows_nb > 0u ? rows_nb * (strip_length + 1u) - 1u : 0u);
+	auto* const out = strip_indices.data();
+
+	forEachRowRange(rows_nb, strip_length, [&](unsigned int first_row, unsigned int end_row){
+		for (unsigned int i = first_row; i < end_row; ++i) {
+			auto index = static_cast<std::size_t>(i) * (strip_length + 1u);
+			auto const first_start = (i + (next_row_first ? 1u : 0u)) * row_vertices_nb;
+			auto const second_start = (i + (next_row_first ? 0u : 1u)) * row_vertices_nb;
+			for (unsigned int j = 0u; j < row_vertices_nb; ++j) {
+				out[index++] = first_start + j;
+				out[index++] = second_start + j;
+			}
+			if (i + 1u < rows_nb)
+				out[index] = bonobo::primitive_restart_index;
+		}
+	});
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<typename Kernel>
+void
+parametric_shapes::detail::forEachRowRange(unsigned int rows_nb, std::size_t vertices_per_row,
+                                           Kernel const& kernel)
+{
+	// Querying the hardware concurrency is not free, so small shapes are
+	// dealt with right away.
+	auto const max_useful_threads_nb = (static_cast<std::size_t>(rows_nb) * vertices_per_row) / min_vertices_per_thread;
+	if (max_useful_threads_nb <= 1u) {
+		kernel(0u, rows_nb);
+		return;
+	}
+
+	auto const hardware_threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+	auto const threads_nb = static_cast<unsigned int>(std::min<std::size_t>({ hardware_threads_nb, max_useful_threads_nb, rows_nb }));
+	if (threads_nb <= 1u) {
+		kernel(0u, rows_nb);
+		return;
+	}
+
+	// The calling thread takes care of the last range itself.
+	std::vector<std::thread> workers;
+	workers.reserve(threads_nb - 1u);
+	auto const rows_per_thread = rows_nb / threads_nb;
+	auto const remaining_rows = rows_nb % threads_nb;
+	unsigned int first_row = 0u;
+	for (unsigned int t = 0u; t < threads_nb; ++t) {
+		auto const end_row = first_row + rows_per_thread + (t < remaining_rows ? 1u : 0u);
+		if (t + 1u < threads_nb)
+			workers.emplace_back(kernel, first_row, end_row);
+		else
+			kernel(first_row, end_row);
+		first_row = end_row;
+	}
+	for (auto& worker : workers)
+		worker.join();
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+bonobo::mesh_data
+parametric_shapes::upload(basic_geometry_data<Allocator> const& geometry)
+{
+	auto const vertices_nb = geometry.vertices.size();
+	auto const get_attribute = [vertices_nb](typename basic_geometry_data<Allocator>::template array<glm::vec3> const& attribute){
+		return attribute.size() == vertices_nb ? attribute.data() : nullptr;
+	};
+
+	static_assert(sizeof(glm::uvec3) == 3u * sizeof(glm::uint), "Triangle indices are expected to be tightly packed.");
+	auto const use_strips = !geometry.strip_indices.empty();
+	return detail::upload(geometry.vertices.data(),
+	                      get_attribute(geometry.normals),
+	                      get_attribute(geometry.texcoords),
+	                      get_attribute(geometry.tangents),
+	                      get_attribute(geometry.binormals),
+	                      vertices_nb,
+	                      use_strips ? geometry.strip_indices.data() : reinterpret_cast<glm::uint const*>(geometry.indices.data()),
+	                      use_strips ? geometry.strip_indices.size() : 3u * geometry.indices.size(),
+	                      use_strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES);
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+parametric_shapes::index_statistics
+parametric_shapes::computeIndexStatistics(basic_geometry_data<Allocator> const& geometry,
+                                          unsigned int const cache_size)
+{
+	static_assert(sizeof(glm::uvec3) == 3u * sizeof(glm::uint), "Triangle indices are expected to be tightly packed.");
+	auto const use_strips = !geometry.strip_indices.empty();
+	return detail::computeIndexStatistics(use_strips ? geometry.strip_indices.data() : reinterpret_cast<glm::uint const*>(geometry.indices.data()),
+	                                      use_strips ? geometry.strip_indices.size() : 3u * geometry.indices.size(),
+	                                      geometry.vertices.size(), use_strips, cache_size);
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+void
+parametric_shapes::generateQuad(basic_geometry_data<Allocator>& geometry,
+	float const width, float const height,
+	unsigned int const horizontal_split_count,
+	unsigned int const vertical_split_count,
+	index_layout const layout)
+{
+	auto const horizontal_edges_count = horizontal_split_count + 1u;
+	auto const vertical_edges_count = vertical_split_count + 1u;
+	auto const horizontal_vertices_count = horizontal_edges_count + 1u;
+	auto const vertical_vertices_count = vertical_edges_count + 1u;
+	auto const vertices_nb = horizontal_vertices_count * vertical_vertices_count;
+
+	auto const use_strips = layout == index_layout::triangle_strips;
+	geometry.resize(vertices_nb, use_strips ? 0u : 2u * horizontal_edges_count * vertical_edges_count);
+	auto& vertices = geometry.vertices;
+	auto& normals = geometry.normals;
+	auto& binormals = geometry.binormals;
+	auto& tangents = geometry.tangents;
+	auto& texcoords = geometry.texcoords;
+
+
+	size_t index = 0u;
+	// for all vertical vertices
+	for (size_t i = 0u; i < vertical_vertices_count; i++)
+	{
+		// for all horizontal vertices
+		for (size_t j = 0u; j < horizontal_vertices_count; j++)
+		{
+			// add vertex
+			vertices[index] = glm::vec3(
+				j * width / horizontal_vertices_count,
+				0,
+				i * height / vertical_vertices_count);
+
+			// tex coords go from 0 to 1 on the 2 axes (static cast to float otherwise they will round to int)
+			texcoords[index] = glm::vec3(
+				static_cast<float>(j) / static_cast<float>(horizontal_edges_count),
+				static_cast<float>(i) / static_cast<float>(vertical_edges_count),
+				0);
+
+
+			tangents[index] = glm::vec3(0, 0, 1);
+
+			binormals[index] = glm::vec3(1, 0, 0);
+
+			// normals points up (posY)
+			normals[index] = glm::vec3(0, 1, 0);
+
+
+			++index;
+		}
+
+	}
+
+	if (use_strips) {
+		detail::fillGridStrips(geometry.strip_indices, vertical_edges_count, horizontal_edges_count, true);
+		return;
+	}
+
+	auto& index_sets = geometry.indices;
+
+	index = 0u;
+	for (size_t i = 0; i < vertical_edges_count; i++)
+	{
+		for (size_t j = 0; j < horizontal_edges_count; j++)
+		{
+			//first edge loop			3  4  5
+			//(counter clockwise)		  /|
+			//							 / |
+			//							0--1  2
+			//
+			// vertex 0: horizontal_vertices_count * (i + 0) + (j + 0)
+			// vertex 1: horizontal_vertices_count * (i + 0) + (j + 1)
+			// vertex 4: horizontal_vertices_count * (i + 1) + (j + 1)
+			index_sets[index] = glm::uvec3(horizontal_vertices_count * (i + 0u) + (j + 0u),
+				horizontal_vertices_count * (i + 0u) + (j + 1u),
+				horizontal_vertices_count * (i + 1u) + (j + 1u));
+			++index;
+
+			//second edge loop			3--4  5 
+			//(counter clockwise)  	    | /
+			//							|/ 
+			//							0  1  2 
+			// vertex 0: horizontal_vertices_count * (i + 0) + (j + 0)
+			// vertex 4: horizontal_vertices_count * (i + 1) + (j + 1)
+			// vertex 3: horizontal_vertices_count * (i + 1) + (j + 0)
+			index_sets[index] = glm::uvec3(horizontal_vertices_count * (i + 0u) + (j + 0u),
+				horizontal_vertices_count * (i + 1u) + (j + 1u),
+				horizontal_vertices_count * (i + 1u) + (j + 0u));
+			++index;
+		}
+
+	}
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+void
+parametric_shapes::generateSphere(basic_geometry_data<Allocator>& geometry,
+	float const radius,
+	unsigned int const longitude_split_count,
+	unsigned int const latitude_split_count,
+	index_layout const layout)
+{
+	auto const longitude_edges_count = longitude_split_count + 1u;
+	auto const latitude_edges_count = latitude_split_count + 1u;
+	auto const longitude_vertices_count = longitude_edges_count + 1u;
+	auto const latitude_vertices_count = latitude_edges_count + 1u;
+	auto const vertices_nb = longitude_vertices_count * latitude_vertices_count;
+
+	auto const use_strips = layout == index_layout::triangle_strips;
+	geometry.resize(vertices_nb, use_strips ? 0u : 2u * latitude_edges_count * longitude_edges_count);
+
+	// Precompute everything that only depends on the row or on the
+	// column: each row then boils down to a few multiply-adds between
+	// per-column tables and per-row factors.
+	float const d_theta = glm::two_pi<float>() / (static_cast<float>(longitude_edges_count));
+	float const d_phi = glm::pi<float>() / (static_cast<float>(latitude_edges_count));
+
+	typename basic_geometry_data<Allocator>::template array<float> theta_table;
+	detail::fillAngleTable(theta_table, longitude_vertices_count, d_theta);
+	auto const* const cos_theta_table = theta_table.data();
+	auto const* const sin_theta_table = theta_table.data() + longitude_vertices_count;
+
+	typename basic_geometry_data<Allocator>::template array<float> phi_table;
+	detail::fillAngleTable(phi_table, latitude_vertices_count, d_phi);
+	typename basic_geometry_data<Allocator>::template array<glm::vec3> position_table(latitude_vertices_count);
+	typename basic_geometry_data<Allocator>::template array<glm::vec3> binormal_table(latitude_vertices_count);
+	typename basic_geometry_data<Allocator>::template array<glm::vec3> texcoord_table(latitude_vertices_count);
+	for (unsigned int j = 0u; j < latitude_vertices_count; ++j) {
+		float const cos_phi = phi_table[j];
+		float const sin_phi = phi_table[latitude_vertices_count + j];
+		position_table[j] = glm::vec3(sin_phi, cos_phi, sin_phi);
+		binormal_table[j] = glm::vec3(cos_phi, sin_phi, cos_phi);
+		texcoord_table[j] = glm::vec3(0.0f, static_cast<float>(j) / (static_cast<float>(latitude_vertices_count)), 0.0f);
+	}
+
+	auto* const vertices = geometry.vertices.data();
+	auto* const normals = geometry.normals.data();
+	auto* const tangents = geometry.tangents.data();
+	auto* const binormals = geometry.binormals.data();
+	auto* const texcoords = geometry.texcoords.data();
+	auto* const index_sets = geometry.indices.data();
+
+	detail::forEachRowRange(longitude_vertices_count, latitude_vertices_count,
+	                        [&](unsigned int first_row, unsigned int end_row){
+		for (unsigned int i = first_row; i < end_row; ++i) {
+			float const cos_theta = cos_theta_table[i];
+			float const sin_theta = sin_theta_table[i];
+			float const u = static_cast<float>(i) / (static_cast<float>(longitude_vertices_count));
+			auto const row_start = static_cast<std::size_t>(i) * latitude_vertices_count;
+
+			// The normal is the unit position, which is also cross(t, b),
+			// and the tangent only depends on the longitude.
+			detail::fillRow(vertices + row_start, position_table.data(), latitude_vertices_count,
+			                glm::vec3(radius * sin_theta, -radius, radius * cos_theta), glm::vec3(0.0f));
+			detail::fillRow(normals + row_start, position_table.data(), latitude_vertices_count,
+			                glm::vec3(sin_theta, -1.0f, cos_theta), glm::vec3(0.0f));
+			detail::fillRow(binormals + row_start, binormal_table.data(), latitude_vertices_count,
+			                glm::vec3(sin_theta, 1.0f, cos_theta), glm::vec3(0.0f));
+			detail::fillRow(texcoords + row_start, texcoord_table.data(), latitude_vertices_count,
+			                glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(u, 0.0f, 0.0f));
+			std::fill_n(tangents + row_start, latitude_vertices_count, glm::vec3(cos_theta, 0.0f, -sin_theta));
+		}
+	});
+
+	if (use_strips) {
+		detail::fillGridStrips(geometry.strip_indices, longitude_edges_count, latitude_edges_count, false);
+		return;
+	}
+
+	// generate indices, two triangles per quad of the grid
+	detail::forEachRowRange(longitude_edges_count, latitude_edges_count,
+	                        [&](unsigned int first_row, unsigned int end_row){
+		for (unsigned int i = first_row; i < end_row; ++i)
+		{
+			auto index = 2u * static_cast<std::size_t>(i) * latitude_edges_count;
+			for (unsigned int j = 0u; j < latitude_edges_count; ++j)
+			{
+				index_sets[index] = glm::uvec3(latitude_vertices_count * (i + 1u) + (j + 1u),
+					latitude_vertices_count * (i + 0u) + (j + 1u),
+					latitude_vertices_count * (i + 0u) + (j + 0u));
+				++index;
+
+				index_sets[index] = glm::uvec3(latitude_vertices_count * (i + 1u) + (j + 0u),
+					latitude_vertices_count * (i + 1u) + (j + 1u),
+					latitude_vertices_count * (i + 0u) + (j + 0u));
+				++index;
+			}
+		}
+	});
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<template<typename> class Allocator>
+void
+parametric_shapes::generateCircleRing(basic_geometry_data<Allocator>& geometry,
+	float const radius,
+	float const spread_length,
+	unsigned int const circle_split_count,
+	unsigned int const spread_split_count,
+	index_layout const layout)
+{
+	auto const circle_slice_edges_count = circle_split_count + 1u;
+	auto const spread_slice_edges_count = spread_split_count + 1u;
+	auto const circle_slice_vertices_count = circle_slice_edges_count + 1u;
+	auto const spread_slice_vertices_count = spread_slice_edges_count + 1u;
+	auto const vertices_nb = circle_slice_vertices_count * spread_slice_vertices_count;
+
+	auto const use_strips = layout == index_layout::triangle_strips;
+	geometry.resize(vertices_nb, use_strips ? 0u : 2u * circle_slice_edges_count * spread_slice_edges_count);
+
+	float const spread_start = radius - 0.5f * spread_length;
+	float const d_theta = glm::two_pi<float>() / (static_cast<float>(circle_slice_edges_count));
+	float const d_spread = spread_length / (static_cast<float>(spread_slice_edges_count));
+
+	// As for the sphere, rows only combine per-column tables with a few
+	// per-row factors.
+	typename basic_geometry_data<Allocator>::template array<float> theta_table;
+	detail::fillAngleTable(theta_table, circle_slice_vertices_count, d_theta);
+	auto const* const cos_theta_table = theta_table.data();
+	auto const* const sin_theta_table = theta_table.data() + circle_slice_vertices_count;
+
+	typename basic_geometry_data<Allocator>::template array<glm::vec3> distance_table(spread_slice_vertices_count);
+	typename basic_geometry_data<Allocator>::template array<glm::vec3> texcoord_table(spread_slice_vertices_count);
+	for (unsigned int j = 0u; j < spread_slice_vertices_count; ++j) {
+		distance_table[j] = glm::vec3(spread_start + static_cast<float>(j) * d_spread);
+		texcoord_table[j] = glm::vec3(static_cast<float>(j) / (static_cast<float>(spread_slice_vertices_count)), 0.0f, 0.0f);
+	}
+
+	auto* const vertices = geometry.vertices.data();
+	auto* const normals = geometry.normals.data();
+	auto* const texcoords = geometry.texcoords.data();
+	auto* const tangents = geometry.tangents.data();
+	auto* const binormals = geometry.binormals.data();
+	auto* const index_sets = geometry.indices.data();
+
+	detail::forEachRowRange(circle_slice_vertices_count, spread_slice_vertices_count,
+	                        [&](unsigned int first_row, unsigned int end_row){
+		for (unsigned int i = first_row; i < end_row; ++i) {
+			float const cos_theta = cos_theta_table[i];
+			float const sin_theta = sin_theta_table[i];
+			float const v = static_cast<float>(i) / (static_cast<float>(circle_slice_vertices_count));
+			auto const row_start = static_cast<std::size_t>(i) * spread_slice_vertices_count;
+
+			detail::fillRow(vertices + row_start, distance_table.data(), spread_slice_vertices_count,
+			                glm::vec3(cos_theta, sin_theta, 0.0f), glm::vec3(0.0f));
+			detail::fillRow(texcoords + row_start, texcoord_table.data(), spread_slice_vertices_count,
+			                glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, v, 0.0f));
+
+			// The tangent space is constant along a row, and the normal
+			// cross(t, b) always points along +Z.
+			std::fill_n(tangents + row_start, spread_slice_vertices_count, glm::vec3(cos_theta, sin_theta, 0.0f));
+			std::fill_n(binormals + row_start, spread_slice_vertices_count, glm::vec3(-sin_theta, cos_theta, 0.0f));
+			std::fill_n(normals + row_start, spread_slice_vertices_count, glm::vec3(0.0f, 0.0f, 1.0f));
+		}
+	});
+
+	if (use_strips) {
+		detail::fillGridStrips(geometry.strip_indices, circle_slice_edges_count, spread_slice_edges_count, true);
+		return;
+	}
+
+	// generate indices, two triangles per quad of the grid
+	detail::forEachRowRange(circle_slice_edges_count, spread_slice_edges_count,
+	                        [&](unsigned int first_row, unsigned int end_row){
+		for (unsigned int i = first_row; i < end_row; ++i)
+		{
+			auto index = 2u * static_cast<std::size_t>(i) * spread_slice_edges_count;
+			for (unsigned int j = 0u; j < spread_slice_edges_count; ++j)
+			{
+				index_sets[index] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
+					spread_slice_vertices_count * (i + 0u) + (j + 1u),
+					spread_slice_vertices_count * (i + 1u) + (j + 1u));
+				++index;
+
+				index_sets[index] = glm::uvec3(spread_slice_vertices_count * (i + 0u) + (j + 0u),
+					spread_slice_vertices_count * (i + 1u) + (j + 1u),
+					spread_slice_vertices_count * (i + 1u) + (j + 0u));
+				++index;
+			}
+		}
+	});
+}
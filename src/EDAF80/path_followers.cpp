@@ -0,0 +1,149 @@
+#include "path_followers.hpp"
+
+#include "core/Log.h"
+#include "core/opengl.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace
+{
+	GLuint
+	createTextureBuffer(GLuint& bo, std::vector<float> const& data,
+	                    GLenum const internal_format, std::string const& name)
+	{
+		glGenBuffers(1, &bo);
+		assert(bo != 0u);
+		glBindBuffer(GL_TEXTURE_BUFFER, bo);
+		glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(data.size() * sizeof(float)), static_cast<GLvoid const*>(data.data()), GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0u);
+
+		GLuint texture = 0u;
+		glGenTextures(1, &texture);
+		assert(texture != 0u);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, internal_format, bo);
+		glBindTexture(GL_TEXTURE_BUFFER, 0u);
+
+		utils::opengl::debug::nameObject(GL_BUFFER, bo, name);
+		utils::opengl::debug::nameObject(GL_TEXTURE, texture, name + " texture");
+
+		return texture;
+	}
+}
+
+path_followers::path_data
+path_followers::uploadPath(interpolation::CatmullRomPath const& path,
+                           std::size_t const table_samples_nb)
+{
+	path_data data;
+	if (path.get_segments_nb() == 0u || table_samples_nb < 2u) {
+		LogError("Can not upload an empty path, or one with less than two table samples.");
+		return data;
+	}
+
+	std::vector<float> coefficients;
+	coefficients.reserve(path.get_segments_nb() * 4u * 3u);
+	for (std::size_t s = 0u; s < path.get_segments_nb(); ++s) {
+		auto const segment_coefficients = path.get_segment_coefficients(s);
+		for (std::size_t k = 0u; k < 4u; ++k) {
+			coefficients.push_back(segment_coefficients[k].x);
+			coefficients.push_back(segment_coefficients[k].y);
+			coefficients.push_back(segment_coefficients[k].z);
+		}
+	}
+
+	// Sampling the distances regularly turns the binary search done on the
+	// CPU into a direct lookup in the shader.
+	std::vector<float> parameters(table_samples_nb);
+	auto const length = path.get_length();
+	for (std::size_t i = 0u; i < table_samples_nb; ++i) {
+		auto const distance = length * static_cast<float>(i) / static_cast<float>(table_samples_nb - 1u);
+		parameters[i] = path.get_parameter(distance);
+	}
+	// Closed paths wrap around to parameter 0 when reaching their full
+	// length; keep the last sample at the end of the last segment instead,
+	// so that interpolating towards it does not go backwards.
+	parameters.back() = static_cast<float>(path.get_segments_nb());
+
+	data.coefficients_texture = createTextureBuffer(data.coefficients_bo, coefficients, GL_RGB32F, "Path followers coefficients");
+	data.parameters_texture = createTextureBuffer(data.parameters_bo, parameters, GL_R32F, "Path followers parameters");
+	data.segments_nb = static_cast<GLint>(path.get_segments_nb());
+	data.length = length;
+
+	return data;
+}
+
+void
+path_followers::destroyPath(path_data& path)
+{
+	glDeleteTextures(1, &path.parameters_texture);
+	glDeleteBuffers(1, &path.parameters_bo);
+	glDeleteTextures(1, &path.coefficients_texture);
+	glDeleteBuffers(1, &path.coefficients_bo);
+	path = path_data();
+}
+
+void
+path_followers::drawFollowers(path_data const& path,
+                              bonobo::mesh_data const& shape, GLuint const program,
+                              glm::mat4 const& world_to_clip,
+                              glm::vec3 const& light_position,
+                              crowd const& settings, float const time_s)
+{
+	if (path.coefficients_texture == 0u || shape.vao == 0u || program == 0u || settings.followers_nb == 0u)
+		return;
+
+	utils::opengl::debug::beginDebugGroup("Draw path followers");
+
+	// Wrap the distance on the CPU, where it can be done in double
+	// precision, so that the animation does not become choppy as time
+	// grows.
+	auto const travelled_distance = path.length > 0.0f
+	                              ? static_cast<float>(std::fmod(static_cast<double>(settings.speed) * time_s, static_cast<double>(path.length)))
+	                              : 0.0f;
+
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(world_to_clip));
+	glUniform3fv(glGetUniformLocation(program, "light_position"), 1, glm::value_ptr(light_position));
+	glUniform1i(glGetUniformLocation(program, "path_segments_nb"), path.segments_nb);
+	glUniform1f(glGetUniformLocation(program, "path_length"), path.length);
+	glUniform1f(glGetUniformLocation(program, "travelled_distance"), travelled_distance);
+	glUniform1f(glGetUniformLocation(program, "followers_spacing"), path.length / static_cast<float>(settings.followers_nb));
+	glUniform1f(glGetUniformLocation(program, "lane_radius"), settings.lane_radius);
+	glUniform3fv(glGetUniformLocation(program, "follower_scale"), 1, glm::value_ptr(settings.follower_scale));
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, path.coefficients_texture);
+	glUniform1i(glGetUniformLocation(program, "path_coefficients"), 0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, path.parameters_texture);
+	glUniform1i(glGetUniformLocation(program, "path_parameters"), 1);
+
+	if (shape.uses_primitive_restart) {
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(bonobo::primitive_restart_index);
+	}
+
+	auto const instances_nb = static_cast<GLsizei>(settings.followers_nb);
+	glBindVertexArray(shape.vao);
+	if (shape.ibo != 0u)
+		glDrawElementsInstanced(shape.drawing_mode, shape.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0), instances_nb);
+	else
+		glDrawArraysInstanced(shape.drawing_mode, 0, shape.vertices_nb, instances_nb);
+	glBindVertexArray(0u);
+
+	if (shape.uses_primitive_restart)
+		glDisable(GL_PRIMITIVE_RESTART);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0u);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0u);
+	glUseProgram(0u);
+
+	utils::opengl::debug::endDebugGroup();
+}
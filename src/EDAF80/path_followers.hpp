@@ -0,0 +1,75 @@
+#pragma once
+
+#include "interpolation.hpp"
+
+#include "core/helpers.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+//! \brief Crowds of objects following a Catmull-Rom path, animated
+//!        entirely by the `EDAF80/path_follower.vert` shader.
+//!
+//! The segment coefficients of the path, and a table mapping regularly
+//! spaced distances along the path to curve parameters, are stored once
+//! in texture buffers. Each instance then finds its own position and
+//! orientation from the current time and gl_InstanceID, so that the whole
+//! crowd is drawn with a single instanced draw call and no per-frame
+//! upload.
+namespace path_followers
+{
+	//! \brief Path uploaded to OpenGL texture buffers.
+	struct path_data {
+		GLuint coefficients_bo{0u};      //!< OpenGL name of the Buffer Object holding four RGB32F coefficients per segment
+		GLuint coefficients_texture{0u}; //!< OpenGL name of the texture buffer reading from |coefficients_bo|
+		GLuint parameters_bo{0u};        //!< OpenGL name of the Buffer Object holding the R32F distance-to-parameter table
+		GLuint parameters_texture{0u};   //!< OpenGL name of the texture buffer reading from |parameters_bo|
+		GLint segments_nb{0};            //!< number of segments in the path
+		float length{0.0f};              //!< total length of the path
+	};
+
+	//! \brief Settings shared by all followers of a crowd.
+	struct crowd {
+		std::size_t followers_nb{10000u};                //!< number of instances to draw
+		float speed{1.0f};                               //!< speed along the path, in world units per second
+		float lane_radius{0.3f};                         //!< followers get randomly spread within a disc of that radius around the path
+		glm::vec3 follower_scale{0.4f, 0.4f, 1.2f};      //!< scale of the follower shape, z being the direction of travel
+	};
+
+	//! \brief Upload a path to texture buffers.
+	//!
+	//! @param path the path to upload
+	//! @param table_samples_nb number of regularly spaced distances in the
+	//!                         table mapping distances to curve
+	//!                         parameters; the shader interpolates
+	//!                         linearly between them
+	path_data uploadPath(interpolation::CatmullRomPath const& path,
+	                     std::size_t const table_samples_nb = 1024u);
+
+	//! \brief Release the OpenGL objects of a path.
+	void destroyPath(path_data& path);
+
+	//! \brief Draw all followers of a crowd with a single instanced draw
+	//!        call.
+	//!
+	//! Followers are evenly spaced along the path, and all move at the
+	//! same speed; open paths are looped over as well.
+	//!
+	//! @param path the path to follow
+	//! @param shape the geometry drawn for each follower, using vertices
+	//!              and normals
+	//! @param program an OpenGL shader program using
+	//!                `EDAF80/path_follower.vert`
+	//! @param world_to_clip matrix transforming from world space to clip
+	//!                      space
+	//! @param light_position position of the light, in world space
+	//! @param settings settings of the crowd
+	//! @param time_s time elapsed since the start of the animation, in
+	//!               seconds
+	void drawFollowers(path_data const& path,
+	                   bonobo::mesh_data const& shape, GLuint const program,
+	                   glm::mat4 const& world_to_clip,
+	                   glm::vec3 const& light_position,
+	                   crowd const& settings, float const time_s);
+}
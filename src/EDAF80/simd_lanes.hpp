@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <immintrin.h>
+#endif
+
+//! \brief Thin wrappers giving scalars and SIMD registers the same
+//!        interface, so that each kernel only gets written once: the bulk
+//!        of the data is processed using `simd_lanes`, and what remains
+//!        using `scalar_lanes`.
+//!
+//! `simd_lanes` uses AVX when the compiler targets it, SSE2 otherwise on
+//! x86, and falls back to `scalar_lanes` elsewhere.
+namespace simd
+{
+	struct scalar_lanes {
+		using type = float;
+		static constexpr std::size_t width = 1u;
+
+		static type load(float const* data) { return *data; }
+		static void store(float* data, type value) { *data = value; }
+		static type broadcast(float value) { return value; }
+		static type add(type a, type b) { return a + b; }
+		static type sub(type a, type b) { return a - b; }
+		static type mul(type a, type b) { return a * b; }
+	};
+
+#if defined(__AVX__)
+	struct simd_lanes {
+		using type = __m256;
+		static constexpr std::size_t width = 8u;
+
+		static type load(float const* data) { return _mm256_loadu_ps(data); }
+		static void store(float* data, type value) { _mm256_storeu_ps(data, value); }
+		static type broadcast(float value) { return _mm256_set1_ps(value); }
+		static type add(type a, type b) { return _mm256_add_ps(a, b); }
+		static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+		static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+	};
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	struct simd_lanes {
+		using type = __m128;
+		static constexpr std::size_t width = 4u;
+
+		static type load(float const* data) { return _mm_loadu_ps(data); }
+		static void store(float* data, type value) { _mm_storeu_ps(data, value); }
+		static type broadcast(float value) { return _mm_set1_ps(value); }
+		static type add(type a, type b) { return _mm_add_ps(a, b); }
+		static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+		static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+	};
+#else
+	using simd_lanes = scalar_lanes;
+#endif
+
+	//! \brief Call |kernel.template run<Lanes>(i)| for every group of
+	//!        lanes in [0, |count|).
+	template<typename Kernel>
+	void
+	forEachLanes(std::size_t const count, Kernel const& kernel)
+	{
+		std::size_t i = 0u;
+		for (; i + simd_lanes::width <= count; i += simd_lanes::width)
+			kernel.template run<simd_lanes>(i);
+		for (; i < count; ++i)
+			kernel.template run<scalar_lanes>(i);
+	}
+}
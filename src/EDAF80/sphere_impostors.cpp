@@ -0,0 +1,117 @@
+#include "sphere_impostors.hpp"
+
+#include "core/Log.h"
+#include "core/opengl.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+sphere_impostors::instance
+sphere_impostors::makeInstance(glm::mat4 const& model_to_world, float const radius)
+{
+	auto const x_axis = glm::vec3(model_to_world[0]);
+	auto const y_axis = glm::vec3(model_to_world[1]);
+	auto const z_axis = glm::vec3(model_to_world[2]);
+	auto const scales = glm::vec3(glm::length(x_axis), glm::length(y_axis), glm::length(z_axis));
+	auto const rotation = glm::quat_cast(glm::mat3(x_axis / scales.x, y_axis / scales.y, z_axis / scales.z));
+
+	instance data;
+	data.centre_radius = glm::vec4(glm::vec3(model_to_world[3]), radius * std::max({ scales.x, scales.y, scales.z }));
+	data.orientation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+	return data;
+}
+
+sphere_impostors::batch
+sphere_impostors::createBatch()
+{
+	batch instances;
+
+	glGenVertexArrays(1, &instances.vao);
+	assert(instances.vao != 0u);
+	glBindVertexArray(instances.vao);
+
+	glGenBuffers(1, &instances.instances_bo);
+	assert(instances.instances_bo != 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, instances.instances_bo);
+
+	// The quad corners are derived from gl_VertexID; only the instance
+	// data comes from buffers.
+	glEnableVertexAttribArray(0u);
+	glVertexAttribPointer(0u, 4, GL_FLOAT, GL_FALSE, sizeof(instance), reinterpret_cast<GLvoid const*>(offsetof(instance, centre_radius)));
+	glVertexAttribDivisor(0u, 1u);
+	glEnableVertexAttribArray(1u);
+	glVertexAttribPointer(1u, 4, GL_FLOAT, GL_FALSE, sizeof(instance), reinterpret_cast<GLvoid const*>(offsetof(instance, orientation)));
+	glVertexAttribDivisor(1u, 1u);
+
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+	utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, instances.vao, "Sphere impostors VAO");
+	utils::opengl::debug::nameObject(GL_BUFFER, instances.instances_bo, "Sphere impostors instances");
+
+	return instances;
+}
+
+void
+sphere_impostors::destroyBatch(batch& instances)
+{
+	glDeleteBuffers(1, &instances.instances_bo);
+	glDeleteVertexArrays(1, &instances.vao);
+	instances = batch();
+}
+
+void
+sphere_impostors::updateBatch(batch& instances, std::vector<instance> const& data)
+{
+	if (instances.instances_bo == 0u) {
+		LogError("The batch was not created using createBatch(); it will not be updated.");
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances.instances_bo);
+	if (data.size() > instances.capacity) {
+		// Leave some room to grow, to avoid reallocating every frame when
+		// instances keep getting added.
+		instances.capacity = std::max(data.size(), 2u * instances.capacity);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instances.capacity * sizeof(instance)), nullptr, GL_STREAM_DRAW);
+	}
+	if (!data.empty())
+		glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(data.size() * sizeof(instance)), static_cast<GLvoid const*>(data.data()));
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+	instances.instances_nb = data.size();
+}
+
+void
+sphere_impostors::drawBatch(batch const& instances, GLuint const program,
+                            glm::mat4 const& world_to_clip,
+                            glm::vec3 const& camera_position,
+                            GLuint const diffuse_texture)
+{
+	if (instances.vao == 0u || instances.instances_nb == 0u || program == 0u)
+		return;
+
+	utils::opengl::debug::beginDebugGroup("Draw sphere impostors");
+
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(world_to_clip));
+	glUniform3fv(glGetUniformLocation(program, "camera_position"), 1, glm::value_ptr(camera_position));
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, diffuse_texture);
+	glUniform1i(glGetUniformLocation(program, "diffuse_texture"), 0);
+	glUniform1i(glGetUniformLocation(program, "has_diffuse_texture"), diffuse_texture != 0u ? 1 : 0);
+
+	glBindVertexArray(instances.vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.instances_nb));
+	glBindVertexArray(0u);
+
+	glBindTexture(GL_TEXTURE_2D, 0u);
+	glUseProgram(0u);
+
+	utils::opengl::debug::endDebugGroup();
+}
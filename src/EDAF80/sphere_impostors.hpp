@@ -0,0 +1,69 @@
+#pragma once
+
+#include "core/helpers.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+//! \brief Spheres rendered as camera-facing quads, which the
+//!        `EDAF80/sphere_impostor.*` shaders turn into pixel-perfect
+//!        spheres by intersecting each view ray with the sphere.
+//!
+//! Each sphere only costs four vertices, whatever its size on screen, and
+//! all spheres sharing a texture are drawn with a single instanced draw
+//! call.
+namespace sphere_impostors
+{
+	//! \brief Per-instance data, laid out as expected by
+	//!        `EDAF80/sphere_impostor.vert`.
+	struct instance {
+		glm::vec4 centre_radius{0.0f};                       //!< centre in world space, and radius
+		glm::vec4 orientation{0.0f, 0.0f, 0.0f, 1.0f};       //!< rotation from model to world space, as an (x, y, z, w) quaternion
+	};
+
+	//! \brief Compute the instance data for a sphere of radius
+	//!        |radius| in model space, transformed by |model_to_world|.
+	//!
+	//! The matrix may be scaled, but only the largest of its scale
+	//! factors is kept; shears are not supported.
+	instance makeInstance(glm::mat4 const& model_to_world, float const radius = 1.0f);
+
+	//! \brief Instances uploaded to OpenGL and ready to be drawn.
+	struct batch {
+		GLuint vao{0u};               //!< OpenGL name of the Vertex Array Object
+		GLuint instances_bo{0u};      //!< OpenGL name of the Buffer Object holding the instances
+		std::size_t capacity{0u};     //!< number of instances that fit in |instances_bo|
+		std::size_t instances_nb{0u}; //!< number of instances to draw
+	};
+
+	//! \brief Create an empty batch.
+	batch createBatch();
+
+	//! \brief Release the OpenGL objects of a batch.
+	void destroyBatch(batch& instances);
+
+	//! \brief Replace the instances of a batch.
+	//!
+	//! The buffer only gets reallocated when it is too small, so this can
+	//! be done every frame.
+	void updateBatch(batch& instances, std::vector<instance> const& data);
+
+	//! \brief Draw all instances of a batch.
+	//!
+	//! @param instances the batch to draw
+	//! @param program an OpenGL shader program using the
+	//!                `EDAF80/sphere_impostor.*` shaders
+	//! @param world_to_clip matrix transforming from world space to clip
+	//!                      space
+	//! @param camera_position position of the camera, in world space
+	//! @param diffuse_texture texture mapped onto all spheres of the
+	//!                        batch, the same way as onto the spheres from
+	//!                        `parametric_shapes::createSphere()`; 0 for
+	//!                        none
+	void drawBatch(batch const& instances, GLuint const program,
+	               glm::mat4 const& world_to_clip,
+	               glm::vec3 const& camera_position,
+	               GLuint const diffuse_texture);
+}
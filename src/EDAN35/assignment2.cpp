@@ -5,12 +5,18 @@
 #include "assignment2.hpp"
 
 #include "config.hpp"
+#include "core/animation.hpp"
 #include "core/Bonobo.h"
+#include "core/culling.hpp"
 #include "core/FPSCamera.h"
 #include "core/helpers.hpp"
+#include "core/materials.hpp"
 #include "core/node.hpp"
 #include "core/opengl.hpp"
 #include "core/ShaderProgramManager.hpp"
+#include "core/skinning.hpp"
+#include "core/static_meshes.hpp"
+#include "core/texture_arrays.hpp"
 
 #include <imgui.h>
 #include <glm/glm.hpp>
@@ -18,9 +24,13 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <tinyfiledialogs.h>
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <clocale>
 #include <cstdlib>
+#include <limits>
+#include <numeric>
 #include <stdexcept>
 
 namespace constant
@@ -103,12 +113,19 @@ namespace
 		glm::mat4 view_projection_inverse = glm::mat4(1.0f);
 	};
 
-	struct GeometryTextureData
+	//! Characters sharing the same skinned meshes, each playing its own
+	//! animation.
+	struct SkinnedCharacters
 	{
-		GLuint diffuse_texture_id{ 0u };
-		GLuint specular_texture_id{ 0u };
-		GLuint normals_texture_id{ 0u };
-		GLuint opacity_texture_id{ 0u };
+		bonobo::skinning::rig_data rig;
+		std::vector<bonobo::mesh_data> meshes;
+		std::vector<GLint> meshes_material_index;     //!< index of each mesh's material in the scene material buffer
+		bonobo::texture_arrays::texture_array_set texture_arrays;
+		std::vector<bonobo::skinning::instance> instances;
+		std::vector<glm::mat4> instances_model_to_world;
+		std::vector<glm::mat4> instances_normal_model_to_world;
+		std::vector<bonobo::skinning::affine_transform> palettes;
+		bonobo::skinning::palette_buffer palette_buffer;
 	};
 
 	struct GBufferShaderLocations
@@ -116,14 +133,10 @@ namespace
 		GLuint ubo_CameraViewProjTransforms{ 0u };
 		GLuint vertex_model_to_world{ 0u };
 		GLuint normal_model_to_world{ 0u };
-		GLuint diffuse_texture{ 0u };
-		GLuint specular_texture{ 0u };
-		GLuint normals_texture{ 0u };
-		GLuint opacity_texture{ 0u };
-		GLuint has_diffuse_texture{ 0u };
-		GLuint has_specular_texture{ 0u };
-		GLuint has_normals_texture{ 0u };
-		GLuint has_opacity_texture{ 0u };
+		GLuint texture_arrays{ 0u };
+		GLuint material_index{ 0u };
+		GLuint joint_palettes{ 0u };
+		GLuint palette_offset{ 0u };
 	};
 	void fillGBufferShaderLocations(GLuint gbuffer_shader, GBufferShaderLocations& locations);
 
@@ -132,8 +145,10 @@ namespace
 		GLuint ubo_LightViewProjTransforms{ 0u };
 		GLuint light_index{ 0u };
 		GLuint vertex_model_to_world{ 0u };
-		GLuint opacity_texture{ 0u };
-		GLuint has_opacity_texture{ 0u };
+		GLuint texture_arrays{ 0u };
+		GLuint material_index{ 0u };
+		GLuint joint_palettes{ 0u };
+		GLuint palette_offset{ 0u };
 	};
 	void fillShadowmapShaderLocations(GLuint shadowmap_shader, FillShadowmapShaderLocations& locations);
 
@@ -185,39 +200,119 @@ edan35::Assignment2::~Assignment2()
 void
 edan35::Assignment2::run()
 {
-	// Load the geometry of Sponza
-	auto const sponza_geometry = bonobo::loadObjects(config::resources_path("sponza/sponza.obj"));
+	// Load the geometry of Sponza, packing the textures of each material into
+	// two textures to reduce the amount of texture fetches, and grouping
+	// all of them into a few texture arrays so that they can be bound once
+	// for the whole scene.
+	bonobo::texture_arrays::texture_array_set sponza_texture_arrays;
+	bonobo::load_options sponza_options;
+	sponza_options.pack_textures = true;
+	sponza_options.batch_by_material = true;
+	sponza_options.arrays = &sponza_texture_arrays;
+	auto const sponza_geometry = bonobo::loadObjects(config::resources_path("sponza/sponza.obj"), sponza_options);
 	if (sponza_geometry.empty()) {
 		LogError("Failed to load the Sponza model");
 		return;
 	}
-	std::vector<GeometryTextureData> sponza_geometry_texture_data;
-	sponza_geometry_texture_data.reserve(sponza_geometry.size());
-	for (auto const& geometry : sponza_geometry) {
-		auto const diffuse_texture = geometry.bindings.find("diffuse_texture");
-		auto const specular_texture = geometry.bindings.find("specular_texture");
-		auto const normals_texture = geometry.bindings.find("normals_texture");
-		auto const opacity_texture = geometry.bindings.find("opacity_texture");
-
-		GeometryTextureData data;
-		if (diffuse_texture != geometry.bindings.end())
-		{
-			data.diffuse_texture_id = diffuse_texture->second;
+	// The render loops below only go through the compact draw records; the
+	// names and texture layers are kept in separate, rarely accessed tables.
+	auto const sponza_draw_list = [&sponza_geometry](){
+		auto draw_list = bonobo::createDrawList(sponza_geometry);
+		if (draw_list.materials.size() > bonobo::materials::max_materials_nb) {
+			LogError("Sponza comes with %zu materials, but only %zu fit in the material buffer; the batches using the others will use the first material instead.",
+			         draw_list.materials.size(), bonobo::materials::max_materials_nb);
+			for (auto& record : draw_list.records)
+				if (record.material_id >= bonobo::materials::max_materials_nb)
+					record.material_id = 0u;
 		}
-		if (specular_texture != geometry.bindings.end())
-		{
-			data.specular_texture_id = specular_texture->second;
+		return draw_list;
+	}();
+
+	// All material constants live in a single uniform buffer, uploaded
+	// once: Sponza's materials come first, so that their indices are the
+	// material IDs of the draw records, followed by those of the skinned
+	// characters once loaded.
+	std::vector<bonobo::materials::gpu_material> scene_materials;
+	scene_materials.reserve(sponza_draw_list.materials.size());
+	for (std::size_t m = 0; m < sponza_draw_list.materials.size(); ++m)
+		scene_materials.push_back(bonobo::materials::makeMaterial(sponza_draw_list.materials[m], sponza_draw_list.material_bindings[m], sponza_draw_list.material_layer_bindings[m]));
+	for (auto const& record : sponza_draw_list.records)
+		assert(record.material_id < bonobo::materials::max_materials_nb);
+	auto scene_material_buffer = bonobo::materials::createMaterialBuffer();
+	bonobo::materials::updateMaterialBuffer(scene_material_buffer, scene_materials);
+
+	// Sponza does not move, so the hierarchy over its bounds is built once
+	// and for all; its model space is also the world space.
+	bonobo::culling::BoundingVolumeHierarchy sponza_bvh;
+	sponza_bvh.build(sponza_draw_list.bounds);
+	bool use_frustum_culling = true;
+	std::vector<std::uint32_t> sponza_visible_records;
+	sponza_visible_records.reserve(sponza_draw_list.records.size());
+	std::size_t sponza_gbuffer_records_nb = sponza_draw_list.records.size();
+	auto const select_sponza_records = [&sponza_bvh, &sponza_draw_list, &sponza_visible_records, &use_frustum_culling](glm::mat4 const& world_to_clip){
+		if (use_frustum_culling) {
+			sponza_bvh.query(bonobo::culling::extractFrustum(world_to_clip), sponza_visible_records);
+			return;
 		}
-		if (normals_texture != geometry.bindings.end())
-		{
-			data.normals_texture_id = normals_texture->second;
+		sponza_visible_records.resize(sponza_draw_list.records.size());
+		std::iota(sponza_visible_records.begin(), sponza_visible_records.end(), 0u);
+	};
+
+	// Skinned characters can be loaded at runtime from the “Scene Controls”
+	// window; they are drawn in the G-buffer and shadow map passes using
+	// the skinned variants of the shaders.
+	SkinnedCharacters characters;
+	characters.palette_buffer = bonobo::skinning::createPaletteBuffer();
+	int characters_nb = 16;
+	int character_clip = 0;
+	float character_scale = 1.0f;
+	float characters_time_s = 0.0f;
+	auto const place_characters = [&characters, &characters_nb, &character_clip, &character_scale](){
+		characters.instances.clear();
+		characters.instances_model_to_world.clear();
+		characters.instances_normal_model_to_world.clear();
+		if (characters.meshes.empty())
+			return;
+
+		// All palettes have to fit in a single texture buffer.
+		auto const max_characters_nb = static_cast<int>(std::min<std::size_t>(bonobo::skinning::getMaxInstancesNb(characters.palette_buffer, characters.rig.skeleton.joint_names.size()),
+		                                                                       std::numeric_limits<int>::max()));
+		if (characters_nb > max_characters_nb) {
+			LogWarning("Only %d characters fit in the joint palette buffer, instead of the %d requested.", max_characters_nb, characters_nb);
+			characters_nb = max_characters_nb;
 		}
-		if (opacity_texture != geometry.bindings.end())
-		{
-			data.opacity_texture_id = opacity_texture->second;
+
+		// Spread the characters on a grid in the middle of the atrium,
+		// and desynchronise their animations.
+		for (int i = 0; i < characters_nb; ++i) {
+			auto const position = glm::vec3((static_cast<float>(i % 8) - 3.5f) * 0.75f, 0.0f, (static_cast<float>(i / 8) - 1.0f) * 1.0f) * constant::scale_lengths;
+			characters.instances.push_back(bonobo::skinning::createInstance(characters.rig, static_cast<std::size_t>(character_clip), 0.37f * static_cast<float>(i)));
+			characters.instances_model_to_world.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(character_scale)));
+			characters.instances_normal_model_to_world.push_back(glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / character_scale)));
 		}
-		sponza_geometry_texture_data.emplace_back(std::move(data));
-	}
+	};
+	// Draw all instances of all character meshes, with the palettes
+	// already bound; |bind_material| is called once per mesh.
+	auto const draw_characters = [&characters](GLint vertex_model_to_world_location,
+	                                           GLint normal_model_to_world_location,
+	                                           GLint palette_offset_location,
+	                                           auto const& bind_material){
+		auto const joints_nb = characters.rig.skeleton.joint_names.size();
+		for (std::size_t m = 0; m < characters.meshes.size(); ++m) {
+			auto const& mesh = characters.meshes[m];
+			bind_material(characters.meshes_material_index[m]);
+			glBindVertexArray(mesh.vao);
+			for (std::size_t c = 0; c < characters.instances.size(); ++c) {
+				auto const& vertex_model_to_world = characters.instances_model_to_world[c];
+				glUniformMatrix4fv(vertex_model_to_world_location, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
+				if (normal_model_to_world_location != -1)
+					glUniformMatrix4fv(normal_model_to_world_location, 1, GL_FALSE, glm::value_ptr(characters.instances_normal_model_to_world[c]));
+				glUniform1i(palette_offset_location, static_cast<GLint>(c * joints_nb));
+				glDrawElements(mesh.drawing_mode, mesh.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
+			}
+		}
+		glBindVertexArray(0u);
+	};
 
 	auto const cone_geometry = loadCone();
 	Node cone;
@@ -281,6 +376,26 @@ edan35::Assignment2::run()
 	FillShadowmapShaderLocations fill_shadowmap_shader_locations;
 	fillShadowmapShaderLocations(fill_shadowmap_shader, fill_shadowmap_shader_locations);
 
+	GLuint fill_gbuffer_skinned_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Fill G-Buffer (skinned)",
+	                                         { { ShaderType::vertex, "EDAN35/fill_gbuffer_skinned.vert" },
+	                                           { ShaderType::fragment, "EDAN35/fill_gbuffer.frag" } },
+	                                         fill_gbuffer_skinned_shader);
+	if (fill_gbuffer_skinned_shader == 0u)
+		LogError("Failed to load skinned G-buffer filling shader: skinned characters will not be rendered.");
+	GBufferShaderLocations fill_gbuffer_skinned_shader_locations;
+	fillGBufferShaderLocations(fill_gbuffer_skinned_shader, fill_gbuffer_skinned_shader_locations);
+
+	GLuint fill_shadowmap_skinned_shader = 0u;
+	program_manager.CreateAndRegisterProgram("Fill shadow map (skinned)",
+	                                         { { ShaderType::vertex, "EDAN35/fill_shadowmap_skinned.vert" },
+	                                           { ShaderType::fragment, "EDAN35/fill_shadowmap.frag" } },
+	                                         fill_shadowmap_skinned_shader);
+	if (fill_shadowmap_skinned_shader == 0u)
+		LogError("Failed to load skinned shadowmap filling shader: skinned characters will not cast shadows.");
+	FillShadowmapShaderLocations fill_shadowmap_skinned_shader_locations;
+	fillShadowmapShaderLocations(fill_shadowmap_skinned_shader, fill_shadowmap_skinned_shader_locations);
+
 	GLuint accumulate_lights_shader = 0u;
 	program_manager.CreateAndRegisterProgram("Accumulate light",
 	                                         { { ShaderType::vertex, "EDAN35/accumulate_lights.vert" },
@@ -318,7 +433,24 @@ edan35::Assignment2::run()
 	ViewProjTransforms camera_view_proj_transforms;
 	std::array<ViewProjTransforms, constant::lights_nb> light_view_proj_transforms;
 
-	const GLuint debug_texture_id = bonobo::getDebugTextureID();
+	// The texture arrays of the scene use the units following the joint
+	// palettes, and always sample through mipmaps.
+	auto constexpr texture_arrays_first_unit = 3u;
+	std::array<GLint, bonobo::texture_arrays::max_arrays_nb> texture_arrays_units;
+	std::iota(texture_arrays_units.begin(), texture_arrays_units.end(), static_cast<GLint>(texture_arrays_first_unit));
+	auto const bind_texture_arrays = [&samplers, texture_arrays_first_unit](bonobo::texture_arrays::texture_array_set const& set){
+		for (GLuint i = 0u; i < bonobo::texture_arrays::max_arrays_nb; ++i)
+			glBindSampler(texture_arrays_first_unit + i, samplers[toU(Sampler::Mipmaps)]);
+		bonobo::texture_arrays::bindTextureArrays(set, texture_arrays_first_unit);
+	};
+	auto const unbind_texture_arrays = [texture_arrays_first_unit](){
+		for (GLuint i = 0u; i < bonobo::texture_arrays::max_arrays_nb; ++i) {
+			glActiveTexture(GL_TEXTURE0 + texture_arrays_first_unit + i);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0u);
+			glBindSampler(texture_arrays_first_unit + i, 0u);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	};
 
 	auto const bind_texture_with_sampler = [](GLenum target, unsigned int slot, GLuint program, std::string const& name, GLuint texture, GLuint sampler){
 		glActiveTexture(GL_TEXTURE0 + slot);
@@ -343,6 +475,20 @@ edan35::Assignment2::run()
 		                           0.5f + 0.5f * (static_cast<float>(rand()) / static_cast<float>(RAND_MAX)));
 	}
 
+	// Each light turns around the Y axis at 0.1 rad/s, starting from its own
+	// angle; a key every quarter turn is enough for slerp to reproduce a
+	// constant angular velocity.
+	std::array<bonobo::animation::TransformTrack, constant::lights_nb> lightTracks;
+	auto const light_angular_speed = 0.1f;
+	auto const light_quarter_turn_duration = glm::half_pi<float>() / light_angular_speed;
+	for (size_t i = 0; i < constant::lights_nb; ++i) {
+		auto const start_angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(constant::lights_nb);
+		for (int quarter = 0; quarter <= 4; ++quarter)
+			lightTracks[i].add_rotation_key(static_cast<float>(quarter) * light_quarter_turn_duration,
+			                                glm::angleAxis(start_angle + static_cast<float>(quarter) * glm::half_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f)));
+		lightTracks[i].set_looping(true);
+	}
+
 	float const lightProjectionNearPlane = 0.01f * constant::scale_lengths;
 	float const lightProjectionFarPlane = 20.0f * constant::scale_lengths;
 	auto lightProjection = glm::perspective(0.5f * glm::pi<float>(),
@@ -412,6 +558,8 @@ edan35::Assignment2::run()
 			{
 				fillGBufferShaderLocations(fill_gbuffer_shader, fill_gbuffer_shader_locations);
 				fillShadowmapShaderLocations(fill_shadowmap_shader, fill_shadowmap_shader_locations);
+				fillGBufferShaderLocations(fill_gbuffer_skinned_shader, fill_gbuffer_skinned_shader_locations);
+				fillShadowmapShaderLocations(fill_shadowmap_skinned_shader, fill_shadowmap_skinned_shader_locations);
 				fillAccumulateLightsShaderLocations(accumulate_lights_shader, accumulate_light_shader_locations);
 			}
 		}
@@ -430,9 +578,9 @@ edan35::Assignment2::run()
 		}
 
 
+		bonobo::animation::applyAll(lightTracks.data(), lightTransforms.data(), static_cast<size_t>(lights_nb), seconds_nb);
 		for (size_t i = 0; i < static_cast<size_t>(lights_nb); ++i) {
 			auto& lightTransform = lightTransforms[i];
-			lightTransform.SetRotate(glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(constant::lights_nb) + 0.1f * seconds_nb, glm::vec3(0.0f, 1.0f, 0.0f));
 
 			auto const light_view_matrix = lightOffsetTransform.GetMatrixInverse() * lightTransform.GetMatrixInverse();
 			auto const light_world_matrix = glm::inverse(light_view_matrix) * coneScaleTransform.GetMatrix();
@@ -443,6 +591,13 @@ edan35::Assignment2::run()
 		}
 
 
+		characters_time_s += std::chrono::duration<float>(deltaTimeUs).count();
+		if (!characters.instances.empty()) {
+			bonobo::skinning::evaluatePoses(characters.rig.skeleton, characters.instances, characters_time_s, characters.palettes);
+			bonobo::skinning::updatePaletteBuffer(characters.palette_buffer, characters.palettes);
+		}
+
+
 		//
 		// Update per-frame changing UBOs.
 		//
@@ -466,56 +621,63 @@ edan35::Assignment2::run()
 			// XXX: Is any other clearing needed?
 
 			glUseProgram(fill_gbuffer_shader);
-			glUniform1i(fill_gbuffer_shader_locations.diffuse_texture, 0);
-			glUniform1i(fill_gbuffer_shader_locations.specular_texture, 1);
-			glUniform1i(fill_gbuffer_shader_locations.normals_texture, 2);
-			glUniform1i(fill_gbuffer_shader_locations.opacity_texture, 3);
-			for (std::size_t i = 0; i < sponza_geometry.size(); ++i)
+			glUniform1iv(fill_gbuffer_shader_locations.texture_arrays, static_cast<GLsizei>(texture_arrays_units.size()), texture_arrays_units.data());
+			bind_texture_arrays(sponza_texture_arrays);
 			{
-				auto const& geometry = sponza_geometry[i];
-				auto const& texture_data = sponza_geometry_texture_data[i];
-
-				utils::opengl::debug::beginDebugGroup(geometry.name);
-
 				auto const vertex_model_to_world = glm::mat4(1.0f);
 				auto const normal_model_to_world = glm::mat4(1.0f);
 
 				glUniformMatrix4fv(fill_gbuffer_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
 				glUniformMatrix4fv(fill_gbuffer_shader_locations.normal_model_to_world, 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
+			}
+			select_sponza_records(mCamera.GetWorldToClipMatrix());
+			sponza_gbuffer_records_nb = sponza_visible_records.size();
+			auto previous_gbuffer_material_id = std::numeric_limits<std::uint32_t>::max();
+			for (auto const i : sponza_visible_records)
+			{
+				auto const& record = sponza_draw_list.records[i];
 
-				auto const default_sampler = samplers[toU(Sampler::Nearest)];
-				auto const mipmap_sampler = samplers[toU(Sampler::Mipmaps)];
+				utils::opengl::debug::beginDebugGroup(sponza_draw_list.names[i]);
 
-				glUniform1i(fill_gbuffer_shader_locations.has_diffuse_texture, texture_data.diffuse_texture_id != 0u ? 1 : 0);
-				glBindSampler(0u, texture_data.diffuse_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, texture_data.diffuse_texture_id != 0u ? texture_data.diffuse_texture_id : debug_texture_id);
+				if (record.material_id != previous_gbuffer_material_id) {
+					previous_gbuffer_material_id = record.material_id;
+					glUniform1i(fill_gbuffer_shader_locations.material_index, static_cast<GLint>(record.material_id));
+				}
 
-				glUniform1i(fill_gbuffer_shader_locations.has_specular_texture, texture_data.specular_texture_id != 0u ? 1 : 0);
-				glBindSampler(1u, texture_data.specular_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, texture_data.specular_texture_id != 0u ? texture_data.specular_texture_id : debug_texture_id);
+				glBindVertexArray(record.vao);
+				if (record.has_indices)
+					glDrawElements(record.drawing_mode, record.count, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(record.first_index * sizeof(GLuint)));
+				else
+					glDrawArrays(record.drawing_mode, static_cast<GLint>(record.first_index), record.count);
 
-				glUniform1i(fill_gbuffer_shader_locations.has_normals_texture, texture_data.normals_texture_id != 0u ? 1 : 0);
-				glBindSampler(2u, texture_data.normals_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, texture_data.normals_texture_id != 0u ? texture_data.normals_texture_id : debug_texture_id);
 
-				glUniform1i(fill_gbuffer_shader_locations.has_opacity_texture, texture_data.opacity_texture_id != 0u ? 1 : 0);
-				glBindSampler(3u, texture_data.opacity_texture_id != 0u ? mipmap_sampler : default_sampler);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id);
+				utils::opengl::debug::endDebugGroup();
+			}
+
+			if (!characters.instances.empty() && fill_gbuffer_skinned_shader != 0u) {
+				utils::opengl::debug::beginDebugGroup("Skinned characters");
 
-				glBindVertexArray(geometry.vao);
-				if (geometry.ibo != 0u)
-					glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
-				else
-					glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+				glUseProgram(fill_gbuffer_skinned_shader);
+				glUniform1iv(fill_gbuffer_skinned_shader_locations.texture_arrays, static_cast<GLsizei>(texture_arrays_units.size()), texture_arrays_units.data());
+				glUniform1i(fill_gbuffer_skinned_shader_locations.joint_palettes, 2);
+				glActiveTexture(GL_TEXTURE2);
+				glBindTexture(GL_TEXTURE_BUFFER, characters.palette_buffer.texture);
+				bind_texture_arrays(characters.texture_arrays);
+
+				draw_characters(fill_gbuffer_skinned_shader_locations.vertex_model_to_world,
+				                fill_gbuffer_skinned_shader_locations.normal_model_to_world,
+				                fill_gbuffer_skinned_shader_locations.palette_offset,
+				                [&](GLint material_index){
+					glUniform1i(fill_gbuffer_skinned_shader_locations.material_index, material_index);
+				});
 
+				glActiveTexture(GL_TEXTURE2);
+				glBindTexture(GL_TEXTURE_BUFFER, 0u);
+				glActiveTexture(GL_TEXTURE0);
 
 				utils::opengl::debug::endDebugGroup();
 			}
-			glBindTexture(GL_TEXTURE_2D, 0);
+			unbind_texture_arrays();
 			glBindVertexArray(0u);
 			glUseProgram(0u);
 
@@ -548,32 +710,59 @@ edan35::Assignment2::run()
 
 				glUseProgram(fill_shadowmap_shader);
 				glUniform1i(fill_shadowmap_shader_locations.light_index, static_cast<int>(i));
-				glUniform1i(fill_shadowmap_shader_locations.opacity_texture, 0);
-				for (std::size_t i = 0; i < sponza_geometry.size(); ++i)
+				glUniform1iv(fill_shadowmap_shader_locations.texture_arrays, static_cast<GLsizei>(texture_arrays_units.size()), texture_arrays_units.data());
+				bind_texture_arrays(sponza_texture_arrays);
 				{
-					auto const& geometry = sponza_geometry[i];
-					auto const& texture_data = sponza_geometry_texture_data[i];
-
-					utils::opengl::debug::beginDebugGroup(geometry.name);
-
 					auto const vertex_model_to_world = glm::mat4(1.0f);
 					glUniformMatrix4fv(fill_shadowmap_shader_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(vertex_model_to_world));
+				}
+				select_sponza_records(light_world_to_clip_matrix);
+				auto previous_shadowmap_material_id = std::numeric_limits<std::uint32_t>::max();
+				for (auto const i : sponza_visible_records)
+				{
+					auto const& record = sponza_draw_list.records[i];
 
-					glUniform1i(fill_shadowmap_shader_locations.has_opacity_texture, texture_data.opacity_texture_id != 0u ? 1 : 0);
-					glBindSampler(0u, texture_data.opacity_texture_id != 0u ? samplers[toU(Sampler::Mipmaps)] : samplers[toU(Sampler::Nearest)]);
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, texture_data.opacity_texture_id != 0u ? texture_data.opacity_texture_id : debug_texture_id);
+					utils::opengl::debug::beginDebugGroup(sponza_draw_list.names[i]);
+
+					if (record.material_id != previous_shadowmap_material_id) {
+						previous_shadowmap_material_id = record.material_id;
+						glUniform1i(fill_shadowmap_shader_locations.material_index, static_cast<GLint>(record.material_id));
+					}
 
-					glBindVertexArray(geometry.vao);
-					if (geometry.ibo != 0u)
-						glDrawElements(geometry.drawing_mode, geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
+					glBindVertexArray(record.vao);
+					if (record.has_indices)
+						glDrawElements(record.drawing_mode, record.count, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(record.first_index * sizeof(GLuint)));
 					else
-						glDrawArrays(geometry.drawing_mode, 0, geometry.vertices_nb);
+						glDrawArrays(record.drawing_mode, static_cast<GLint>(record.first_index), record.count);
 
 
 					utils::opengl::debug::endDebugGroup();
 				}
-				glBindTexture(GL_TEXTURE_2D, 0);
+
+				if (!characters.instances.empty() && fill_shadowmap_skinned_shader != 0u) {
+					utils::opengl::debug::beginDebugGroup("Skinned characters");
+
+					glUseProgram(fill_shadowmap_skinned_shader);
+					glUniform1i(fill_shadowmap_skinned_shader_locations.light_index, static_cast<int>(i));
+					glUniform1iv(fill_shadowmap_skinned_shader_locations.texture_arrays, static_cast<GLsizei>(texture_arrays_units.size()), texture_arrays_units.data());
+					glUniform1i(fill_shadowmap_skinned_shader_locations.joint_palettes, 2);
+					glActiveTexture(GL_TEXTURE2);
+					glBindTexture(GL_TEXTURE_BUFFER, characters.palette_buffer.texture);
+					bind_texture_arrays(characters.texture_arrays);
+
+					draw_characters(fill_shadowmap_skinned_shader_locations.vertex_model_to_world, -1,
+					                fill_shadowmap_skinned_shader_locations.palette_offset,
+					                [&](GLint material_index){
+						glUniform1i(fill_shadowmap_skinned_shader_locations.material_index, material_index);
+					});
+
+					glActiveTexture(GL_TEXTURE2);
+					glBindTexture(GL_TEXTURE_BUFFER, 0u);
+					glActiveTexture(GL_TEXTURE0);
+
+					utils::opengl::debug::endDebugGroup();
+				}
+				unbind_texture_arrays();
 				glBindVertexArray(0u);
 				glUseProgram(0u);
 
@@ -625,7 +814,7 @@ edan35::Assignment2::run()
 				glBindSampler(2, samplers[toU(Sampler::Linear)]);
 
 				glBindVertexArray(cone_geometry.vao);
-				glDrawArrays(cone_geometry.drawing_mode, 0, cone_geometry.vertices_nb);
+				glDrawElements(cone_geometry.drawing_mode, cone_geometry.indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
 
 				glBindVertexArray(0u);
 				glUseProgram(0u);
@@ -798,6 +987,50 @@ edan35::Assignment2::run()
 			ImGui::SliderInt("Number of lights", &lights_nb, 1, static_cast<int>(constant::lights_nb));
 			ImGui::Checkbox("Show textures", &show_textures);
 			ImGui::Checkbox("Show light cones wireframe", &show_cone_wireframe);
+			ImGui::Checkbox("Use frustum culling", &use_frustum_culling);
+			ImGui::Text("Sponza batches in G-buffer: %zu / %zu", sponza_gbuffer_records_nb, sponza_draw_list.records.size());
+			ImGui::Separator();
+			if (characters.meshes.empty()) {
+				if (ImGui::Button("Load skinned character…")) {
+					char const* const filter_patterns[] = { "*.fbx", "*.dae", "*.gltf", "*.glb" };
+					auto const path = tinyfd_openFileDialog("Load skinned character", "", 4, filter_patterns, "Skinned characters", 0);
+					if (path != nullptr) {
+						bonobo::load_options character_options;
+						character_options.pack_textures = true;
+						character_options.rig = &characters.rig;
+						character_options.arrays = &characters.texture_arrays;
+						auto meshes = bonobo::loadObjects(path, character_options);
+						for (auto& mesh : meshes) {
+							if (!mesh.is_skinned) {
+								LogWarning("Skipping mesh \"%s\", which is not attached to any joint.", mesh.name.c_str());
+								continue;
+							}
+							if (scene_materials.size() >= bonobo::materials::max_materials_nb) {
+								LogWarning("The material buffer is full, so mesh \"%s\" will use the first material instead of its own.", mesh.name.c_str());
+								characters.meshes_material_index.push_back(0);
+							} else {
+								characters.meshes_material_index.push_back(static_cast<GLint>(scene_materials.size()));
+								scene_materials.push_back(bonobo::materials::makeMaterial(mesh.material, mesh.bindings, mesh.layer_bindings));
+							}
+							characters.meshes.push_back(std::move(mesh));
+						}
+						bonobo::materials::updateMaterialBuffer(scene_material_buffer, scene_materials);
+						if (characters.meshes.empty())
+							LogError("No skinned mesh found in \"%s\".", path);
+						character_clip = 0;
+						place_characters();
+					}
+				}
+			} else {
+				auto const clips_nb = static_cast<int>(characters.rig.clips.size());
+				auto characters_changed = ImGui::SliderInt("Number of characters", &characters_nb, 1, 256);
+				characters_changed |= ImGui::SliderInt("Character animation", &character_clip, 0, std::max(clips_nb - 1, 0));
+				characters_changed |= ImGui::SliderFloat("Character scale", &character_scale, 0.01f, 100.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+				if (characters_changed)
+					place_characters();
+				if (character_clip < clips_nb)
+					ImGui::Text("Playing \"%s\" (%.2f s)", characters.rig.clips[character_clip].name.c_str(), characters.rig.clips[character_clip].duration_s);
+			}
 			ImGui::Separator();
 			ImGui::Checkbox("Show basis", &show_basis);
 			ImGui::SliderFloat("Basis thickness scale", &basis_thickness_scale, 0.0f, 100.0f);
@@ -841,6 +1074,15 @@ edan35::Assignment2::run()
 	resolve_deferred_shader = 0u;
 	glDeleteProgram(accumulate_lights_shader);
 	accumulate_lights_shader = 0u;
+	bonobo::skinning::destroyPaletteBuffer(characters.palette_buffer);
+	bonobo::materials::destroyMaterialBuffer(scene_material_buffer);
+	bonobo::texture_arrays::destroyTextureArraySet(characters.texture_arrays);
+	bonobo::texture_arrays::destroyTextureArraySet(sponza_texture_arrays);
+
+	glDeleteProgram(fill_shadowmap_skinned_shader);
+	fill_shadowmap_skinned_shader = 0u;
+	glDeleteProgram(fill_gbuffer_skinned_shader);
+	fill_gbuffer_skinned_shader = 0u;
 	glDeleteProgram(fill_shadowmap_shader);
 	fill_shadowmap_shader = 0u;
 	glDeleteProgram(fill_gbuffer_shader);
@@ -1060,16 +1302,13 @@ void fillGBufferShaderLocations(GLuint gbuffer_shader, GBufferShaderLocations& l
 	locations.ubo_CameraViewProjTransforms = glGetUniformBlockIndex(gbuffer_shader, "CameraViewProjTransforms");
 	locations.vertex_model_to_world = glGetUniformLocation(gbuffer_shader, "vertex_model_to_world");
 	locations.normal_model_to_world = glGetUniformLocation(gbuffer_shader, "normal_model_to_world");
-	locations.diffuse_texture = glGetUniformLocation(gbuffer_shader, "diffuse_texture");
-	locations.specular_texture = glGetUniformLocation(gbuffer_shader, "specular_texture");
-	locations.normals_texture = glGetUniformLocation(gbuffer_shader, "normals_texture");
-	locations.opacity_texture = glGetUniformLocation(gbuffer_shader, "opacity_texture");
-	locations.has_diffuse_texture = glGetUniformLocation(gbuffer_shader, "has_diffuse_texture");
-	locations.has_specular_texture = glGetUniformLocation(gbuffer_shader, "has_specular_texture");
-	locations.has_normals_texture = glGetUniformLocation(gbuffer_shader, "has_normals_texture");
-	locations.has_opacity_texture = glGetUniformLocation(gbuffer_shader, "has_opacity_texture");
+	locations.texture_arrays = glGetUniformLocation(gbuffer_shader, "texture_arrays");
+	locations.material_index = glGetUniformLocation(gbuffer_shader, "material_index");
+	locations.joint_palettes = glGetUniformLocation(gbuffer_shader, "joint_palettes");
+	locations.palette_offset = glGetUniformLocation(gbuffer_shader, "palette_offset");
 
 	glUniformBlockBinding(gbuffer_shader, locations.ubo_CameraViewProjTransforms, toU(UBO::CameraViewProjTransforms));
+	bonobo::materials::bindUniformBlock(gbuffer_shader);
 
 }
 
@@ -1078,10 +1317,13 @@ void fillShadowmapShaderLocations(GLuint shadowmap_shader, FillShadowmapShaderLo
 	locations.ubo_LightViewProjTransforms = glGetUniformBlockIndex(shadowmap_shader, "LightViewProjTransforms");
 	locations.light_index = glGetUniformLocation(shadowmap_shader, "light_index");
 	locations.vertex_model_to_world = glGetUniformLocation(shadowmap_shader, "vertex_model_to_world");
-	locations.opacity_texture = glGetUniformLocation(shadowmap_shader, "opacity_texture");
-	locations.has_opacity_texture = glGetUniformLocation(shadowmap_shader, "has_opacity_texture");
+	locations.texture_arrays = glGetUniformLocation(shadowmap_shader, "texture_arrays");
+	locations.material_index = glGetUniformLocation(shadowmap_shader, "material_index");
+	locations.joint_palettes = glGetUniformLocation(shadowmap_shader, "joint_palettes");
+	locations.palette_offset = glGetUniformLocation(shadowmap_shader, "palette_offset");
 
 	glUniformBlockBinding(shadowmap_shader, locations.ubo_LightViewProjTransforms, toU(UBO::LightViewProjTransforms));
+	bonobo::materials::bindUniformBlock(shadowmap_shader);
 }
 
 void fillAccumulateLightsShaderLocations(GLuint accumulate_lights_shader, AccumulateLightsShaderLocations& locations)
@@ -1110,96 +1352,9 @@ void fillAccumulateLightsShaderLocations(GLuint accumulate_lights_shader, Accumu
 bonobo::mesh_data
 loadCone()
 {
-	bonobo::mesh_data cone;
-	cone.vertices_nb = 65;
-	cone.drawing_mode = GL_TRIANGLE_STRIP;
-	float vertexArrayData[65 * 3] = {
-		0.f, 1.f, -1.f,
-		0.f, 0.f, 0.f,
-		0.38268f, 0.92388f, -1.f,
-		0.f, 0.f, 0.f,
-		0.70711f, 0.70711f, -1.f,
-		0.f, 0.f, 0.f,
-		0.92388f, 0.38268f, -1.f,
-		0.f, 0.f, 0.f,
-		1.f, 0.f, -1.f,
-		0.f, 0.f, 0.f,
-		0.92388f, -0.38268f, -1.f,
-		0.f, 0.f, 0.f,
-		0.70711f, -0.70711f, -1.f,
-		0.f, 0.f, 0.f,
-		0.38268f, -0.92388f, -1.f,
-		0.f, 0.f, 0.f,
-		0.f, -1.f, -1.f,
-		0.f, 0.f, 0.f,
-		-0.38268f, -0.92388f, -1.f,
-		0.f, 0.f, 0.f,
-		-0.70711f, -0.70711f, -1.f,
-		0.f, 0.f, 0.f,
-		-0.92388f, -0.38268f, -1.f,
-		0.f, 0.f, 0.f,
-		-1.f, 0.f, -1.f,
-		0.f, 0.f, 0.f,
-		-0.92388f, 0.38268f, -1.f,
-		0.f, 0.f, 0.f,
-		-0.70711f, 0.70711f, -1.f,
-		0.f, 0.f, 0.f,
-		-0.38268f, 0.92388f, -1.f,
-		0.f, 1.f, -1.f,
-		0.f, 1.f, -1.f,
-		0.38268f, 0.92388f, -1.f,
-		0.f, 1.f, -1.f,
-		0.70711f, 0.70711f, -1.f,
-		0.f, 0.f, -1.f,
-		0.92388f, 0.38268f, -1.f,
-		0.f, 0.f, -1.f,
-		1.f, 0.f, -1.f,
-		0.f, 0.f, -1.f,
-		0.92388f, -0.38268f, -1.f,
-		0.f, 0.f, -1.f,
-		0.70711f, -0.70711f, -1.f,
-		0.f, 0.f, -1.f,
-		0.38268f, -0.92388f, -1.f,
-		0.f, 0.f, -1.f,
-		0.f, -1.f, -1.f,
-		0.f, 0.f, -1.f,
-		-0.38268f, -0.92388f, -1.f,
-		0.f, 0.f, -1.f,
-		-0.70711f, -0.70711f, -1.f,
-		0.f, 0.f, -1.f,
-		-0.92388f, -0.38268f, -1.f,
-		0.f, 0.f, -1.f,
-		-1.f, 0.f, -1.f,
-		0.f, 0.f, -1.f,
-		-0.92388f, 0.38268f, -1.f,
-		0.f, 0.f, -1.f,
-		-0.70711f, 0.70711f, -1.f,
-		0.f, 0.f, -1.f,
-		-0.38268f, 0.92388f, -1.f,
-		0.f, 0.f, -1.f,
-		0.f, 1.f, -1.f,
-		0.f, 0.f, -1.f
-	};
-
-	glGenVertexArrays(1, &cone.vao);
-	assert(cone.vao != 0u);
-	glBindVertexArray(cone.vao);
-	{
-		utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, cone.vao, "Cone VAO");
-
-		glGenBuffers(1, &cone.bo);
-		assert(cone.bo != 0u);
-		glBindBuffer(GL_ARRAY_BUFFER, cone.bo);
-		glBufferData(GL_ARRAY_BUFFER, cone.vertices_nb * 3 * sizeof(float), vertexArrayData, GL_STATIC_DRAW);
-		utils::opengl::debug::nameObject(GL_BUFFER, cone.bo, "Cone VBO");
-
-		glVertexAttribPointer(static_cast<int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-		glEnableVertexAttribArray(static_cast<int>(bonobo::shader_bindings::vertices));
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
-	}
-	glBindVertexArray(0u);
-
-	return cone;
+	// 16 segments are enough for the light volume to cover the light's
+	// cone, and keep the rasterisation cost of each light low.
+	static constexpr auto cone = bonobo::static_meshes::make_cone<16>();
+	return bonobo::static_meshes::upload(cone, "Cone");
 }
 } // namespace
@@ -4,6 +4,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/io.hpp>
 
+#include <cstdint>
 #include <iostream>
 
 /**
@@ -75,6 +76,8 @@ public:
 	void SetRotateX(T angle);
 	void SetRotateY(T angle);
 	void SetRotateZ(T angle);
+	// Use |rotation| as is; it should be orthonormal
+	void SetRotate(glm::tmat3x3<T, P> const& rotation);
 
 
 	void LookTowards(glm::tvec3<T, P> front_vec, glm::tvec3<T, P> up_vec);
@@ -89,6 +92,12 @@ public:
 
 	glm::tmat4x4<T, P> GetMatrix() const;
 	glm::tmat4x4<T, P> GetMatrixInverse() const;
+	// Inverse transpose of the upper 3x3 part of GetMatrix(), to transform
+	// normals; computed from R and S rather than with a general inverse.
+	glm::tmat3x3<T, P> GetNormalMatrix() const;
+	// Incremented on every change, to let users cache what they derive
+	// from this transform.
+	std::uint32_t GetRevision() const;
 
 	glm::tmat3x3<T, P> GetRotation() const;
 	glm::tvec3<T, P> GetTranslation() const;
@@ -112,10 +121,21 @@ public:
 	glm::tvec3<T, P> GetBack() const;
 
 protected:
+	// Invalidate the cached matrices; has to be called whenever mR, mT or
+	// mS change.
+	void MarkDirty();
+
 	glm::tmat3x3<T, P>	mR;
 	glm::tvec3<T, P>	mT;
 	glm::tvec3<T, P>	mS;
 
+	// GetMatrix() and GetMatrixInverse() are only recomputed after changes.
+	mutable glm::tmat4x4<T, P>	mMatrix;
+	mutable glm::tmat4x4<T, P>	mMatrixInverse;
+	mutable bool	mIsMatrixDirty;
+	mutable bool	mIsMatrixInverseDirty;
+	std::uint32_t	mRevision;
+
 public:
 	friend std::ostream &operator<<(std::ostream &os, TRSTransform<T, P> &v)
 	{
@@ -129,6 +149,7 @@ public:
 		is >> v.mT;
 		is >> v.mR;
 		is >> v.mS;
+		v.MarkDirty();
 		return is;
 	}
 };
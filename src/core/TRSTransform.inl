@@ -6,7 +6,8 @@
 /*----------------------------------------------------------------------------*/
 
 template<typename T, glm::precision P>
-TRSTransform<T, P>::TRSTransform()
+TRSTransform<T, P>::TRSTransform() : mMatrix(T(1)), mMatrixInverse(T(1)),
+	mIsMatrixDirty(true), mIsMatrixInverseDirty(true), mRevision(0u)
 {
 	ResetTransform();
 }
@@ -26,6 +27,17 @@ void TRSTransform<T, P>::ResetTransform()
 	mT = glm::tvec3<T, P>(static_cast<T>(0));
 	mS = glm::tvec3<T, P>(static_cast<T>(1));
 	mR = glm::tmat3x3<T, P>(static_cast<T>(1));
+	MarkDirty();
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<typename T, glm::precision P>
+void TRSTransform<T, P>::MarkDirty()
+{
+	mIsMatrixDirty = true;
+	mIsMatrixInverseDirty = true;
+	++mRevision;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -34,6 +46,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::Translate(glm::tvec3<T, P> v)
 {
 	mT += v;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -42,6 +55,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::Scale(glm::tvec3<T, P> v)
 {
 	mS *= v;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -50,6 +64,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::Scale(T uniform)
 {
 	mS *= uniform;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -58,6 +73,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::Rotate(T angle, glm::tvec3<T, P> v)
 {
 	mR = glm::tmat3x3<T, P>(glm::rotate(glm::tmat4x4<T, P>(mR), angle, v));
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -71,6 +87,7 @@ void TRSTransform<T, P>::RotateX(T angle)
 		mR[0][0], C * mR[0][1] - mR[0][2] * S, C * mR[0][2] + mR[0][1] * S,
 		mR[1][0], C * mR[1][1] - mR[1][2] * S, C * mR[1][2] + mR[1][1] * S,
 		mR[2][0], C * mR[2][1] - mR[2][2] * S, C * mR[2][2] + mR[2][1] * S);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -84,6 +101,7 @@ void TRSTransform<T, P>::RotateY(T angle)
 		C * mR[0][0] + mR[0][2] * S, mR[0][1], C * mR[0][2] - mR[0][0] * S,
 		C * mR[1][0] + mR[1][2] * S, mR[1][1], C * mR[1][2] - mR[1][0] * S,
 		C * mR[2][0] + mR[2][2] * S, mR[2][1], C * mR[2][2] - mR[2][0] * S);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -97,6 +115,7 @@ void TRSTransform<T, P>::RotateZ(T angle)
 		C * mR[0][0] - mR[0][1] * S, C * mR[0][1] + mR[0][0] * S, mR[0][2],
 		C * mR[1][0] - mR[1][1] * S, C * mR[1][1] + mR[1][0] * S, mR[1][2],
 		C * mR[2][0] - mR[2][1] * S, C * mR[2][1] + mR[2][0] * S, mR[2][2]);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -105,6 +124,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::PreRotate(T angle, glm::tvec3<T, P> v)
 {
 	mR = glm::tmat3x3<T, P>::RotationMatrix(angle, v) * mR;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -118,6 +138,7 @@ void TRSTransform<T, P>::PreRotateX(T angle)
 		mR[0][0], mR[0][1], mR[0][2],
 		C * mR[1][0] + mR[2][0] * S, C * mR[1][1] + mR[2][1] * S, C * mR[1][2] + mR[2][2] * S,
 		C * mR[2][0] - mR[1][0] * S, C * mR[2][1] - mR[1][1] * S, C * mR[2][2] - mR[1][2] * S);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -131,6 +152,7 @@ void TRSTransform<T, P>::PreRotateY(T angle)
 		C * mR[0][0] - mR[2][0] * S, C * mR[0][1] - mR[2][1] * S, C * mR[0][2] - mR[2][2] * S,
 		mR[1][0], mR[1][1], mR[1][2],
 		C * mR[2][0] + mR[0][0] * S, C * mR[2][1] + mR[0][1] * S, C * mR[2][2] + mR[0][2] * S);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -144,6 +166,7 @@ void TRSTransform<T, P>::PreRotateZ(T angle)
 		C * mR[0][0] + mR[1][0] * S, C * mR[0][1] + mR[1][1] * S, C * mR[0][2] + mR[1][2] * S,
 		C * mR[1][0] - mR[0][0] * S, C * mR[1][1] - mR[0][1] * S, C * mR[1][2] - mR[0][2] * S,
 		mR[2][0], mR[2][1], mR[2][2]);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -152,6 +175,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetTranslate(glm::tvec3<T, P> v)
 {
 	mT = v;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -160,6 +184,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetScale(glm::tvec3<T, P> v)
 {
 	mS = v;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -168,6 +193,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetScale(T uniform)
 {
 	mS = glm::tvec3<T, P>(uniform);
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -176,6 +202,16 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetRotate(T angle, glm::tvec3<T, P> v)
 {
 	mR = glm::tmat3x3<T, P>(glm::rotate(glm::tmat4x4<T, P>(T(1)), angle, v));
+	MarkDirty();
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<typename T, glm::precision P>
+void TRSTransform<T, P>::SetRotate(glm::tmat3x3<T, P> const& rotation)
+{
+	mR = rotation;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -184,6 +220,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetRotateX(T angle)
 {
 	mR = glm::tmat3x3<T, P>(glm::rotate(glm::tmat4x4<T, P>(T(1)), angle, glm::tvec3<T, P>(1, 0, 0)));
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -192,6 +229,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetRotateY(T angle)
 {
 	mR = glm::tmat3x3<T, P>(glm::rotate(glm::tmat4x4<T, P>(T(1)), angle, glm::tvec3<T, P>(0, 1, 0)));
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -200,6 +238,7 @@ template<typename T, glm::precision P>
 void TRSTransform<T, P>::SetRotateZ(T angle)
 {
 	mR = glm::tmat3x3<T, P>(glm::rotate(glm::tmat4x4<T, P>(T(1)), angle, glm::tvec3<T, P>(0, 0, 1)));
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -224,6 +263,7 @@ void TRSTransform<T, P>::LookTowards(glm::tvec3<T, P> front_vec, glm::tvec3<T, P
 	mR[0] = right;
 	mR[1] = up;
 	mR[2] = -front_vec;
+	MarkDirty();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -339,11 +379,15 @@ glm::tmat4x4<T, P> TRSTransform<T, P>::GetTranslationRotationMatrix() const
 template<typename T, glm::precision P>
 glm::tmat4x4<T, P> TRSTransform<T, P>::GetMatrix() const
 {
-	return glm::tmat4x4<T, P>(
-			mR[0][0]*mS.x, mR[0][1]*mS.x, mR[0][2]*mS.x, 0,
-			mR[1][0]*mS.y, mR[1][1]*mS.y, mR[1][2]*mS.y, 0,
-			mR[2][0]*mS.z, mR[2][1]*mS.z, mR[2][2]*mS.z, 0,
-			mT.x, mT.y, mT.z, 1);
+	if (mIsMatrixDirty) {
+		mMatrix = glm::tmat4x4<T, P>(
+				mR[0][0]*mS.x, mR[0][1]*mS.x, mR[0][2]*mS.x, 0,
+				mR[1][0]*mS.y, mR[1][1]*mS.y, mR[1][2]*mS.y, 0,
+				mR[2][0]*mS.z, mR[2][1]*mS.z, mR[2][2]*mS.z, 0,
+				mT.x, mT.y, mT.z, 1);
+		mIsMatrixDirty = false;
+	}
+	return mMatrix;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -351,6 +395,9 @@ glm::tmat4x4<T, P> TRSTransform<T, P>::GetMatrix() const
 template<typename T, glm::precision P>
 glm::tmat4x4<T, P> TRSTransform<T, P>::GetMatrixInverse() const
 {
+	if (!mIsMatrixInverseDirty)
+		return mMatrixInverse;
+
 	glm::tvec3<T, P> X = glm::tvec3<T, P>(T(1) / mS.x, T(1) / mS.y, T(1) / mS.z);
 
 	T a = mR[0][0] * X.x;
@@ -363,11 +410,30 @@ glm::tmat4x4<T, P> TRSTransform<T, P>::GetMatrixInverse() const
 	T h = mR[1][2] * X.y;
 	T i = mR[2][2] * X.z;
 
-	return glm::tmat4x4<T, P>(
+	mMatrixInverse = glm::tmat4x4<T, P>(
 			a, b, c, 0,
 			d, e, f, 0,
 			g, h, i, 0,
 			-(mT.x * a + mT.y * d + mT.z * g), -(mT.x * b + mT.y * e + mT.z * h), -(mT.x * c + mT.y * f + mT.z * i), 1);
+	mIsMatrixInverseDirty = false;
+	return mMatrixInverse;
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<typename T, glm::precision P>
+glm::tmat3x3<T, P> TRSTransform<T, P>::GetNormalMatrix() const
+{
+	// The inverse transpose of R * S is R * S^-1, as R is orthonormal.
+	return glm::tmat3x3<T, P>(mR[0] / mS.x, mR[1] / mS.y, mR[2] / mS.z);
+}
+
+/*----------------------------------------------------------------------------*/
+
+template<typename T, glm::precision P>
+std::uint32_t TRSTransform<T, P>::GetRevision() const
+{
+	return mRevision;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,197 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+	// Evaluating a transform track costs about a microsecond, so threads
+	// are only worth spawning for thousands of them.
+	constexpr std::size_t min_tracks_per_thread = 2048u;
+
+	glm::vec3
+	toVec3(std::array<float, 3> const& value)
+	{
+		return glm::vec3(value[0], value[1], value[2]);
+	}
+
+	glm::quat
+	toQuat(std::array<float, 4> const& value)
+	{
+		return glm::quat(value[3], value[0], value[1], value[2]);
+	}
+}
+
+bonobo::animation::TransformTrack::TransformTrack(key_interpolation translation_interpolation,
+                                                  key_interpolation rotation_interpolation,
+                                                  key_interpolation scale_interpolation) :
+	_translation(translation_interpolation), _rotation(rotation_interpolation),
+	_scale(scale_interpolation), _is_looping(false)
+{
+}
+
+void
+bonobo::animation::TransformTrack::add_translation_key(float time, glm::vec3 const& translation)
+{
+	_translation.add_key(time, { translation.x, translation.y, translation.z });
+}
+
+void
+bonobo::animation::TransformTrack::add_rotation_key(float time, glm::quat const& rotation)
+{
+	// q and -q represent the same rotation; pick the one closest to the
+	// previous key so that interpolating between them takes the short way
+	// round.
+	auto key = glm::normalize(rotation);
+	auto const keys_nb = _rotation.get_keys_nb();
+	if (keys_nb > 0u && glm::dot(toQuat(_rotation.get_key(keys_nb - 1u)), key) < 0.0f)
+		key = -key;
+	_rotation.add_key(time, { key.x, key.y, key.z, key.w });
+}
+
+void
+bonobo::animation::TransformTrack::add_scale_key(float time, glm::vec3 const& scale)
+{
+	_scale.add_key(time, { scale.x, scale.y, scale.z });
+}
+
+bool
+bonobo::animation::TransformTrack::has_translation_keys() const
+{
+	return _translation.get_keys_nb() > 0u;
+}
+
+bool
+bonobo::animation::TransformTrack::has_rotation_keys() const
+{
+	return _rotation.get_keys_nb() > 0u;
+}
+
+bool
+bonobo::animation::TransformTrack::has_scale_keys() const
+{
+	return _scale.get_keys_nb() > 0u;
+}
+
+void
+bonobo::animation::TransformTrack::set_looping(bool is_looping)
+{
+	_is_looping = is_looping;
+}
+
+float
+bonobo::animation::TransformTrack::get_duration() const
+{
+	float start, end;
+	get_time_range(start, end);
+	return end - start;
+}
+
+void
+bonobo::animation::TransformTrack::get_time_range(float& start, float& end) const
+{
+	start = 0.0f;
+	end = 0.0f;
+	auto is_first = true;
+	auto const include = [&start, &end, &is_first](std::size_t keys_nb, float track_start, float track_end){
+		if (keys_nb == 0u)
+			return;
+		start = is_first ? track_start : std::min(start, track_start);
+		end = is_first ? track_end : std::max(end, track_end);
+		is_first = false;
+	};
+	include(_translation.get_keys_nb(), _translation.get_start_time(), _translation.get_end_time());
+	include(_rotation.get_keys_nb(), _rotation.get_start_time(), _rotation.get_end_time());
+	include(_scale.get_keys_nb(), _scale.get_start_time(), _scale.get_end_time());
+}
+
+glm::vec3
+bonobo::animation::TransformTrack::eval_translation(float time)
+{
+	return toVec3(_translation.eval(wrap_time(time)));
+}
+
+glm::quat
+bonobo::animation::TransformTrack::eval_rotation(float time)
+{
+	if (_rotation.get_keys_nb() == 0u)
+		return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+	// Linear interpolation goes through slerp, for a constant angular
+	// velocity; the other interpolations work component-wise, and only
+	// need renormalising.
+	time = wrap_time(time);
+	if (_rotation.get_interpolation() != key_interpolation::linear || _rotation.get_keys_nb() == 1u)
+		return glm::normalize(toQuat(_rotation.eval(time)));
+
+	float x = 0.0f;
+	auto const i = _rotation.locate(time, x);
+	return glm::slerp(toQuat(_rotation.get_key(i)), toQuat(_rotation.get_key(i + 1u)), x);
+}
+
+glm::vec3
+bonobo::animation::TransformTrack::eval_scale(float time)
+{
+	return toVec3(_scale.eval(wrap_time(time)));
+}
+
+void
+bonobo::animation::TransformTrack::apply(float time, TRSTransformf& transform)
+{
+	if (_translation.get_keys_nb() > 0u)
+		transform.SetTranslate(eval_translation(time));
+	if (_rotation.get_keys_nb() > 0u)
+		transform.SetRotate(glm::mat3_cast(eval_rotation(time)));
+	if (_scale.get_keys_nb() > 0u)
+		transform.SetScale(eval_scale(time));
+}
+
+float
+bonobo::animation::TransformTrack::wrap_time(float time) const
+{
+	float start, end;
+	get_time_range(start, end);
+	auto const duration = end - start;
+	if (!_is_looping || duration <= 0.0f)
+		return time;
+
+	auto const offset = std::fmod(time - start, duration);
+	return start + (offset < 0.0f ? offset + duration : offset);
+}
+
+void
+bonobo::animation::applyAll(TransformTrack* tracks, TRSTransformf* transforms,
+                            std::size_t tracks_nb, float time)
+{
+	auto const apply_range = [tracks, transforms, time](std::size_t first, std::size_t end){
+		for (std::size_t i = first; i < end; ++i)
+			tracks[i].apply(time, transforms[i]);
+	};
+
+	auto const max_useful_threads_nb = tracks_nb / min_tracks_per_thread;
+	if (max_useful_threads_nb <= 1u) {
+		apply_range(0u, tracks_nb);
+		return;
+	}
+
+	auto const hardware_threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+	auto const threads_nb = std::min<std::size_t>(hardware_threads_nb, max_useful_threads_nb);
+
+	// The calling thread takes care of the last range itself.
+	std::vector<std::thread> workers;
+	workers.reserve(threads_nb - 1u);
+	auto const tracks_per_thread = tracks_nb / threads_nb;
+	auto const remaining_tracks = tracks_nb % threads_nb;
+	std::size_t first_track = 0u;
+	for (std::size_t t = 0u; t < threads_nb; ++t) {
+		auto const end_track = first_track + tracks_per_thread + (t < remaining_tracks ? 1u : 0u);
+		if (t + 1u < threads_nb)
+			workers.emplace_back(apply_range, first_track, end_track);
+		else
+			apply_range(first_track, end_track);
+		first_track = end_track;
+	}
+	for (auto& worker : workers)
+		worker.join();
+}
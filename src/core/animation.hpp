@@ -0,0 +1,142 @@
+#pragma once
+
+#include "TRSTransform.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+//! \brief Keyframe animation of translations, rotations and scales.
+//!
+//! Keys are stored as structures of arrays: one array for the key times,
+//! and one per component of the animated value. Each track remembers the
+//! key it last evaluated, so that playing an animation forward only
+//! looks at one or two keys per evaluation; a binary search is only done
+//! after jumping around in time.
+namespace bonobo
+{
+namespace animation
+{
+	//! \brief How values are computed in-between two keys.
+	enum class key_interpolation : unsigned int {
+		step = 0u,   //!< keep the value of the previous key
+		linear,      //!< linear interpolation (spherical for rotations)
+		catmull_rom  //!< Catmull-Rom spline going through all keys
+	};
+
+	//! \brief Keys of a value made of |ComponentsNb| floats.
+	//!
+	//! Evaluating a track moves its cursor, so a track should not be
+	//! evaluated from several threads at once; different tracks can.
+	template<std::size_t ComponentsNb>
+	class KeyframeTrack
+	{
+	public:
+		using value_type = std::array<float, ComponentsNb>;
+
+		explicit KeyframeTrack(key_interpolation interpolation = key_interpolation::linear);
+
+		//! \brief Append a key.
+		//!
+		//! Keys have to be added in increasing time order; a key which is
+		//! not later than the last one is ignored.
+		void add_key(float time, value_type const& value);
+
+		std::size_t get_keys_nb() const;
+		float get_start_time() const;
+		float get_end_time() const;
+		key_interpolation get_interpolation() const;
+
+		//! \brief Value of the key at index |key_index|.
+		value_type get_key(std::size_t key_index) const;
+
+		//! \brief Place the cursor at |time| with a binary search.
+		void seek(float time);
+
+		//! \brief Find the keys surrounding |time|.
+		//!
+		//! The cursor is moved forward key by key when |time| is slightly
+		//! after the previous lookup, and placed using `seek()` otherwise.
+		//!
+		//! @param [in] time time to look up; it is clamped to the range of
+		//!             the keys
+		//! @param [out] x where |time| lies between the returned key and
+		//!              the next one, from 0 to 1
+		//! @return the index of the last key at or before |time|; when
+		//!         the track has a single key, 0 and x = 0
+		std::size_t locate(float time, float& x);
+
+		//! \brief Evaluate the track at |time|, using its interpolation.
+		//!
+		//! An empty track evaluates to zero.
+		value_type eval(float time);
+
+	private:
+		key_interpolation _interpolation;
+		std::vector<float> _times;
+		std::array<std::vector<float>, ComponentsNb> _values;
+		std::size_t _cursor;
+	};
+
+	//! \brief Translation, rotation and scale tracks animating a
+	//!        `TRSTransformf`.
+	//!
+	//! Empty tracks leave the corresponding part of the transform
+	//! untouched.
+	class TransformTrack
+	{
+	public:
+		explicit TransformTrack(key_interpolation translation_interpolation = key_interpolation::linear,
+		                        key_interpolation rotation_interpolation = key_interpolation::linear,
+		                        key_interpolation scale_interpolation = key_interpolation::linear);
+
+		void add_translation_key(float time, glm::vec3 const& translation);
+		void add_rotation_key(float time, glm::quat const& rotation);
+		void add_scale_key(float time, glm::vec3 const& scale);
+
+		bool has_translation_keys() const;
+		bool has_rotation_keys() const;
+		bool has_scale_keys() const;
+
+		//! \brief Whether times after the last key wrap around to the
+		//!        first one, rather than being clamped.
+		void set_looping(bool is_looping);
+
+		//! \brief Time between the earliest and the latest key over all
+		//!        three tracks.
+		float get_duration() const;
+
+		glm::vec3 eval_translation(float time);
+		glm::quat eval_rotation(float time);
+		glm::vec3 eval_scale(float time);
+
+		//! \brief Evaluate all tracks at |time| and write the result to
+		//!        |transform|.
+		void apply(float time, TRSTransformf& transform);
+
+	private:
+		//! \brief Earliest and latest key over all non-empty tracks, or
+		//!        0 for both if all tracks are empty.
+		void get_time_range(float& start, float& end) const;
+
+		float wrap_time(float time) const;
+
+		KeyframeTrack<3> _translation;
+		KeyframeTrack<4> _rotation; //!< (x, y, z, w) quaternions, all in the same hemisphere as their predecessor
+		KeyframeTrack<3> _scale;
+		bool _is_looping;
+	};
+
+	//! \brief Evaluate |tracks_nb| tracks at |time|, writing the i-th one
+	//!        to |transforms[i]|.
+	//!
+	//! Large amounts of tracks are spread over several threads.
+	void applyAll(TransformTrack* tracks, TRSTransformf* transforms,
+	              std::size_t tracks_nb, float time);
+}
+}
+
+#include "animation.inl"
@@ -0,0 +1,155 @@
+#include "Log.h"
+
+#include <algorithm>
+
+namespace bonobo
+{
+namespace animation
+{
+namespace detail
+{
+	//! Beyond that many keys skipped since the last lookup, a binary
+	//! search is cheaper than walking the keys one by one.
+	constexpr std::size_t max_cursor_steps = 4u;
+}
+}
+}
+
+template<std::size_t ComponentsNb>
+bonobo::animation::KeyframeTrack<ComponentsNb>::KeyframeTrack(key_interpolation interpolation) :
+	_interpolation(interpolation), _times(), _values(), _cursor(0u)
+{
+}
+
+template<std::size_t ComponentsNb>
+void
+bonobo::animation::KeyframeTrack<ComponentsNb>::add_key(float time, value_type const& value)
+{
+	if (!_times.empty() && time <= _times.back()) {
+		LogWarning("Ignoring key at time %f, which is not after the last key (at time %f).", time, _times.back());
+		return;
+	}
+
+	_times.push_back(time);
+	for (std::size_t c = 0u; c < ComponentsNb; ++c)
+		_values[c].push_back(value[c]);
+}
+
+template<std::size_t ComponentsNb>
+std::size_t
+bonobo::animation::KeyframeTrack<ComponentsNb>::get_keys_nb() const
+{
+	return _times.size();
+}
+
+template<std::size_t ComponentsNb>
+float
+bonobo::animation::KeyframeTrack<ComponentsNb>::get_start_time() const
+{
+	return _times.empty() ? 0.0f : _times.front();
+}
+
+template<std::size_t ComponentsNb>
+float
+bonobo::animation::KeyframeTrack<ComponentsNb>::get_end_time() const
+{
+	return _times.empty() ? 0.0f : _times.back();
+}
+
+template<std::size_t ComponentsNb>
+bonobo::animation::key_interpolation
+bonobo::animation::KeyframeTrack<ComponentsNb>::get_interpolation() const
+{
+	return _interpolation;
+}
+
+template<std::size_t ComponentsNb>
+typename bonobo::animation::KeyframeTrack<ComponentsNb>::value_type
+bonobo::animation::KeyframeTrack<ComponentsNb>::get_key(std::size_t key_index) const
+{
+	value_type value;
+	for (std::size_t c = 0u; c < ComponentsNb; ++c)
+		value[c] = _values[c][key_index];
+	return value;
+}
+
+template<std::size_t ComponentsNb>
+void
+bonobo::animation::KeyframeTrack<ComponentsNb>::seek(float time)
+{
+	if (_times.size() < 2u) {
+		_cursor = 0u;
+		return;
+	}
+
+	auto const next = std::upper_bound(_times.begin() + 1, _times.end() - 1, time);
+	_cursor = static_cast<std::size_t>(next - _times.begin()) - 1u;
+}
+
+template<std::size_t ComponentsNb>
+std::size_t
+bonobo::animation::KeyframeTrack<ComponentsNb>::locate(float time, float& x)
+{
+	x = 0.0f;
+	if (_times.size() < 2u)
+		return 0u;
+
+	// The cursor always points at the first key of a segment, i.e. it
+	// stays below the last key.
+	auto const last_segment = _times.size() - 2u;
+	if (time < _times[_cursor]) {
+		seek(time);
+	} else {
+		std::size_t steps = 0u;
+		while (_cursor < last_segment && time >= _times[_cursor + 1u]) {
+			if (++steps > detail::max_cursor_steps) {
+				seek(time);
+				break;
+			}
+			++_cursor;
+		}
+	}
+
+	auto const start = _times[_cursor];
+	auto const end = _times[_cursor + 1u];
+	x = std::min(std::max((time - start) / (end - start), 0.0f), 1.0f);
+	return _cursor;
+}
+
+template<std::size_t ComponentsNb>
+typename bonobo::animation::KeyframeTrack<ComponentsNb>::value_type
+bonobo::animation::KeyframeTrack<ComponentsNb>::eval(float time)
+{
+	value_type value{};
+	if (_times.empty())
+		return value;
+
+	float x = 0.0f;
+	auto const i = locate(time, x);
+	if (_times.size() == 1u || _interpolation == key_interpolation::step) {
+		// Only the end of the last segment reaches x = 1.
+		return get_key(x < 1.0f ? i : i + 1u);
+	}
+
+	if (_interpolation == key_interpolation::linear) {
+		for (std::size_t c = 0u; c < ComponentsNb; ++c)
+			value[c] = _values[c][i] + x * (_values[c][i + 1u] - _values[c][i]);
+		return value;
+	}
+
+	// Catmull-Rom with a tension of 0.5; the first and last keys are
+	// repeated to get the tangents at both ends.
+	auto const previous = i > 0u ? i - 1u : i;
+	auto const after_next = std::min(i + 2u, _times.size() - 1u);
+	auto const x2 = x * x;
+	auto const x3 = x2 * x;
+	auto const w0 = 0.5f * (-x3 + 2.0f * x2 - x);
+	auto const w1 = 0.5f * (3.0f * x3 - 5.0f * x2 + 2.0f);
+	auto const w2 = 0.5f * (-3.0f * x3 + 4.0f * x2 + x);
+	auto const w3 = 0.5f * (x3 - x2);
+	for (std::size_t c = 0u; c < ComponentsNb; ++c) {
+		auto const& values = _values[c];
+		value[c] = w0 * values[previous] + w1 * values[i] + w2 * values[i + 1u] + w3 * values[after_next];
+	}
+	return value;
+}
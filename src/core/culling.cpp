@@ -0,0 +1,206 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bonobo::culling::frustum
+bonobo::culling::extractFrustum(glm::mat4 const& world_to_clip)
+{
+	// A point is inside when -w <= x, y, z <= w in clip space; each of
+	// those inequalities is a plane in world space, made of the rows of
+	// |world_to_clip| (glm matrices being stored column by column).
+	auto const row = [&world_to_clip](int i){
+		return glm::vec4(world_to_clip[0][i], world_to_clip[1][i], world_to_clip[2][i], world_to_clip[3][i]);
+	};
+	auto const x = row(0);
+	auto const y = row(1);
+	auto const z = row(2);
+	auto const w = row(3);
+
+	frustum view;
+	view.planes = { w + x, w - x, w + y, w - y, w + z, w - z };
+	for (auto& plane : view.planes)
+		plane /= glm::length(glm::vec3(plane));
+	return view;
+}
+
+bonobo::culling::containment
+bonobo::culling::classifyBox(frustum const& view, glm::vec3 const& aabb_min,
+                             glm::vec3 const& aabb_max)
+{
+	auto result = containment::inside;
+	for (auto const& plane : view.planes) {
+		// Corners of the box furthest along the plane normal, and
+		// furthest against it.
+		auto const normal = glm::vec3(plane);
+		auto const furthest = glm::vec3(normal.x >= 0.0f ? aabb_max.x : aabb_min.x,
+		                                normal.y >= 0.0f ? aabb_max.y : aabb_min.y,
+		                                normal.z >= 0.0f ? aabb_max.z : aabb_min.z);
+		if (glm::dot(normal, furthest) + plane.w < 0.0f)
+			return containment::outside;
+
+		auto const nearest = aabb_min + aabb_max - furthest;
+		if (glm::dot(normal, nearest) + plane.w < 0.0f)
+			result = containment::intersecting;
+	}
+	return result;
+}
+
+bool
+bonobo::culling::isSphereVisible(frustum const& view, glm::vec3 const& centre,
+                                 float radius)
+{
+	for (auto const& plane : view.planes)
+		if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius)
+			return false;
+	return true;
+}
+
+bool
+bonobo::culling::isVisible(frustum const& view, bounds_data const& bounds,
+                           glm::mat4 const& model_to_world)
+{
+	if (!bounds.is_valid)
+		return true;
+
+	// The sphere is cheaper to test, and rejects most of what is far
+	// off-screen; the box is tighter for what remains.
+	auto const world_bounds = transformBounds(bounds, model_to_world);
+	return isSphereVisible(view, world_bounds.sphere_centre, world_bounds.sphere_radius)
+	    && classifyBox(view, world_bounds.aabb_min, world_bounds.aabb_max) != containment::outside;
+}
+
+bonobo::bounds_data
+bonobo::culling::transformBounds(bounds_data const& bounds,
+                                 glm::mat4 const& model_to_world)
+{
+	if (!bounds.is_valid)
+		return bounds;
+
+	// The extents of the transformed box along each world axis are the
+	// sums of the absolute contributions of the model axes.
+	auto const linear = glm::mat3(model_to_world);
+	auto const absolute = glm::mat3(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+	auto const centre = glm::vec3(model_to_world * glm::vec4(0.5f * (bounds.aabb_min + bounds.aabb_max), 1.0f));
+	auto const extents = absolute * (0.5f * (bounds.aabb_max - bounds.aabb_min));
+
+	auto const max_scale = std::max({ glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]) });
+
+	bounds_data world_bounds;
+	world_bounds.aabb_min = centre - extents;
+	world_bounds.aabb_max = centre + extents;
+	world_bounds.sphere_centre = glm::vec3(model_to_world * glm::vec4(bounds.sphere_centre, 1.0f));
+	world_bounds.sphere_radius = bounds.sphere_radius * max_scale;
+	world_bounds.is_valid = true;
+	return world_bounds;
+}
+
+void
+bonobo::culling::BoundingVolumeHierarchy::build(std::vector<bounds_data> const& world_bounds)
+{
+	_nodes.clear();
+	_primitives.clear();
+	_unbounded.clear();
+
+	for (std::uint32_t i = 0u; i < world_bounds.size(); ++i) {
+		if (world_bounds[i].is_valid)
+			_primitives.push_back(i);
+		else
+			_unbounded.push_back(i);
+	}
+	if (_primitives.empty())
+		return;
+
+	// A balanced binary tree has fewer than twice as many nodes as leaves.
+	_nodes.reserve(2u * _primitives.size());
+	build_node(world_bounds, 0u, static_cast<std::uint32_t>(_primitives.size()));
+}
+
+std::uint32_t
+bonobo::culling::BoundingVolumeHierarchy::build_node(std::vector<bounds_data> const& world_bounds,
+                                                     std::uint32_t first, std::uint32_t end)
+{
+	auto const index = static_cast<std::uint32_t>(_nodes.size());
+	_nodes.emplace_back();
+
+	auto aabb_min = world_bounds[_primitives[first]].aabb_min;
+	auto aabb_max = world_bounds[_primitives[first]].aabb_max;
+	auto centroids_min = 0.5f * (aabb_min + aabb_max);
+	auto centroids_max = centroids_min;
+	for (auto i = first + 1u; i < end; ++i) {
+		auto const& bounds = world_bounds[_primitives[i]];
+		aabb_min = glm::min(aabb_min, bounds.aabb_min);
+		aabb_max = glm::max(aabb_max, bounds.aabb_max);
+		auto const centroid = 0.5f * (bounds.aabb_min + bounds.aabb_max);
+		centroids_min = glm::min(centroids_min, centroid);
+		centroids_max = glm::max(centroids_max, centroid);
+	}
+	_nodes[index].aabb_min = aabb_min;
+	_nodes[index].aabb_max = aabb_max;
+	_nodes[index].first_primitive = first;
+	_nodes[index].primitives_nb = end - first;
+	_nodes[index].second_child = 0u;
+
+	if (end - first <= max_primitives_per_leaf)
+		return index;
+
+	// Split at the median centroid along the axis where they spread the
+	// most.
+	auto const spread = centroids_max - centroids_min;
+	auto const axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+	auto const middle = first + (end - first) / 2u;
+	std::nth_element(_primitives.begin() + first, _primitives.begin() + middle, _primitives.begin() + end,
+	                 [&world_bounds, axis](std::uint32_t lhs, std::uint32_t rhs){
+		return world_bounds[lhs].aabb_min[axis] + world_bounds[lhs].aabb_max[axis]
+		     < world_bounds[rhs].aabb_min[axis] + world_bounds[rhs].aabb_max[axis];
+	});
+
+	build_node(world_bounds, first, middle);
+	auto const second_child = build_node(world_bounds, middle, end);
+	_nodes[index].second_child = second_child;
+
+	return index;
+}
+
+std::size_t
+bonobo::culling::BoundingVolumeHierarchy::query(frustum const& view, std::vector<std::uint32_t>& visible) const
+{
+	visible.assign(_unbounded.begin(), _unbounded.end());
+	if (_nodes.empty())
+		return 0u;
+
+	// Median splits keep the depth logarithmic, so this is plenty.
+	std::array<std::uint32_t, 64> stack;
+	std::size_t stack_size = 0u;
+	std::size_t tested_nodes_nb = 0u;
+
+	std::uint32_t index = 0u;
+	while (true) {
+		auto const& current = _nodes[index];
+		++tested_nodes_nb;
+		auto const result = classifyBox(view, current.aabb_min, current.aabb_max);
+		if (result != containment::outside) {
+			if (result == containment::inside || current.second_child == 0u) {
+				visible.insert(visible.end(), _primitives.begin() + current.first_primitive,
+				               _primitives.begin() + current.first_primitive + current.primitives_nb);
+			} else {
+				stack[stack_size++] = current.second_child;
+				index = index + 1u;
+				continue;
+			}
+		}
+
+		if (stack_size == 0u)
+			break;
+		index = stack[--stack_size];
+	}
+
+	std::sort(visible.begin(), visible.end());
+	return tested_nodes_nb;
+}
+
+std::size_t
+bonobo::culling::BoundingVolumeHierarchy::get_primitives_nb() const
+{
+	return _primitives.size() + _unbounded.size();
+}
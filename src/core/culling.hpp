@@ -0,0 +1,113 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Frustum culling of bounding volumes, either one at a time or
+//!        through a bounding volume hierarchy.
+//!
+//! Frusta are extracted from world-to-clip matrices, so the same code
+//! serves the camera (`FPSCamera::GetWorldToClipMatrix()`) and the
+//! projections of shadow-casting lights.
+namespace bonobo
+{
+namespace culling
+{
+	//! \brief Six planes bounding the volume seen through a projection.
+	//!
+	//! Each plane is stored as (n, d), with n pointing inside the frustum:
+	//! a point p is on the inner side when dot(n, p) + d >= 0.
+	struct frustum {
+		std::array<glm::vec4, 6> planes{};
+	};
+
+	//! \brief Where a volume lies relative to a frustum.
+	enum class containment : unsigned int {
+		outside = 0u, //!< fully outside; can be skipped
+		intersecting, //!< partially inside, or too close to tell
+		inside        //!< fully inside; nothing it contains needs testing
+	};
+
+	//! \brief Extract the frustum seen through |world_to_clip|, following
+	//!        OpenGL's clip-space conventions.
+	frustum extractFrustum(glm::mat4 const& world_to_clip);
+
+	//! \brief Classify an axis-aligned box against |view|.
+	containment classifyBox(frustum const& view, glm::vec3 const& aabb_min,
+	                        glm::vec3 const& aabb_max);
+
+	//! \brief Test whether a sphere touches |view|.
+	bool isSphereVisible(frustum const& view, glm::vec3 const& centre,
+	                     float radius);
+
+	//! \brief Test whether the model-space |bounds| of a mesh, once
+	//!        placed in the world by |model_to_world|, touch |view|.
+	//!
+	//! Invalid bounds are always considered visible.
+	bool isVisible(frustum const& view, bounds_data const& bounds,
+	               glm::mat4 const& model_to_world);
+
+	//! \brief Bring model-space |bounds| to world space.
+	//!
+	//! The box is the one enclosing the transformed box, and the sphere
+	//! radius is scaled by the largest axis scaling of |model_to_world|.
+	bounds_data transformBounds(bounds_data const& bounds,
+	                            glm::mat4 const& model_to_world);
+
+	//! \brief Hierarchy of axis-aligned boxes over a fixed set of
+	//!        world-space bounds, to find those touching a frustum.
+	//!
+	//! Nodes are stored in depth-first order, with each node's first child
+	//! right after it; each node also knows the range of primitives below
+	//! it, so subtrees fully outside the frustum get skipped, and subtrees
+	//! fully inside get accepted, with a single test.
+	class BoundingVolumeHierarchy
+	{
+	public:
+		//! \brief Build the hierarchy over |world_bounds|.
+		//!
+		//! Invalid bounds are kept out of the hierarchy, and returned by
+		//! every query.
+		void build(std::vector<bounds_data> const& world_bounds);
+
+		//! \brief Find all primitives touching |view|.
+		//!
+		//! @param [in] view frustum to test against
+		//! @param [out] visible indices of the primitives, i.e. of the
+		//!              bounds given to `build()`, in increasing order;
+		//!              its previous content is discarded but its memory
+		//!              reused
+		//! @return the number of nodes which had to be tested
+		std::size_t query(frustum const& view, std::vector<std::uint32_t>& visible) const;
+
+		std::size_t get_primitives_nb() const;
+
+	private:
+		//! Leaves are accepted as a whole, so keeping a single primitive
+		//! per leaf makes the culling as tight as testing each one; scenes
+		//! have few enough primitives for the extra nodes not to matter.
+		static constexpr std::uint32_t max_primitives_per_leaf = 1u;
+
+		struct node {
+			glm::vec3 aabb_min;
+			std::uint32_t first_primitive; //!< index into |_primitives| of the first primitive below this node
+			glm::vec3 aabb_max;
+			std::uint32_t primitives_nb;   //!< number of primitives below this node
+			std::uint32_t second_child;    //!< index of the second child, or 0 for leaves
+		};
+
+		std::uint32_t build_node(std::vector<bounds_data> const& world_bounds,
+		                         std::uint32_t first, std::uint32_t end);
+
+		std::vector<node> _nodes;
+		std::vector<std::uint32_t> _primitives; //!< primitive indices, reordered so that each node covers a contiguous range
+		std::vector<std::uint32_t> _unbounded;  //!< primitives with invalid bounds
+	};
+}
+}
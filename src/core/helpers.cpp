@@ -3,6 +3,9 @@
 
 #include "core/Log.h"
 #include "core/opengl.hpp"
+#include "core/skinning.hpp"
+#include "core/static_meshes.hpp"
+#include "core/texture_arrays.hpp"
 #include "core/various.hpp"
 
 #include <assimp/Importer.hpp>
@@ -12,10 +15,14 @@
 #include <imgui.h>
 #include <stb_image.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <utility>
 
 namespace
 {
@@ -35,6 +42,8 @@ namespace
 
 	GLuint debug_texture_id{ 0u };
 
+	constexpr auto basis_arrow = bonobo::static_meshes::make_arrow(0.1f);
+
 	void setupBasisData();
 	void createDebugTexture();
 }
@@ -83,19 +92,18 @@ bonobo::deinit()
 	glDeleteVertexArrays(1, &local::display_vao);
 }
 
+// Returns an empty vector if the image could not be loaded.
 static std::vector<std::uint8_t>
-getTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t& height, bool flip)
+decodeTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t& height, bool flip)
 {
 	auto const channels_nb = 4u;
 	stbi_set_flip_vertically_on_load_thread(flip ? 1 : 0);
 	unsigned char* image_data = stbi_load(filename.c_str(), reinterpret_cast<int*>(&width), reinterpret_cast<int*>(&height), nullptr, channels_nb);
 	if (image_data == nullptr) {
 		LogWarning("Couldn't load or decode image file %s", filename.c_str());
-
-		// Provide a small empty image instead in case of failure.
-		width = 16;
-		height = 16;
-		return std::vector<unsigned char>(width * height * channels_nb);
+		width = 0u;
+		height = 0u;
+		return std::vector<unsigned char>();
 	}
 
 	std::vector<unsigned char> image(width * height * channels_nb);
@@ -105,9 +113,298 @@ getTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t&
 	return image;
 }
 
+static std::vector<std::uint8_t>
+getTextureData(std::string const& filename, std::uint32_t& width, std::uint32_t& height, bool flip)
+{
+	auto image = decodeTextureData(filename, width, height, flip);
+	if (image.empty()) {
+		// Provide a small empty image instead in case of failure.
+		width = 16;
+		height = 16;
+		image.resize(width * height * 4u);
+	}
+
+	return image;
+}
+
+static std::vector<std::uint8_t>
+packTextureData(std::string const& main_filename, std::uint32_t main_channels_nb,
+                std::string const& extra_filename, std::uint32_t extra_channel,
+                std::array<std::uint8_t, 4> const& defaults,
+                std::uint32_t& width, std::uint32_t& height,
+                bool& has_main, bool& has_extra)
+{
+	assert(main_channels_nb <= 4u && extra_channel < 4u);
+
+	std::uint32_t main_width = 0u, main_height = 0u;
+	std::vector<std::uint8_t> main_data;
+	if (!main_filename.empty())
+		main_data = decodeTextureData(main_filename, main_width, main_height, true);
+
+	std::uint32_t extra_width = 0u, extra_height = 0u;
+	std::vector<std::uint8_t> extra_data;
+	if (!extra_filename.empty())
+		extra_data = decodeTextureData(extra_filename, extra_width, extra_height, true);
+
+	// Only the images that could be loaded get packed, so that callers do
+	// not advertise textures that are made of the default values only.
+	has_main = !main_data.empty();
+	has_extra = !extra_data.empty();
+
+	// The packed texture uses the resolution of the main texture, and the
+	// extra one gets resampled (nearest neighbour) to match it if needed.
+	width = !main_data.empty() ? main_width : extra_width;
+	height = !main_data.empty() ? main_height : extra_height;
+
+	std::vector<std::uint8_t> packed(static_cast<size_t>(width) * height * 4u);
+	for (std::uint32_t y = 0u; y < height; ++y) {
+		for (std::uint32_t x = 0u; x < width; ++x) {
+			auto const texel_index = 4u * (static_cast<size_t>(y) * width + x);
+			for (std::uint32_t channel = 0u; channel < 4u; ++channel) {
+				packed[texel_index + channel] = (channel < main_channels_nb && !main_data.empty())
+				                              ? main_data[texel_index + channel]
+				                              : defaults[channel];
+			}
+
+			if (extra_data.empty())
+				continue;
+
+			// The extra texture is expected to be greyscale, but average
+			// its RGB channels in case it is not.
+			auto const extra_x = static_cast<size_t>(x) * extra_width / width;
+			auto const extra_y = static_cast<size_t>(y) * extra_height / height;
+			auto const extra_index = 4u * (extra_y * extra_width + extra_x);
+			auto const extra_sum = static_cast<std::uint32_t>(extra_data[extra_index + 0u])
+			                     + static_cast<std::uint32_t>(extra_data[extra_index + 1u])
+			                     + static_cast<std::uint32_t>(extra_data[extra_index + 2u]);
+			packed[texel_index + extra_channel] = static_cast<std::uint8_t>(extra_sum / 3u);
+		}
+	}
+
+	return packed;
+}
+
+static GLuint
+createTexture2DFromData(std::vector<std::uint8_t> const& data, std::uint32_t width, std::uint32_t height, bool generate_mipmap)
+{
+	if (data.empty())
+		return 0u;
+
+	GLuint texture = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const*>(data.data()));
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (generate_mipmap)
+		glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0u);
+
+	return texture;
+}
+
+static bool
+isMeshSupported(aiMesh const* const assimp_object_mesh)
+{
+	if (!assimp_object_mesh->HasFaces()) {
+		LogError("Unsupported mesh \"%s\": has no faces", assimp_object_mesh->mName.C_Str());
+		return false;
+	}
+	if ((assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_POINT | aiPrimitiveType_NGONEncodingFlag))    != 0u
+	 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_LINE | aiPrimitiveType_NGONEncodingFlag))     != 0u
+	 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_TRIANGLE | aiPrimitiveType_NGONEncodingFlag)) != 0u) {
+		LogError("Unsupported mesh \"%s\": uses multiple primitive types", assimp_object_mesh->mName.C_Str());
+		return false;
+	}
+	if ((assimp_object_mesh->mPrimitiveTypes & static_cast<uint32_t>(aiPrimitiveType_POLYGON)) == static_cast<uint32_t>(aiPrimitiveType_POLYGON)) {
+		LogError("Unsupported mesh \"%s\": uses polygons", assimp_object_mesh->mName.C_Str());
+		return false;
+	}
+	if (!assimp_object_mesh->HasPositions()) {
+		LogError("Unsupported mesh \"%s\": has no positions", assimp_object_mesh->mName.C_Str());
+		return false;
+	}
+
+	return true;
+}
+
+// Create the VAO, VBO and IBO of |object| from tightly packed arrays of
+// |vertices_nb| 3-component float attributes, and of 4-component byte
+// joint indices and weights; any attribute pointer can be null, except for
+// |vertices|, in which case that attribute is left disabled.
+static void
+uploadMeshData(bonobo::mesh_data& object, GLsizei vertices_nb,
+               GLvoid const* vertices, GLvoid const* normals,
+               GLvoid const* texcoords, GLvoid const* tangents,
+               GLvoid const* binormals, GLvoid const* joint_indices,
+               GLvoid const* joint_weights, std::vector<GLuint> const& indices)
+{
+	// Assimp stores its vectors as three tightly packed floats, just like
+	// glm::vec3.
+	object.bounds = bonobo::computeBounds(static_cast<glm::vec3 const*>(vertices), static_cast<std::size_t>(vertices_nb));
+
+	glGenVertexArrays(1, &object.vao);
+	assert(object.vao != 0u);
+	glBindVertexArray(object.vao);
+
+	auto const vertices_offset = 0u;
+	auto const vertices_size = static_cast<GLsizeiptr>(vertices_nb * sizeof(glm::vec3));
+
+	auto const normals_offset = vertices_size;
+	auto const normals_size = normals != nullptr ? vertices_size : 0u;
+
+	auto const texcoords_offset = normals_offset + normals_size;
+	auto const texcoords_size = texcoords != nullptr ? vertices_size : 0u;
+
+	auto const tangents_offset = texcoords_offset + texcoords_size;
+	auto const tangents_size = tangents != nullptr ? vertices_size : 0u;
+
+	auto const binormals_offset = tangents_offset + tangents_size;
+	auto const binormals_size = binormals != nullptr ? vertices_size : 0u;
+
+	auto const influences_size = static_cast<GLsizeiptr>(vertices_nb * bonobo::skinning::max_influences_per_vertex * sizeof(std::uint8_t));
+
+	auto const joint_indices_offset = binormals_offset + binormals_size;
+	auto const joint_indices_size = joint_indices != nullptr ? influences_size : 0u;
+
+	auto const joint_weights_offset = joint_indices_offset + joint_indices_size;
+	auto const joint_weights_size = joint_weights != nullptr ? influences_size : 0u;
+
+	auto const bo_size = static_cast<GLsizeiptr>(vertices_size
+	                                            +normals_size
+	                                            +texcoords_size
+	                                            +tangents_size
+	                                            +binormals_size
+	                                            +joint_indices_size
+	                                            +joint_weights_size
+	                                            );
+	glGenBuffers(1, &object.bo);
+	assert(object.bo != 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, object.bo);
+	glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
+
+	glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, vertices);
+	glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
+	glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
+
+	if (normals != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, normals);
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
+	}
+
+	if (texcoords != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, texcoords);
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
+	}
+
+	if (tangents != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, tangents);
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+	}
+
+	if (binormals != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, binormals);
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
+	}
+
+	// Joint indices stay integers in the shader, while the weights are
+	// normalised back to [0, 1].
+	if (joint_indices != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, joint_indices_offset, joint_indices_size, joint_indices);
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::joint_indices));
+		glVertexAttribIPointer(static_cast<unsigned int>(bonobo::shader_bindings::joint_indices), 4, GL_UNSIGNED_BYTE, 0, reinterpret_cast<GLvoid const*>(joint_indices_offset));
+	}
+
+	if (joint_weights != nullptr) {
+		glBufferSubData(GL_ARRAY_BUFFER, joint_weights_offset, joint_weights_size, joint_weights);
+		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::joint_weights));
+		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::joint_weights), 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, reinterpret_cast<GLvoid const*>(joint_weights_offset));
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+	object.vertices_nb = vertices_nb;
+	object.indices_nb = static_cast<GLsizei>(indices.size());
+	object.is_skinned = joint_indices != nullptr && joint_weights != nullptr;
+	glGenBuffers(1, &object.ibo);
+	assert(object.ibo != 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size() * sizeof(GLuint)), reinterpret_cast<GLvoid const*>(indices.data()), GL_STATIC_DRAW);
+
+	utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, object.vao, object.name + " VAO");
+	utils::opengl::debug::nameObject(GL_BUFFER, object.bo, object.name + " VBO");
+	utils::opengl::debug::nameObject(GL_BUFFER, object.ibo, object.name + " IBO");
+
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+}
+
+// Normalise |direction|, unless it is (close to) zero: assimp leaves the
+// tangents of meshes without texture coordinates zeroed, and those would
+// otherwise turn into NaNs.
+static glm::vec3
+safeNormalize(glm::vec3 const& direction)
+{
+	auto const length = glm::length(direction);
+	return length > 1.0e-6f ? direction / length : glm::vec3(0.0f);
+}
+
+// Append the indices of all faces of |assimp_object_mesh| to |indices|,
+// offsetting each of them by |base_vertex|.
+static void
+appendMeshIndices(aiMesh const* const assimp_object_mesh, GLuint base_vertex, std::vector<GLuint>& indices)
+{
+	auto const num_vertices_per_face = assimp_object_mesh->mFaces[0u].mNumIndices;
+	indices.reserve(indices.size() + assimp_object_mesh->mNumFaces * num_vertices_per_face);
+	for (size_t i = 0u; i < assimp_object_mesh->mNumFaces; ++i) {
+		auto const& face = assimp_object_mesh->mFaces[i];
+		assert(face.mNumIndices <= 3);
+		for (unsigned int k = 0u; k < num_vertices_per_face; ++k)
+			indices.push_back(base_vertex + face.mIndices[k]);
+	}
+}
+
+// Walk the node hierarchy below |node| and record, for each mesh reference,
+// the index of the mesh along with its model-to-scene transform.
+static void
+collectMeshInstances(aiNode const* const node, glm::mat4 const& parent_transform,
+                     std::vector<std::pair<unsigned int, glm::mat4>>& instances)
+{
+	// Assimp matrices are stored row-major, GLM ones column-major.
+	auto const& m = node->mTransformation;
+	glm::mat4 const local_transform(m.a1, m.b1, m.c1, m.d1,
+	                                m.a2, m.b2, m.c2, m.d2,
+	                                m.a3, m.b3, m.c3, m.d3,
+	                                m.a4, m.b4, m.c4, m.d4);
+	auto const transform = parent_transform * local_transform;
+
+	for (unsigned int i = 0u; i < node->mNumMeshes; ++i)
+		instances.emplace_back(node->mMeshes[i], transform);
+	for (unsigned int i = 0u; i < node->mNumChildren; ++i)
+		collectMeshInstances(node->mChildren[i], transform, instances);
+}
+
+static GLenum
+getDrawingMode(unsigned int num_vertices_per_face)
+{
+	switch (num_vertices_per_face) {
+		case 1u:  return GL_POINTS;
+		case 2u:  return GL_LINES;
+		default:  return GL_TRIANGLES;
+	}
+}
+
 std::vector<bonobo::mesh_data>
-bonobo::loadObjects(std::string const& filename)
+bonobo::loadObjects(std::string const& filename, load_options const& options)
 {
+	auto const pack_textures = options.pack_textures;
+	auto const batch_by_material = options.batch_by_material;
+	auto const rig = options.rig;
+	auto const arrays = options.arrays;
+
 	auto const scene_start_time = std::chrono::high_resolution_clock::now();
 
 	std::vector<bonobo::mesh_data> objects;
@@ -141,6 +438,12 @@ bonobo::loadObjects(std::string const& filename)
 	auto const materials_start_time = std::chrono::high_resolution_clock::now();
 	std::vector<texture_bindings> materials_bindings(assimp_scene->mNumMaterials);
 	std::vector<material_data> material_constants(assimp_scene->mNumMaterials);
+	// With texture arrays, images are only queued while going through the
+	// materials, and each material remembers which ones it uses until
+	// they get uploaded and their layers are known.
+	texture_arrays::TextureArrayBuilder texture_array_builder;
+	auto const array_builder = arrays != nullptr ? &texture_array_builder : nullptr;
+	std::vector<std::unordered_map<std::string, std::uint32_t>> materials_image_ids(assimp_scene->mNumMaterials);
 	uint32_t texture_count = 0u;
 	for (size_t i = 0; i < assimp_scene->mNumMaterials; ++i) {
 		if (!are_materials_used[i])
@@ -148,32 +451,106 @@ bonobo::loadObjects(std::string const& filename)
 
 		auto const material_start_time = std::chrono::high_resolution_clock::now();
 		texture_bindings& bindings = materials_bindings[i];
+		auto& image_ids = materials_image_ids[i];
 		material_data& constants = material_constants[i];
 		auto const material = assimp_scene->mMaterials[i];
 
-		auto const process_texture = [&bindings,&material,i,&parent_folder,&texture_count](aiTextureType type, std::string const& type_as_str, std::string const& name){
-			if (material->GetTextureCount(type)) {
-				auto const texture_start_time = std::chrono::high_resolution_clock::now();
+		auto const get_texture_path = [&material](aiTextureType type, std::string const& type_as_str){
+			if (material->GetTextureCount(type) == 0u)
+				return std::string();
 
-				if (material->GetTextureCount(type) > 1)
-					LogWarning("Material \"%s\" has more than one %s texture: discarding all but the first one.", material->GetName().C_Str(), type_as_str.c_str());
-				aiString path;
-				material->GetTexture(type, 0, &path);
-				auto const id = bonobo::loadTexture2D(parent_folder + std::string(path.C_Str()));
+			if (material->GetTextureCount(type) > 1)
+				LogWarning("Material \"%s\" has more than one %s texture: discarding all but the first one.", material->GetName().C_Str(), type_as_str.c_str());
+			aiString path;
+			material->GetTexture(type, 0, &path);
+			return std::string(path.C_Str());
+		};
+
+		auto const process_texture = [&bindings,&image_ids,&array_builder,&material,&get_texture_path,&parent_folder,&texture_count](aiTextureType type, std::string const& type_as_str, std::string const& name){
+			auto const path = get_texture_path(type, type_as_str);
+			if (path.empty())
+				return;
+
+			auto const texture_start_time = std::chrono::high_resolution_clock::now();
+
+			auto const is_first_texture = bindings.empty() && image_ids.empty();
+			if (array_builder != nullptr) {
+				std::uint32_t width, height;
+				auto data = decodeTextureData(parent_folder + path, width, height, true);
+				if (data.empty()) {
+					LogWarning("Failed to load the %s texture for material \"%s\".", type_as_str.c_str(), material->GetName().C_Str());
+					return;
+				}
+				image_ids.emplace(name, array_builder->add_image(std::move(data), width, height));
+			} else {
+				auto const id = bonobo::loadTexture2D(parent_folder + path);
 				if (id == 0u) {
 					LogWarning("Failed to load the %s texture for material \"%s\".", type_as_str.c_str(), material->GetName().C_Str());
 					return;
 				}
 				bindings.emplace(name, id);
-				++texture_count;
 
 				utils::opengl::debug::nameObject(GL_TEXTURE, id, std::string(material->GetName().C_Str()) + " " + type_as_str);
+			}
+			++texture_count;
 
-				auto const texture_end_time = std::chrono::high_resolution_clock::now();
-				LogTrivia("│ %s Texture \"%s\" loaded in %.3f ms",
-				          bindings.size() == 1 ? "┌" : "├", path.C_Str(),
-				          std::chrono::duration<float, std::milli>(texture_end_time - texture_start_time).count());
+			auto const texture_end_time = std::chrono::high_resolution_clock::now();
+			LogTrivia("│ %s Texture \"%s\" loaded in %.3f ms",
+			          is_first_texture ? "┌" : "├", path.c_str(),
+			          std::chrono::duration<float, std::milli>(texture_end_time - texture_start_time).count());
+		};
+
+		// Bake the |main_channels_nb| first channels of the main texture
+		// with a single channel of the extra texture, written at
+		// |extra_channel|, into a single RGBA texture.
+		auto const process_packed_textures = [&bindings,&image_ids,&array_builder,&material,&get_texture_path,&parent_folder,&texture_count](
+			aiTextureType main_type, std::string const& main_type_as_str, std::string const& main_name, std::uint32_t main_channels_nb,
+			aiTextureType extra_type, std::string const& extra_type_as_str, std::string const& extra_name, std::uint32_t extra_channel,
+			std::array<std::uint8_t, 4> const& defaults){
+			auto const main_path = get_texture_path(main_type, main_type_as_str);
+			auto const extra_path = get_texture_path(extra_type, extra_type_as_str);
+			if (main_path.empty() && extra_path.empty())
+				return;
+
+			auto const texture_start_time = std::chrono::high_resolution_clock::now();
+
+			std::uint32_t width, height;
+			bool has_main, has_extra;
+			auto data = packTextureData(main_path.empty() ? main_path : parent_folder + main_path, main_channels_nb,
+			                            extra_path.empty() ? extra_path : parent_folder + extra_path, extra_channel,
+			                            defaults, width, height, has_main, has_extra);
+			if (data.empty()) {
+				LogWarning("Failed to pack the %s and %s textures for material \"%s\".", main_type_as_str.c_str(), extra_type_as_str.c_str(), material->GetName().C_Str());
+				return;
 			}
+			auto const is_first_texture = bindings.empty() && image_ids.empty();
+			if (array_builder != nullptr) {
+				auto const image_id = array_builder->add_image(std::move(data), width, height);
+				if (has_main)
+					image_ids.emplace(main_name, image_id);
+				if (has_extra)
+					image_ids.emplace(extra_name, image_id);
+			} else {
+				auto const id = createTexture2DFromData(data, width, height, true);
+				if (id == 0u) {
+					LogWarning("Failed to pack the %s and %s textures for material \"%s\".", main_type_as_str.c_str(), extra_type_as_str.c_str(), material->GetName().C_Str());
+					return;
+				}
+				if (has_main)
+					bindings.emplace(main_name, id);
+				if (has_extra)
+					bindings.emplace(extra_name, id);
+
+				utils::opengl::debug::nameObject(GL_TEXTURE, id, std::string(material->GetName().C_Str()) + " " + main_type_as_str + "-" + extra_type_as_str);
+			}
+			++texture_count;
+
+			auto const texture_end_time = std::chrono::high_resolution_clock::now();
+			LogTrivia("│ %s Textures \"%s\" and \"%s\" packed in %.3f ms",
+			          is_first_texture ? "┌" : "├",
+			          main_path.empty() ? "<none>" : main_path.c_str(),
+			          extra_path.empty() ? "<none>" : extra_path.c_str(),
+			          std::chrono::duration<float, std::milli>(texture_end_time - texture_start_time).count());
 		};
 
 		aiColor3D color;
@@ -190,157 +567,222 @@ bonobo::loadObjects(std::string const& filename)
 		material->Get(AI_MATKEY_REFRACTI, constants.indexOfRefraction);
 		material->Get(AI_MATKEY_OPACITY, constants.opacity);
 
-		process_texture(aiTextureType_DIFFUSE,  "diffuse",  "diffuse_texture");
-		process_texture(aiTextureType_SPECULAR, "specular", "specular_texture");
-		process_texture(aiTextureType_NORMALS,  "normals",  "normals_texture");
-		process_texture(aiTextureType_OPACITY,  "opacity",  "opacity_texture");
+		if (pack_textures) {
+			process_packed_textures(aiTextureType_DIFFUSE, "diffuse", "diffuse_texture", 3u,
+			                        aiTextureType_OPACITY, "opacity", "opacity_texture", 3u,
+			                        { 0u, 0u, 0u, 255u });
+			process_packed_textures(aiTextureType_NORMALS,  "normals",  "normals_texture", 2u,
+			                        aiTextureType_SPECULAR, "specular", "specular_texture", 2u,
+			                        { 128u, 128u, 0u, 255u });
+		} else {
+			process_texture(aiTextureType_DIFFUSE,  "diffuse",  "diffuse_texture");
+			process_texture(aiTextureType_SPECULAR, "specular", "specular_texture");
+			process_texture(aiTextureType_NORMALS,  "normals",  "normals_texture");
+			process_texture(aiTextureType_OPACITY,  "opacity",  "opacity_texture");
+		}
 
 		auto const material_end_time = std::chrono::high_resolution_clock::now();
 		LogTrivia("│ %s Material \"%s\" loaded in %.3f ms",
-		          bindings.empty() ? "╺" : "┕", material->GetName().C_Str(),
+		          bindings.empty() && image_ids.empty() ? "╺" : "┕", material->GetName().C_Str(),
 		          std::chrono::duration<float, std::milli>(material_end_time - material_start_time).count());
 	}
+	std::vector<texture_layer_bindings> materials_layer_bindings(assimp_scene->mNumMaterials);
+	if (array_builder != nullptr) {
+		auto const layers = array_builder->build(*arrays);
+		for (size_t i = 0; i < materials_image_ids.size(); ++i)
+			for (auto const& image_id : materials_image_ids[i])
+				if (layers[image_id.second].is_valid)
+					materials_layer_bindings[i].emplace(image_id.first, layers[image_id.second]);
+		LogInfo("│ Textures grouped into %zu texture arrays", arrays->arrays.size());
+	}
 	auto const materials_end_time = std::chrono::high_resolution_clock::now();
 
-	auto const meshes_start_time = std::chrono::high_resolution_clock::now();
-	objects.reserve(assimp_scene->mNumMeshes);
-	for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
-		auto const mesh_start_time = std::chrono::high_resolution_clock::now();
+	auto has_rig = false;
+	if (rig != nullptr) {
+		*rig = skinning::rig_data();
+		if (batch_by_material)
+			LogWarning("Skinning data is ignored when batching meshes by material.");
+		else
+			has_rig = skinning::detail::importRig(*assimp_scene, *rig);
+		if (has_rig)
+			LogInfo("│ Skeleton with %zu joints and %zu animation clips imported", rig->skeleton.joint_names.size(), rig->clips.size());
+	}
 
-		auto const assimp_object_mesh = assimp_scene->mMeshes[j];
+	auto const meshes_start_time = std::chrono::high_resolution_clock::now();
+	std::vector<bool> are_meshes_supported(assimp_scene->mNumMeshes);
+	for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j)
+		are_meshes_supported[j] = isMeshSupported(assimp_scene->mMeshes[j]);
 
-		if (!assimp_object_mesh->HasFaces()) {
-			LogError("Unsupported mesh \"%s\": has no faces", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
-		if ((assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_POINT | aiPrimitiveType_NGONEncodingFlag))    != 0u
-		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_LINE | aiPrimitiveType_NGONEncodingFlag))     != 0u
-		 && (assimp_object_mesh->mPrimitiveTypes & ~static_cast<uint32_t>(aiPrimitiveType_TRIANGLE | aiPrimitiveType_NGONEncodingFlag)) != 0u) {
-			LogError("Unsupported mesh \"%s\": uses multiple primitive types", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
-		if ((assimp_object_mesh->mPrimitiveTypes & static_cast<uint32_t>(aiPrimitiveType_POLYGON)) == static_cast<uint32_t>(aiPrimitiveType_POLYGON)) {
-			LogError("Unsupported mesh \"%s\": uses polygons", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
-		if (!assimp_object_mesh->HasPositions()) {
-			LogError("Unsupported mesh \"%s\": has no positions", assimp_object_mesh->mName.C_Str());
-			continue;
-		}
+	auto const get_attributes_as_str = [](bool has_normals, bool has_tangents, bool has_texcoords){
+		std::string attributes = has_normals ? "normals" : "";
+		if (!attributes.empty())
+		  attributes += " | ";
+		if (has_tangents)
+		  attributes += "tangents&bitangents";
+		if (!attributes.empty())
+		  attributes += " | ";
+		if (has_texcoords)
+		  attributes += "texture coordinates";
+		return attributes;
+	};
 
-		bonobo::mesh_data object;
-		if (assimp_object_mesh->mName.length != 0)
-		{
-			object.name = std::string(assimp_object_mesh->mName.C_Str());
+	if (batch_by_material) {
+		// Group all mesh references by material and primitive type, so
+		// that each group can be drawn with a single call.
+		std::vector<std::pair<unsigned int, glm::mat4>> instances;
+		collectMeshInstances(assimp_scene->mRootNode, glm::mat4(1.0f), instances);
+
+		std::map<std::pair<unsigned int, unsigned int>, std::vector<size_t>> batches;
+		for (size_t i = 0; i < instances.size(); ++i) {
+			auto const mesh_id = instances[i].first;
+			if (!are_meshes_supported[mesh_id])
+				continue;
+			auto const assimp_object_mesh = assimp_scene->mMeshes[mesh_id];
+			auto const key = std::make_pair(assimp_object_mesh->mMaterialIndex, assimp_object_mesh->mFaces[0u].mNumIndices);
+			batches[key].push_back(i);
 		}
 
-		glGenVertexArrays(1, &object.vao);
-		assert(object.vao != 0u);
-		glBindVertexArray(object.vao);
-
-		auto const vertices_offset = 0u;
-		auto const vertices_size = static_cast<GLsizeiptr>(assimp_object_mesh->mNumVertices * sizeof(glm::vec3));
-
-		auto const normals_offset = vertices_size;
-		auto const normals_size = assimp_object_mesh->HasNormals() ? vertices_size : 0u;
-
-		auto const texcoords_offset = normals_offset + normals_size;
-		auto const texcoords_size = assimp_object_mesh->HasTextureCoords(0u) ? vertices_size : 0u;
+		objects.reserve(batches.size());
+		size_t batch_index = 0u;
+		for (auto const& batch : batches) {
+			auto const batch_start_time = std::chrono::high_resolution_clock::now();
+
+			auto const material_id = batch.first.first;
+			auto const& batch_instances = batch.second;
+
+			// An attribute is kept if any of the meshes provides it;
+			// meshes lacking it get zero-filled values.
+			size_t vertices_nb = 0u;
+			bool has_normals = false, has_texcoords = false, has_tangents = false;
+			for (auto const instance_id : batch_instances) {
+				auto const assimp_object_mesh = assimp_scene->mMeshes[instances[instance_id].first];
+				vertices_nb += assimp_object_mesh->mNumVertices;
+				has_normals |= assimp_object_mesh->HasNormals();
+				has_texcoords |= assimp_object_mesh->HasTextureCoords(0u);
+				has_tangents |= assimp_object_mesh->HasTangentsAndBitangents();
+			}
 
-		auto const tangents_offset = texcoords_offset + texcoords_size;
-		auto const tangents_size = assimp_object_mesh->HasTangentsAndBitangents() ? vertices_size : 0u;
+			std::vector<glm::vec3> vertices, normals, texcoords, tangents, binormals;
+			vertices.reserve(vertices_nb);
+			normals.resize(has_normals ? vertices_nb : 0u, glm::vec3(0.0f));
+			texcoords.resize(has_texcoords ? vertices_nb : 0u, glm::vec3(0.0f));
+			tangents.resize(has_tangents ? vertices_nb : 0u, glm::vec3(0.0f));
+			binormals.resize(has_tangents ? vertices_nb : 0u, glm::vec3(0.0f));
+			std::vector<GLuint> indices;
+
+			// Bake the scene transform of each mesh into its vertices.
+			for (auto const instance_id : batch_instances) {
+				auto const assimp_object_mesh = assimp_scene->mMeshes[instances[instance_id].first];
+				auto const& transform = instances[instance_id].second;
+				auto const linear_transform = glm::mat3(transform);
+				auto const normal_transform = glm::transpose(glm::inverse(linear_transform));
+
+				auto const base_vertex = static_cast<GLuint>(vertices.size());
+				for (unsigned int v = 0u; v < assimp_object_mesh->mNumVertices; ++v) {
+					auto const& position = assimp_object_mesh->mVertices[v];
+					vertices.emplace_back(transform * glm::vec4(position.x, position.y, position.z, 1.0f));
+
+					auto const k = base_vertex + v;
+					if (assimp_object_mesh->HasNormals()) {
+						auto const& normal = assimp_object_mesh->mNormals[v];
+						normals[k] = safeNormalize(normal_transform * glm::vec3(normal.x, normal.y, normal.z));
+					}
+					if (assimp_object_mesh->HasTextureCoords(0u)) {
+						auto const& texcoord = assimp_object_mesh->mTextureCoords[0u][v];
+						texcoords[k] = glm::vec3(texcoord.x, texcoord.y, texcoord.z);
+					}
+					if (assimp_object_mesh->HasTangentsAndBitangents()) {
+						auto const& tangent = assimp_object_mesh->mTangents[v];
+						auto const& binormal = assimp_object_mesh->mBitangents[v];
+						tangents[k] = safeNormalize(linear_transform * glm::vec3(tangent.x, tangent.y, tangent.z));
+						binormals[k] = safeNormalize(linear_transform * glm::vec3(binormal.x, binormal.y, binormal.z));
+					}
+				}
+				appendMeshIndices(assimp_object_mesh, base_vertex, indices);
+			}
 
-		auto const binormals_offset = tangents_offset + tangents_size;
-		auto const binormals_size = assimp_object_mesh->HasTangentsAndBitangents() ? vertices_size : 0u;
+			bonobo::mesh_data object;
+			if (material_id < assimp_scene->mNumMaterials && assimp_scene->mMaterials[material_id]->GetName().length != 0)
+				object.name = std::string(assimp_scene->mMaterials[material_id]->GetName().C_Str()) + " batch";
+			object.drawing_mode = getDrawingMode(batch.first.second);
+
+			uploadMeshData(object, static_cast<GLsizei>(vertices_nb),
+			               static_cast<GLvoid const*>(vertices.data()),
+			               has_normals ? static_cast<GLvoid const*>(normals.data()) : nullptr,
+			               has_texcoords ? static_cast<GLvoid const*>(texcoords.data()) : nullptr,
+			               has_tangents ? static_cast<GLvoid const*>(tangents.data()) : nullptr,
+			               has_tangents ? static_cast<GLvoid const*>(binormals.data()) : nullptr,
+			               nullptr, nullptr,
+			               indices);
+
+			if (material_id < materials_bindings.size()) {
+				object.bindings = materials_bindings[material_id];
+				object.layer_bindings = materials_layer_bindings[material_id];
+				object.material = material_constants[material_id];
+			}
 
-		auto const bo_size = static_cast<GLsizeiptr>(vertices_size
-		                                            +normals_size
-		                                            +texcoords_size
-		                                            +tangents_size
-		                                            +binormals_size
-		                                            );
-		glGenBuffers(1, &object.bo);
-		assert(object.bo != 0u);
-		glBindBuffer(GL_ARRAY_BUFFER, object.bo);
-		glBufferData(GL_ARRAY_BUFFER, bo_size, nullptr, GL_STATIC_DRAW);
+			auto const batch_end_time = std::chrono::high_resolution_clock::now();
 
-		glBufferSubData(GL_ARRAY_BUFFER, vertices_offset, vertices_size, static_cast<GLvoid const*>(assimp_object_mesh->mVertices));
-		glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::vertices));
-		glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
+			LogTrivia("│ %s Batch \"%s\" built from %zu meshes with attributes [%s] in %.3f ms",
+			          (batches.size() == 1u) ? "╶" : (batch_index == 0 ? "┌" : (batch_index == batches.size() - 1 ? "└" : "├")),
+			          object.name.c_str(), batch_instances.size(),
+			          get_attributes_as_str(has_normals, has_tangents, has_texcoords).c_str(),
+			          std::chrono::duration<float, std::milli>(batch_end_time - batch_start_time).count());
 
-		if (assimp_object_mesh->HasNormals()) {
-			glBufferSubData(GL_ARRAY_BUFFER, normals_offset, normals_size, static_cast<GLvoid const*>(assimp_object_mesh->mNormals));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::normals));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::normals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(normals_offset));
+			objects.push_back(std::move(object));
+			++batch_index;
 		}
+	} else {
+		objects.reserve(assimp_scene->mNumMeshes);
+		for (size_t j = 0; j < assimp_scene->mNumMeshes; ++j) {
+			if (!are_meshes_supported[j])
+				continue;
 
-		if (assimp_object_mesh->HasTextureCoords(0u)) {
-			glBufferSubData(GL_ARRAY_BUFFER, texcoords_offset, texcoords_size, static_cast<GLvoid const*>(assimp_object_mesh->mTextureCoords[0u]));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::texcoords));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::texcoords), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(texcoords_offset));
-		}
+			auto const mesh_start_time = std::chrono::high_resolution_clock::now();
 
-		if (assimp_object_mesh->HasTangentsAndBitangents()) {
-			glBufferSubData(GL_ARRAY_BUFFER, tangents_offset, tangents_size, static_cast<GLvoid const*>(assimp_object_mesh->mTangents));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::tangents));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::tangents), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(tangents_offset));
+			auto const assimp_object_mesh = assimp_scene->mMeshes[j];
 
-			glBufferSubData(GL_ARRAY_BUFFER, binormals_offset, binormals_size, static_cast<GLvoid const*>(assimp_object_mesh->mBitangents));
-			glEnableVertexAttribArray(static_cast<unsigned int>(bonobo::shader_bindings::binormals));
-			glVertexAttribPointer(static_cast<unsigned int>(bonobo::shader_bindings::binormals), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(binormals_offset));
-		}
+			bonobo::mesh_data object;
+			if (assimp_object_mesh->mName.length != 0)
+			{
+				object.name = std::string(assimp_object_mesh->mName.C_Str());
+			}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
-
-		auto const num_vertices_per_face = assimp_object_mesh->mFaces[0u].mNumIndices;
-		object.indices_nb = assimp_object_mesh->mNumFaces * num_vertices_per_face;
-		auto object_indices = std::make_unique<GLuint[]>(static_cast<size_t>(object.indices_nb));
-		for (size_t i = 0u; i < assimp_object_mesh->mNumFaces; ++i) {
-			auto const& face = assimp_object_mesh->mFaces[i];
-			assert(face.mNumIndices <= 3);
-			object_indices[num_vertices_per_face * i + 0u] = face.mIndices[0u];
-			if (num_vertices_per_face > 1u)
-				object_indices[num_vertices_per_face * i + 1u] = face.mIndices[1u];
-			if (num_vertices_per_face > 2u)
-				object_indices[num_vertices_per_face * i + 2u] = face.mIndices[2u];
-		}
-		glGenBuffers(1, &object.ibo);
-		assert(object.ibo != 0u);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<unsigned int>(object.indices_nb) * sizeof(GL_UNSIGNED_INT), reinterpret_cast<GLvoid const*>(object_indices.get()), GL_STATIC_DRAW);
-		object_indices.reset(nullptr);
+			std::vector<GLuint> indices;
+			appendMeshIndices(assimp_object_mesh, 0u, indices);
+
+			std::vector<std::array<std::uint8_t, skinning::max_influences_per_vertex>> joint_indices, joint_weights;
+			auto const is_skinned = has_rig && assimp_object_mesh->HasBones();
+			if (is_skinned)
+				skinning::detail::quantizeInfluences(*assimp_object_mesh, rig->skeleton, joint_indices, joint_weights);
+
+			uploadMeshData(object, static_cast<GLsizei>(assimp_object_mesh->mNumVertices),
+			               static_cast<GLvoid const*>(assimp_object_mesh->mVertices),
+			               assimp_object_mesh->HasNormals() ? static_cast<GLvoid const*>(assimp_object_mesh->mNormals) : nullptr,
+			               assimp_object_mesh->HasTextureCoords(0u) ? static_cast<GLvoid const*>(assimp_object_mesh->mTextureCoords[0u]) : nullptr,
+			               assimp_object_mesh->HasTangentsAndBitangents() ? static_cast<GLvoid const*>(assimp_object_mesh->mTangents) : nullptr,
+			               assimp_object_mesh->HasTangentsAndBitangents() ? static_cast<GLvoid const*>(assimp_object_mesh->mBitangents) : nullptr,
+			               is_skinned ? static_cast<GLvoid const*>(joint_indices.data()) : nullptr,
+			               is_skinned ? static_cast<GLvoid const*>(joint_weights.data()) : nullptr,
+			               indices);
+
+			auto const material_id = assimp_object_mesh->mMaterialIndex;
+			if (material_id < materials_bindings.size()) {
+				object.bindings = materials_bindings[material_id];
+				object.layer_bindings = materials_layer_bindings[material_id];
+				object.material = material_constants[material_id];
+			}
 
-		utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, object.vao, object.name + " VAO");
-		utils::opengl::debug::nameObject(GL_BUFFER, object.bo, object.name + " VBO");
-		utils::opengl::debug::nameObject(GL_BUFFER, object.ibo, object.name + " IBO");
+			objects.push_back(std::move(object));
 
-		glBindVertexArray(0u);
-		glBindBuffer(GL_ARRAY_BUFFER, 0u);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+			auto const mesh_end_time = std::chrono::high_resolution_clock::now();
 
-		auto const material_id = assimp_object_mesh->mMaterialIndex;
-		if (material_id < materials_bindings.size()) {
-			object.bindings = materials_bindings[material_id];
-			object.material = material_constants[material_id];
+			LogTrivia("│ %s Mesh \"%s\" loaded with attributes [%s] in %.3f ms",
+			          (assimp_scene->mNumMeshes == 1u) ? "╶" : (j == 0 ? "┌" : (j == assimp_scene->mNumMeshes - 1 ? "└" : "├")),
+			          assimp_object_mesh->mName.C_Str(),
+			          get_attributes_as_str(assimp_object_mesh->HasNormals(), assimp_object_mesh->HasTangentsAndBitangents(), assimp_object_mesh->HasTextureCoords(0)).c_str(),
+			          std::chrono::duration<float, std::milli>(mesh_end_time - mesh_start_time).count());
 		}
-
-		objects.push_back(object);
-
-		auto const mesh_end_time = std::chrono::high_resolution_clock::now();
-
-		std::string attributes = assimp_object_mesh->HasNormals() ? "normals" : "";
-		if (!attributes.empty())
-		  attributes += " | ";
-		if (assimp_object_mesh->HasTangentsAndBitangents())
-		  attributes += "tangents&bitangents";
-		if (!attributes.empty())
-		  attributes += " | ";
-		if (assimp_object_mesh->HasTextureCoords(0))
-		  attributes += "texture coordinates";
-		LogTrivia("│ %s Mesh \"%s\" loaded with attributes [%s] in %.3f ms",
-		          (assimp_scene->mNumMeshes == 1u) ? "╶" : (j == 0 ? "┌" : (j == assimp_scene->mNumMeshes - 1 ? "└" : "├")),
-		          assimp_object_mesh->mName.C_Str(), attributes.c_str(),
-		          std::chrono::duration<float, std::milli>(mesh_end_time - mesh_start_time).count());
 	}
 	auto const meshes_end_time = std::chrono::high_resolution_clock::now();
 
@@ -355,6 +797,82 @@ bonobo::loadObjects(std::string const& filename)
 	return objects;
 }
 
+static bool
+areMaterialsEqual(bonobo::material_data const& lhs, bonobo::material_data const& rhs)
+{
+	return lhs.diffuse == rhs.diffuse
+	    && lhs.specular == rhs.specular
+	    && lhs.ambient == rhs.ambient
+	    && lhs.emissive == rhs.emissive
+	    && lhs.shininess == rhs.shininess
+	    && lhs.indexOfRefraction == rhs.indexOfRefraction
+	    && lhs.opacity == rhs.opacity;
+}
+
+bonobo::draw_list
+bonobo::createDrawList(std::vector<mesh_data> const& meshes)
+{
+	draw_list list;
+	list.records.reserve(meshes.size());
+	list.names.reserve(meshes.size());
+	list.bounds.reserve(meshes.size());
+
+	for (auto const& mesh : meshes) {
+		// Meshes loaded from the same material end up with identical
+		// bindings and constants, so a linear search is enough to find
+		// them again.
+		std::size_t material_id = 0u;
+		while (material_id < list.materials.size()
+		       && !(list.material_bindings[material_id] == mesh.bindings
+		            && list.material_layer_bindings[material_id] == mesh.layer_bindings
+		            && areMaterialsEqual(list.materials[material_id], mesh.material)))
+			++material_id;
+		if (material_id == list.materials.size()) {
+			list.materials.push_back(mesh.material);
+			list.material_bindings.push_back(mesh.bindings);
+			list.material_layer_bindings.push_back(mesh.layer_bindings);
+		}
+
+		draw_record record;
+		record.vao = mesh.vao;
+		record.has_indices = mesh.ibo != 0u;
+		record.count = record.has_indices ? mesh.indices_nb : mesh.vertices_nb;
+		record.drawing_mode = mesh.drawing_mode;
+		record.material_id = static_cast<std::uint32_t>(material_id);
+		list.records.push_back(record);
+		list.names.push_back(mesh.name);
+		list.bounds.push_back(mesh.bounds);
+	}
+
+	return list;
+}
+
+bonobo::bounds_data
+bonobo::computeBounds(glm::vec3 const* positions, std::size_t positions_nb)
+{
+	bounds_data bounds;
+	if (positions_nb == 0u)
+		return bounds;
+
+	bounds.aabb_min = positions[0];
+	bounds.aabb_max = positions[0];
+	for (std::size_t i = 1u; i < positions_nb; ++i) {
+		bounds.aabb_min = glm::min(bounds.aabb_min, positions[i]);
+		bounds.aabb_max = glm::max(bounds.aabb_max, positions[i]);
+	}
+
+	bounds.sphere_centre = 0.5f * (bounds.aabb_min + bounds.aabb_max);
+	auto max_distance2 = 0.0f;
+	for (std::size_t i = 0u; i < positions_nb; ++i) {
+		auto const offset = positions[i] - bounds.sphere_centre;
+		max_distance2 = std::max(max_distance2, glm::dot(offset, offset));
+	}
+	bounds.sphere_radius = std::sqrt(max_distance2);
+	bounds.is_valid = true;
+
+	return bounds;
+}
+
 GLuint
 bonobo::createTexture(uint32_t width, uint32_t height, GLenum target, GLint internal_format, GLenum format, GLenum type, GLvoid const* data)
 {
@@ -386,18 +904,7 @@ bonobo::loadTexture2D(std::string const& filename, bool generate_mipmap)
 {
 	std::uint32_t width, height;
 	auto const data = getTextureData(filename, width, height, true);
-	if (data.empty())
-		return 0u;
-
-	GLuint texture = bonobo::createTexture(width, height, GL_TEXTURE_2D, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid const*>(data.data()));
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	if (generate_mipmap)
-		glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0u);
-
-	return texture;
+	return createTexture2DFromData(data, width, height, generate_mipmap);
 }
 
 GLuint
@@ -646,74 +1153,11 @@ namespace
 {
 	void setupBasisData()
 	{
-		glGenVertexArrays(1, &basis.vao);
-		assert(basis.vao != 0);
-		glBindVertexArray(basis.vao);
-
-		glGenBuffers(1, &basis.vbo);
-		assert(basis.vbo != 0);
-		auto const halfThickness = 0.1f;
-		std::array<glm::vec3, 13> const vertices = {
-			// Body of the arrow
-			glm::vec3(0.0f, -halfThickness, -halfThickness),
-			glm::vec3(0.0f, -halfThickness,  halfThickness),
-			glm::vec3(0.0f,  halfThickness,  halfThickness),
-			glm::vec3(0.0f,  halfThickness, -halfThickness),
-			glm::vec3(1.0f, -halfThickness, -halfThickness),
-			glm::vec3(1.0f, -halfThickness,  halfThickness),
-			glm::vec3(1.0f,  halfThickness,  halfThickness),
-			glm::vec3(1.0f,  halfThickness, -halfThickness),
-			// Tip of the arrow
-			glm::vec3(1.0f, -2.0f*halfThickness, -2.0f*halfThickness),
-			glm::vec3(1.0f, -2.0f*halfThickness,  2.0f*halfThickness),
-			glm::vec3(1.0f,  2.0f*halfThickness,  2.0f*halfThickness),
-			glm::vec3(1.0f,  2.0f*halfThickness, -2.0f*halfThickness),
-			glm::vec3(1.0f+4.0f*halfThickness,  0.0f, 0.0f),
-		};
-		glBindBuffer(GL_ARRAY_BUFFER, basis.vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices.data(), GL_STATIC_DRAW);
-
-		glEnableVertexAttribArray(0u);
-		glVertexAttribPointer(0u, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
-
-		glGenBuffers(1, &basis.ibo);
-		assert(basis.ibo != 0);
-		std::array<glm::uvec3, 16> const indices = {
-			// Body: Left
-			glm::uvec3(0u, 1u, 2u),
-			glm::uvec3(0u, 2u, 3u),
-			// Body: Back
-			glm::uvec3(4u, 0u, 3u),
-			glm::uvec3(4u, 3u, 7u),
-			// Body: Bottom
-			glm::uvec3(0u, 4u, 5u),
-			glm::uvec3(0u, 5u, 1u),
-			// Body: Front
-			glm::uvec3(1u, 5u, 6u),
-			glm::uvec3(1u, 6u, 2u),
-			// Body: Top
-			glm::uvec3(2u, 6u, 7u),
-			glm::uvec3(2u, 7u, 3u),
-			// Tip: Left
-			glm::uvec3(8u, 9u, 10u),
-			glm::uvec3(8u, 10u, 11u),
-			// Tip: Back
-			glm::uvec3(12u, 8u, 11u),
-			// Tip: Bottom
-			glm::uvec3(8u, 12u, 9u),
-			// Tip: Front
-			glm::uvec3(9u, 12u, 10u),
-			// Tip: Top
-			glm::uvec3(10u, 12u, 11u)
-		};
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, basis.ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices.data(), GL_STATIC_DRAW);
-
-		basis.index_count = static_cast<GLsizei>(indices.size() * 3);
-
-		glBindVertexArray(0u);
-		glBindBuffer(GL_ARRAY_BUFFER, 0U);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0U);
+		auto const arrow = bonobo::static_meshes::upload(basis_arrow, "Basis");
+		basis.vao = arrow.vao;
+		basis.vbo = arrow.bo;
+		basis.ibo = arrow.ibo;
+		basis.index_count = arrow.indices_nb;
 
 		basis.shader = bonobo::createProgram("common/basis.vert", "common/basis.frag");
 		if (basis.shader == 0u) {
@@ -737,9 +1181,6 @@ namespace
 		assert(shader_location >= 0);
 		basis.shader_locations.length_scale = shader_location;
 
-		utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, basis.vao, "Basis VAO");
-		utils::opengl::debug::nameObject(GL_BUFFER, basis.vbo, "Basis VBO");
-		utils::opengl::debug::nameObject(GL_BUFFER, basis.ibo, "Basis IBO");
 	}
 
 	void createDebugTexture()
@@ -6,6 +6,7 @@
 
 #include "core/FPSCamera.h" // As it includes OpenGL headers, import it after glad
 
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -14,6 +15,15 @@
 //! \brief Namespace containing a few helpers for the LUGG computer graphics labs.
 namespace bonobo
 {
+	namespace skinning
+	{
+		struct rig_data;
+	}
+	namespace texture_arrays
+	{
+		struct texture_array_set;
+	}
+
 	//! \brief Formalise mapping between an OpenGL VAO attribute binding,
 	//!        and the meaning of that attribute.
 	enum class shader_bindings : unsigned int{
@@ -21,13 +31,40 @@ namespace bonobo
 		normals,       //!< = 1, value of the binding point for normals
 		texcoords,     //!< = 2, value of the binding point for texcoords
 		tangents,      //!< = 3, value of the binding point for tangents
-		binormals      //!< = 4, value of the binding point for binormals
+		binormals,     //!< = 4, value of the binding point for binormals
+		joint_indices, //!< = 5, value of the binding point for the indices of the joints influencing a vertex
+		joint_weights, //!< = 6, value of the binding point for the weights of the joints influencing a vertex
+		instance_model_to_world = 7u,         //!< = 7 to 10, value of the binding points for the columns of the per-instance model-to-world matrix
+		instance_normal_model_to_world = 11u, //!< = 11 to 13, value of the binding points for the columns of the per-instance normal matrix
+		instance_diffuse_colour = 14u         //!< = 14, value of the binding point for the per-instance diffuse colour and opacity
 	};
 
+	//! \brief Index value used to start a new primitive, when drawing
+	//!        strips stored in a single index buffer.
+	constexpr GLuint primitive_restart_index = 0xFFFFFFFFu;
+
 	//! \brief Association of a sampler name used in GLSL to a
 	//!        corresponding texture ID.
 	using texture_bindings = std::unordered_map<std::string, GLuint>;
 
+	//! \brief Where a texture is stored in a `texture_array_set`.
+	struct texture_layer {
+		std::uint32_t array_index{0u}; //!< index of the array in the set
+		std::uint32_t layer{0u};       //!< layer within that array
+		bool is_valid{false};          //!< false when the image could not be given a layer, in which case it should not be sampled
+	};
+
+	inline bool
+	operator==(texture_layer const& lhs, texture_layer const& rhs)
+	{
+		return lhs.array_index == rhs.array_index && lhs.layer == rhs.layer
+		    && lhs.is_valid == rhs.is_valid;
+	}
+
+	//! \brief Association of a sampler name used in GLSL to the layer
+	//!        holding the corresponding texture.
+	using texture_layer_bindings = std::unordered_map<std::string, texture_layer>;
+
 	struct material_data {
 		glm::vec3 diffuse{ 0.0f };
 		glm::vec3 specular{ 0.0f };
@@ -38,6 +75,15 @@ namespace bonobo
 		float opacity{ 1.0f };
 	};
 
+	//! \brief Volumes enclosing the vertices of a mesh, in model space.
+	struct bounds_data {
+		glm::vec3 aabb_min{0.0f};                //!< lower corner of the axis-aligned bounding box
+		glm::vec3 aabb_max{0.0f};                //!< upper corner of the axis-aligned bounding box
+		glm::vec3 sphere_centre{0.0f};           //!< centre of the bounding sphere
+		float sphere_radius{0.0f};               //!< radius of the bounding sphere
+		bool is_valid{false};                    //!< false when the final positions are only known on the GPU (e.g. displaced patches), in which case the mesh should never be culled
+	};
+
 	//! \brief Contains the data for a mesh in OpenGL.
 	struct mesh_data {
 		GLuint vao{0u};                          //!< OpenGL name of the Vertex Array Object
@@ -46,11 +92,41 @@ namespace bonobo
 		GLsizei vertices_nb{0};                  //!< number of vertices stored in bo
 		GLsizei indices_nb{0};                   //!< number of indices stored in ibo
 		texture_bindings bindings{};             //!< texture bindings for this mesh
+		texture_layer_bindings layer_bindings{}; //!< texture layers for this mesh, when its textures were loaded into texture arrays instead
 		material_data material{};                //!< constant values for the material of this mesh
 		GLenum drawing_mode{GL_TRIANGLES};       //!< OpenGL drawing mode, i.e. GL_TRIANGLES, GL_LINES, etc.
+		GLint patch_vertices_nb{0};              //!< number of vertices per patch, when |drawing_mode| is GL_PATCHES
+		bool uses_primitive_restart{false};      //!< whether the indices contain |primitive_restart_index| to separate primitives
+		bool is_skinned{false};                  //!< whether the vertices have joint indices and weights
+		bounds_data bounds{};                    //!< bounds of the vertices, in their bind pose for skinned meshes
 		std::string name{"un-named mesh"};       //!< Name of the mesh; used for debugging purposes.
 	};
 
+	//! \brief Minimal description of a single draw call.
+	//!
+	//! Unlike `mesh_data`, it is trivially copyable and does not own any
+	//! string or map, so that render loops going through hundreds of them
+	//! stay within a few cache lines; everything else lives in the cold
+	//! tables of the `draw_list` it belongs to.
+	struct draw_record {
+		GLuint vao{0u};                          //!< OpenGL name of the Vertex Array Object
+		GLuint first_index{0u};                  //!< offset, in indices (or vertices if not indexed), of the first element to draw
+		GLsizei count{0};                        //!< number of indices (or vertices if not indexed) to draw
+		GLenum drawing_mode{GL_TRIANGLES};       //!< OpenGL drawing mode, i.e. GL_TRIANGLES, GL_LINES, etc.
+		std::uint32_t material_id{0u};           //!< index into the material tables of the owning `draw_list`
+		bool has_indices{true};                  //!< whether to use glDrawElements rather than glDrawArrays
+	};
+
+	//! \brief Draw records, along with the cold data they refer to.
+	struct draw_list {
+		std::vector<draw_record> records{};                //!< hot data, to be iterated over when rendering
+		std::vector<std::string> names{};                  //!< name of each record, used for debug groups
+		std::vector<material_data> materials{};            //!< material constants, indexed by `draw_record::material_id`
+		std::vector<texture_bindings> material_bindings{}; //!< texture bindings, indexed by `draw_record::material_id`
+		std::vector<texture_layer_bindings> material_layer_bindings{}; //!< texture layers, indexed by `draw_record::material_id`
+		std::vector<bounds_data> bounds{};                 //!< model-space bounds of each record, used for culling
+	};
+
 	enum class cull_mode_t : unsigned int {
 		disabled = 0u,
 		back_faces,
@@ -69,12 +145,75 @@ namespace bonobo
 	//! \brief Deallocate objects allocated by the `init()` function.
 	void deinit();
 
+	//! \brief How `loadObjects()` should process the objects it loads.
+	struct load_options {
+		bool pack_textures{false};                       //!< whether to pack the material textures, see `loadObjects()`
+		bool batch_by_material{false};                   //!< whether to merge meshes sharing a material, see `loadObjects()`
+		skinning::rig_data* rig{nullptr};                //!< where to import the skeleton and animation clips, if not null
+		texture_arrays::texture_array_set* arrays{nullptr}; //!< where to load the textures as texture arrays, if not null
+	};
+
 	//! \brief Load objects found in an object/scene file, using assimp.
 	//!
+	//! When |pack_textures| is enabled, the textures of each material are
+	//! baked into two RGBA8 textures instead of up to four:
+	//! * the diffuse colour goes in RGB and the opacity mask in A;
+	//! * the tangent-space normal's X and Y go in RG, and the specular
+	//!   intensity in B; the normal's Z has to be reconstructed as
+	//!   `sqrt(1 - dot(xy, xy))`.
+	//! Components missing from the material are filled with neutral values
+	//! (black diffuse, fully opaque, flat normal, no specular). Each packed
+	//! texture is registered in the bindings under the name of every
+	//! texture it replaces (for example both `diffuse_texture` and
+	//! `opacity_texture`), so presence checks keep working; shaders
+	//! consuming those bindings need to be aware of the new layout.
+	//!
+	//! When |batch_by_material| is enabled, the scene is considered static:
+	//! every mesh reference found in the node hierarchy has its transform
+	//! baked into its vertices, and all meshes sharing the same material
+	//! and primitive type are merged into a single `mesh_data`, so that
+	//! the number of draw calls scales with the number of materials
+	//! rather than with the number of meshes.
+	//!
+	//! When |rig| is provided, the skeleton and animation clips of the
+	//! scene are imported into it, and meshes attached to bones get their
+	//! joint indices and weights uploaded as well; see `skinning.hpp`.
+	//! Skinning data is ignored when |batch_by_material| is enabled, as
+	//! batching bakes the meshes into a static scene.
+	//!
+	//! When |arrays| is provided, the material textures are not uploaded
+	//! as separate textures, but grouped into texture arrays by size; the
+	//! meshes then get `layer_bindings` instead of `bindings`. See
+	//! `texture_arrays.hpp`.
+	//!
 	//! @param [in] filename of the object/scene file to load.
+	//! @param [in] options which of the processing described above to
+	//!             apply, and where to write the rig and texture arrays
 	//! @return a vector of filled in `mesh_data` structures, one per
-	//!         object found in the input file
-	std::vector<mesh_data> loadObjects(std::string const& filename);
+	//!         object found in the input file, or one per material and
+	//!         primitive type if |batch_by_material| is enabled
+	std::vector<mesh_data> loadObjects(std::string const& filename,
+	                                   load_options const& options = load_options());
+
+	//! \brief Split meshes into hot draw records and cold metadata.
+	//!
+	//! Meshes using the same texture bindings, texture layers and
+	//! material constants share the same material index. The meshes
+	//! still own the OpenGL objects referenced by the records, and should
+	//! be kept alive for as long as the records are used.
+	//!
+	//! @param [in] meshes the meshes to create draw records for
+	//! @return a `draw_list` with one record per mesh
+	draw_list createDrawList(std::vector<mesh_data> const& meshes);
+
+	//! \brief Compute the bounding box and sphere of some positions.
+	//!
+	//! The sphere is centred on the box, and just large enough to contain
+	//! all positions, which is tighter than the sphere around the box.
+	//!
+	//! @param [in] positions |positions_nb| tightly packed positions
+	//! @return valid bounds, unless |positions_nb| is 0
+	bounds_data computeBounds(glm::vec3 const* positions, std::size_t positions_nb);
 
 	//! \brief Creates an OpenGL texture without any content nor parameters.
 	//!
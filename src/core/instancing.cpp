@@ -0,0 +1,176 @@
+#include "instancing.hpp"
+
+#include "culling.hpp"
+#include "Log.h"
+#include "opengl.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace
+{
+	//! \brief Per-instance data, laid out as read by the vertex attributes
+	//!        set up in `createInstances()`.
+	struct gpu_instance {
+		glm::mat4 model_to_world;
+		glm::mat3 normal_model_to_world;
+		glm::vec4 diffuse_colour;
+	};
+
+	//! \brief Vertex attribute pointer, as queried from a vertex array.
+	struct attribute_pointer {
+		GLint buffer{0};
+		GLint size{4};
+		GLint type{GL_FLOAT};
+		GLint is_normalized{GL_FALSE};
+		GLint is_integer{GL_FALSE};
+		GLint stride{0};
+		GLvoid* offset{nullptr};
+	};
+
+	auto constexpr first_instance_attribute = static_cast<GLuint>(bonobo::shader_bindings::instance_model_to_world);
+
+	void
+	setInstanceAttribute(GLuint location, GLint size, std::size_t offset)
+	{
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(gpu_instance), reinterpret_cast<GLvoid const*>(offset));
+		glVertexAttribDivisor(location, 1u);
+	}
+}
+
+bonobo::instancing::instances_data
+bonobo::instancing::createInstances(mesh_data const& shape)
+{
+	instances_data instances;
+	if (shape.vao == 0u) {
+		LogError("Can not instance a mesh without a vertex array; no instances will be created.");
+		return instances;
+	}
+	if (shape.is_skinned)
+		LogWarning("Instancing skinned mesh \"%s\": all instances will share the same pose.", shape.name.c_str());
+
+	// OpenGL 4.1 has no way to share attribute bindings between vertex
+	// arrays, so the ones of the mesh are read back and set again on the
+	// new vertex array; this only happens once per set of instances.
+	std::vector<GLuint> enabled_locations;
+	std::vector<attribute_pointer> pointers;
+	glBindVertexArray(shape.vao);
+	for (GLuint location = 0u; location < first_instance_attribute; ++location) {
+		GLint is_enabled = GL_FALSE;
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &is_enabled);
+		if (is_enabled == GL_FALSE)
+			continue;
+
+		attribute_pointer pointer;
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &pointer.buffer);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &pointer.size);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_TYPE, &pointer.type);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &pointer.is_normalized);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &pointer.is_integer);
+		glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &pointer.stride);
+		glGetVertexAttribPointerv(location, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer.offset);
+		enabled_locations.push_back(location);
+		pointers.push_back(pointer);
+	}
+
+	glGenVertexArrays(1, &instances.vao);
+	assert(instances.vao != 0u);
+	glBindVertexArray(instances.vao);
+
+	for (std::size_t i = 0u; i < enabled_locations.size(); ++i) {
+		auto const location = enabled_locations[i];
+		auto const& pointer = pointers[i];
+		glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(pointer.buffer));
+		glEnableVertexAttribArray(location);
+		if (pointer.is_integer != GL_FALSE)
+			glVertexAttribIPointer(location, pointer.size, static_cast<GLenum>(pointer.type), pointer.stride, pointer.offset);
+		else
+			glVertexAttribPointer(location, pointer.size, static_cast<GLenum>(pointer.type), static_cast<GLboolean>(pointer.is_normalized), pointer.stride, pointer.offset);
+	}
+	if (shape.ibo != 0u)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shape.ibo);
+
+	glGenBuffers(1, &instances.instances_bo);
+	assert(instances.instances_bo != 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, instances.instances_bo);
+
+	// Matrices take one attribute location per column.
+	auto const model_to_world_location = static_cast<GLuint>(shader_bindings::instance_model_to_world);
+	for (GLuint column = 0u; column < 4u; ++column)
+		setInstanceAttribute(model_to_world_location + column, 4, offsetof(gpu_instance, model_to_world) + column * sizeof(glm::vec4));
+	auto const normal_model_to_world_location = static_cast<GLuint>(shader_bindings::instance_normal_model_to_world);
+	for (GLuint column = 0u; column < 3u; ++column)
+		setInstanceAttribute(normal_model_to_world_location + column, 3, offsetof(gpu_instance, normal_model_to_world) + column * sizeof(glm::vec3));
+	setInstanceAttribute(static_cast<GLuint>(shader_bindings::instance_diffuse_colour), 4, offsetof(gpu_instance, diffuse_colour));
+
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+	if (shape.ibo != 0u)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+
+	utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, instances.vao, shape.name + " instances VAO");
+	utils::opengl::debug::nameObject(GL_BUFFER, instances.instances_bo, shape.name + " instances");
+
+	instances.mesh_bounds = shape.bounds;
+
+	return instances;
+}
+
+void
+bonobo::instancing::destroyInstances(instances_data& instances)
+{
+	glDeleteBuffers(1, &instances.instances_bo);
+	glDeleteVertexArrays(1, &instances.vao);
+	instances = instances_data();
+}
+
+void
+bonobo::instancing::updateInstances(instances_data& instances, std::vector<instance> const& data)
+{
+	if (instances.instances_bo == 0u) {
+		LogError("The instances were not created using createInstances(); they will not be updated.");
+		return;
+	}
+
+	std::vector<gpu_instance> gpu_data;
+	gpu_data.reserve(data.size());
+	for (auto const& source : data) {
+		gpu_instance converted;
+		converted.model_to_world = source.model_to_world;
+		converted.normal_model_to_world = glm::transpose(glm::inverse(glm::mat3(source.model_to_world)));
+		converted.diffuse_colour = glm::vec4(source.diffuse_colour, source.opacity);
+		gpu_data.push_back(converted);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances.instances_bo);
+	if (gpu_data.size() > instances.capacity) {
+		// Leave some room to grow, to avoid reallocating every frame when
+		// instances keep getting added.
+		instances.capacity = std::max(gpu_data.size(), 2u * instances.capacity);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(instances.capacity * sizeof(gpu_instance)), nullptr, GL_STREAM_DRAW);
+	}
+	if (!gpu_data.empty())
+		glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(gpu_data.size() * sizeof(gpu_instance)), static_cast<GLvoid const*>(gpu_data.data()));
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+	instances.instances_nb = gpu_data.size();
+
+	// The instances are culled as a whole, by the box enclosing all of
+	// them, and a sphere around that box.
+	instances.bounds = bounds_data();
+	if (!instances.mesh_bounds.is_valid || data.empty())
+		return;
+	auto const first_bounds = culling::transformBounds(instances.mesh_bounds, data.front().model_to_world);
+	instances.bounds.aabb_min = first_bounds.aabb_min;
+	instances.bounds.aabb_max = first_bounds.aabb_max;
+	for (auto const& source : data) {
+		auto const instance_bounds = culling::transformBounds(instances.mesh_bounds, source.model_to_world);
+		instances.bounds.aabb_min = glm::min(instances.bounds.aabb_min, instance_bounds.aabb_min);
+		instances.bounds.aabb_max = glm::max(instances.bounds.aabb_max, instance_bounds.aabb_max);
+	}
+	instances.bounds.sphere_centre = 0.5f * (instances.bounds.aabb_min + instances.bounds.aabb_max);
+	instances.bounds.sphere_radius = 0.5f * glm::length(instances.bounds.aabb_max - instances.bounds.aabb_min);
+	instances.bounds.is_valid = true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+//! \brief Many copies of the same mesh, each with its own transform and
+//!        colour, drawn by a single instanced draw call.
+//!
+//! The per-instance data lives in a buffer read through vertex attributes
+//! with a divisor of 1, at the `shader_bindings::instance_*` locations;
+//! vertex shaders read them as:
+//!
+//!     layout (location = 7)  in mat4 instance_model_to_world;
+//!     layout (location = 11) in mat3 instance_normal_model_to_world;
+//!     layout (location = 14) in vec4 instance_diffuse_colour;
+//!
+//! and apply them before the usual `vertex_model_to_world` and
+//! `normal_model_to_world` uniforms, as done in
+//! `EDAF80/diffuse_instanced.vert`.
+namespace bonobo
+{
+namespace instancing
+{
+	//! \brief Placement and material parameters of one instance.
+	struct instance {
+		glm::mat4 model_to_world{1.0f};    //!< relative to the node drawing the instances
+		glm::vec3 diffuse_colour{1.0f};
+		float opacity{1.0f};
+	};
+
+	//! \brief Instances of a mesh, uploaded to OpenGL and ready to be
+	//!        drawn by a `Node`.
+	struct instances_data {
+		GLuint vao{0u};               //!< OpenGL name of a Vertex Array Object with the attributes of the mesh and of the instances
+		GLuint instances_bo{0u};      //!< OpenGL name of the Buffer Object holding the instances
+		std::size_t capacity{0u};     //!< number of instances that fit in |instances_bo|
+		std::size_t instances_nb{0u}; //!< number of instances to draw
+		bounds_data mesh_bounds{};    //!< bounds of a single instance of the mesh, in model space
+		bounds_data bounds{};         //!< bounds enclosing all instances
+	};
+
+	//! \brief Create an empty set of instances of |shape|.
+	//!
+	//! The vertex array of |shape| is left untouched; a new one reading
+	//! from the same buffers is created instead, so that |shape| can
+	//! still be drawn on its own.
+	instances_data createInstances(mesh_data const& shape);
+
+	//! \brief Release the OpenGL objects of a set of instances, but not
+	//!        the ones of the mesh they were created from.
+	void destroyInstances(instances_data& instances);
+
+	//! \brief Replace all instances.
+	//!
+	//! Normal matrices are computed here, once per instance. The buffer
+	//! only gets reallocated when it is too small, so this can be done
+	//! every frame.
+	void updateInstances(instances_data& instances, std::vector<instance> const& data);
+}
+}
@@ -0,0 +1,98 @@
+#include "materials.hpp"
+
+#include "Log.h"
+#include "opengl.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+static_assert(sizeof(bonobo::materials::gpu_material) == 96u,
+              "gpu_material should match the std140 layout of the Material structure.");
+
+bonobo::materials::gpu_material
+bonobo::materials::makeMaterial(material_data const& constants,
+                                texture_bindings const& bindings,
+                                texture_layer_bindings const& layer_bindings)
+{
+	gpu_material material;
+	material.diffuse_opacity = glm::vec4(constants.diffuse, constants.opacity);
+	material.specular_shininess = glm::vec4(constants.specular, constants.shininess);
+	material.ambient_index_of_refraction = glm::vec4(constants.ambient, constants.indexOfRefraction);
+	material.emissive = glm::vec4(constants.emissive, 0.0f);
+
+	char const* const names[] = { "diffuse_texture", "specular_texture", "normals_texture", "opacity_texture" };
+	std::uint32_t const flags[] = { has_diffuse_texture, has_specular_texture, has_normals_texture, has_opacity_texture };
+	for (int i = 0; i < 4; ++i) {
+		if (bindings.find(names[i]) != bindings.end())
+			material.texture_flags |= flags[i];
+
+		auto const layer = layer_bindings.find(names[i]);
+		if (layer == layer_bindings.end() || !layer->second.is_valid)
+			continue;
+		material.texture_flags |= flags[i];
+		material.texture_layers[i] = (layer->second.array_index << 16u) | layer->second.layer;
+	}
+
+	return material;
+}
+
+bonobo::materials::material_buffer
+bonobo::materials::createMaterialBuffer()
+{
+	material_buffer materials;
+
+	glGenBuffers(1, &materials.ubo);
+	assert(materials.ubo != 0u);
+	glBindBuffer(GL_UNIFORM_BUFFER, materials.ubo);
+	glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(max_materials_nb * sizeof(gpu_material)), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+	glBindBufferBase(GL_UNIFORM_BUFFER, uniform_block_binding, materials.ubo);
+
+	utils::opengl::debug::nameObject(GL_BUFFER, materials.ubo, "Materials");
+
+	return materials;
+}
+
+void
+bonobo::materials::destroyMaterialBuffer(material_buffer& materials)
+{
+	glDeleteBuffers(1, &materials.ubo);
+	materials = material_buffer();
+}
+
+void
+bonobo::materials::updateMaterialBuffer(material_buffer& materials, std::vector<gpu_material> const& data)
+{
+	if (materials.ubo == 0u) {
+		LogError("The material buffer was not created using createMaterialBuffer(); it will not be updated.");
+		return;
+	}
+	if (data.size() > max_materials_nb)
+		LogError("%zu materials were given, but only %zu fit in the buffer; the remaining ones will be **ignored**.",
+		         data.size(), max_materials_nb);
+
+	materials.materials_nb = std::min(data.size(), max_materials_nb);
+	if (materials.materials_nb == 0u)
+		return;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, materials.ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, static_cast<GLsizeiptr>(materials.materials_nb * sizeof(gpu_material)), static_cast<GLvoid const*>(data.data()));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+}
+
+void
+bonobo::materials::bindMaterialBuffer(material_buffer const& materials)
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, uniform_block_binding, materials.ubo);
+}
+
+bool
+bonobo::materials::bindUniformBlock(GLuint program)
+{
+	auto const block_index = glGetUniformBlockIndex(program, "Materials");
+	if (block_index == GL_INVALID_INDEX)
+		return false;
+
+	glUniformBlockBinding(program, block_index, uniform_block_binding);
+	return true;
+}
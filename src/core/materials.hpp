@@ -0,0 +1,105 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Material constants of a whole scene, uploaded once to a
+//!        uniform buffer so that each draw only has to select one of
+//!        them by index.
+//!
+//! Shaders declare the buffer using the std140 layout, with
+//! |max_materials_nb| entries:
+//!
+//!     struct Material {
+//!         vec4 diffuse_opacity;
+//!         vec4 specular_shininess;
+//!         vec4 ambient_index_of_refraction;
+//!         vec4 emissive;
+//!         uvec4 texture_flags; // x: bitwise or of bonobo::materials::texture_flag
+//!         uvec4 texture_layers; // diffuse, specular, normals and opacity layers, see texture_arrays.hpp
+//!     };
+//!     layout (std140) uniform Materials {
+//!         Material materials[128];
+//!     };
+//!     uniform int material_index;
+namespace bonobo
+{
+namespace materials
+{
+	//! Materials take 96 bytes each, and uniform blocks are only
+	//! guaranteed to hold 16 KiB.
+	constexpr std::size_t max_materials_nb = 128u;
+
+	//! Binding point the buffer is bound to, and that programs get their
+	//! `Materials` block assigned to; it is kept clear of the few
+	//! bindings used by the assignments themselves.
+	constexpr GLuint uniform_block_binding = 8u;
+
+	//! \brief Textures a material comes with.
+	enum texture_flag : std::uint32_t {
+		has_diffuse_texture  = 1u << 0u,
+		has_specular_texture = 1u << 1u,
+		has_normals_texture  = 1u << 2u,
+		has_opacity_texture  = 1u << 3u
+	};
+
+	//! \brief One material, laid out as the `Material` structure above.
+	struct gpu_material {
+		glm::vec4 diffuse_opacity{0.0f, 0.0f, 0.0f, 1.0f};
+		glm::vec4 specular_shininess{0.0f};
+		glm::vec4 ambient_index_of_refraction{0.0f, 0.0f, 0.0f, 1.0f};
+		glm::vec4 emissive{0.0f};
+		std::uint32_t texture_flags{0u};
+		std::uint32_t padding[3]{};
+		glm::uvec4 texture_layers{0u};  //!< diffuse, specular, normals and opacity layers, each packed as `(array_index << 16) | layer`
+	};
+
+	//! \brief Pack |constants|, with flags for the textures found in
+	//!        |bindings| or |layer_bindings| under their usual names
+	//!        (`diffuse_texture`, `specular_texture`, `normals_texture` and
+	//!        `opacity_texture`), and the layers of those found in
+	//!        |layer_bindings|.
+	gpu_material makeMaterial(material_data const& constants,
+	                          texture_bindings const& bindings = texture_bindings(),
+	                          texture_layer_bindings const& layer_bindings = texture_layer_bindings());
+
+	//! \brief Uniform buffer holding up to |max_materials_nb| materials.
+	struct material_buffer {
+		GLuint ubo{0u};                //!< OpenGL name of the Buffer Object
+		std::size_t materials_nb{0u};  //!< number of materials uploaded
+	};
+
+	//! \brief Create an empty buffer, and bind it to
+	//!        |uniform_block_binding|.
+	//!
+	//! The whole block gets allocated right away, as OpenGL requires the
+	//! bound range to cover it even when fewer materials are used.
+	material_buffer createMaterialBuffer();
+
+	//! \brief Release the OpenGL objects of a buffer.
+	void destroyMaterialBuffer(material_buffer& materials);
+
+	//! \brief Replace all materials of a buffer.
+	//!
+	//! Materials past |max_materials_nb| are dropped, with an error.
+	void updateMaterialBuffer(material_buffer& materials, std::vector<gpu_material> const& data);
+
+	//! \brief Bind |materials| to |uniform_block_binding|, when switching
+	//!        between several buffers.
+	void bindMaterialBuffer(material_buffer const& materials);
+
+	//! \brief Assign the `Materials` block of |program|, if any, to
+	//!        |uniform_block_binding|.
+	//!
+	//! This has to be done again whenever |program| gets linked again.
+	//!
+	//! @return whether |program| has a `Materials` block
+	bool bindUniformBlock(GLuint program);
+}
+}
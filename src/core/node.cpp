@@ -1,5 +1,6 @@
 #include "node.hpp"
 #include "helpers.hpp"
+#include "texture_arrays.hpp"
 
 #include "core/Log.h"
 #include "core/opengl.hpp"
@@ -7,67 +8,198 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <initializer_list>
+#include <utility>
+
+namespace
+{
+	//! Inverse transpose of the upper 3×3 part of |world|, from its
+	//! cofactors: cheaper than a general 4×4 inverse, and the translation
+	//! does not matter for normals anyway.
+	glm::mat4
+	computeNormalMatrix(glm::mat4 const& world)
+	{
+		auto const x = glm::vec3(world[0]);
+		auto const y = glm::vec3(world[1]);
+		auto const z = glm::vec3(world[2]);
+		auto const cofactor_x = glm::cross(y, z);
+		auto const cofactor_y = glm::cross(z, x);
+		auto const cofactor_z = glm::cross(x, y);
+		auto const inverse_determinant = 1.0f / glm::dot(x, cofactor_x);
+		return glm::mat4(glm::vec4(cofactor_x * inverse_determinant, 0.0f),
+		                 glm::vec4(cofactor_y * inverse_determinant, 0.0f),
+		                 glm::vec4(cofactor_z * inverse_determinant, 0.0f),
+		                 glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+}
+
 void
 Node::render(glm::mat4 const& view_projection, glm::mat4 const& parent_transform) const
 {
 	if (_program != nullptr)
-		render(view_projection, parent_transform * _transform.GetMatrix(), *_program, _set_uniforms);
+		render(view_projection, get_world_matrix(parent_transform), *_program, _set_uniforms);
 }
 
 void
 Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, GLuint program, std::function<void (GLuint)> const& set_uniforms) const
 {
-	if (_vao == 0u || program == 0u)
+	render_state state;
+	render(view_projection, world, program, set_uniforms, state);
+	end_render(state);
+}
+
+void
+Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, render_state& state) const
+{
+	if (_program != nullptr)
+		render(view_projection, world, *_program, _set_uniforms, state);
+}
+
+void
+Node::render(glm::mat4 const& view_projection, glm::mat4 const& world, GLuint program, std::function<void (GLuint)> const& set_uniforms, render_state& state) const
+{
+	auto const vao = get_vao();
+	if (vao == 0u || program == 0u)
+		return;
+	if (_instances != nullptr && _instances->instances_nb == 0u)
 		return;
 
 	utils::opengl::debug::beginDebugGroup(_name);
 
-	glUseProgram(program);
+	if (program != state.program) {
+		// The presence uniforms belong to the previous program, so they
+		// have to be reset before switching away from it.
+		release_textures(state);
+		glUseProgram(program);
+		state.program = program;
+	}
+	update_uniform_locations(program);
 
-	auto const normal_model_to_world = glm::transpose(glm::inverse(world));
+	if (!_matrices.has_normal || world != _matrices.normal_source) {
+		_matrices.normal_source = world;
+		_matrices.normal = computeNormalMatrix(world);
+		_matrices.has_normal = true;
+	}
+	auto const& normal_model_to_world = _matrices.normal;
 
 	set_uniforms(program);
 
-	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_model_to_world"), 1, GL_FALSE, glm::value_ptr(world));
-	glUniformMatrix4fv(glGetUniformLocation(program, "normal_model_to_world"), 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
-	glUniformMatrix4fv(glGetUniformLocation(program, "vertex_world_to_clip"), 1, GL_FALSE, glm::value_ptr(view_projection));
-
-	for (size_t i = 0u; i < _textures.size(); ++i) {
-		auto const& texture = _textures[i];
-		glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
-		glBindTexture(std::get<2>(texture), std::get<1>(texture));
-		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), static_cast<GLint>(i));
+	glUniformMatrix4fv(_locations.vertex_model_to_world, 1, GL_FALSE, glm::value_ptr(world));
+	glUniformMatrix4fv(_locations.normal_model_to_world, 1, GL_FALSE, glm::value_ptr(normal_model_to_world));
+	glUniformMatrix4fv(_locations.vertex_world_to_clip, 1, GL_FALSE, glm::value_ptr(view_projection));
+
+	if (state.textures_owner == nullptr || !has_same_textures(*state.textures_owner)) {
+		release_textures(state);
+		for (size_t i = 0u; i < _textures.size(); ++i) {
+			auto const& texture = _textures[i];
+			glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+			glBindTexture(texture.type, texture.id);
+			glUniform1i(texture.location, static_cast<GLint>(i));
+			glUniform1i(texture.presence_location, 1);
+		}
+	}
+	state.textures_owner = this;
+
+	if (_material_index >= 0 && _locations.has_materials_block) {
+		glUniform1i(_locations.material_index, _material_index);
+	} else {
+		glUniform3fv(_locations.diffuse_colour, 1, glm::value_ptr(_constants.diffuse));
+		glUniform3fv(_locations.specular_colour, 1, glm::value_ptr(_constants.specular));
+		glUniform3fv(_locations.ambient_colour, 1, glm::value_ptr(_constants.ambient));
+		glUniform3fv(_locations.emissive_colour, 1, glm::value_ptr(_constants.emissive));
+		glUniform1f(_locations.shininess_value, _constants.shininess);
+		glUniform1f(_locations.index_of_refraction_value, _constants.indexOfRefraction);
+		glUniform1f(_locations.opacity_value, _constants.opacity);
+		glUniform1ui(_locations.texture_flags, _layered_texture_flags);
+		glUniform4uiv(_locations.texture_layers, 1, glm::value_ptr(_texture_layers));
+	}
 
-		std::string texture_presence_var_name = "has_" + std::get<0>(texture);
-		glUniform1i(glGetUniformLocation(program, texture_presence_var_name.c_str()), 1);
+	if (_drawing_mode == GL_PATCHES && _patch_vertices_nb != state.patch_vertices_nb) {
+		glPatchParameteri(GL_PATCH_VERTICES, _patch_vertices_nb);
+		state.patch_vertices_nb = _patch_vertices_nb;
 	}
 
-	glUniform3fv(glGetUniformLocation(program, "diffuse_colour"), 1, glm::value_ptr(_constants.diffuse));
-	glUniform3fv(glGetUniformLocation(program, "specular_colour"), 1, glm::value_ptr(_constants.specular));
-	glUniform3fv(glGetUniformLocation(program, "ambient_colour"), 1, glm::value_ptr(_constants.ambient));
-	glUniform3fv(glGetUniformLocation(program, "emissive_colour"), 1, glm::value_ptr(_constants.emissive));
-	glUniform1f(glGetUniformLocation(program, "shininess_value"), _constants.shininess);
-	glUniform1f(glGetUniformLocation(program, "index_of_refraction_value"), _constants.indexOfRefraction);
-	glUniform1f(glGetUniformLocation(program, "opacity_value"), _constants.opacity);
+	if (_uses_primitive_restart != state.uses_primitive_restart) {
+		if (_uses_primitive_restart) {
+			glEnable(GL_PRIMITIVE_RESTART);
+			glPrimitiveRestartIndex(bonobo::primitive_restart_index);
+		} else {
+			glDisable(GL_PRIMITIVE_RESTART);
+		}
+		state.uses_primitive_restart = _uses_primitive_restart;
+	}
 
-	glBindVertexArray(_vao);
-	if (_has_indices)
+	if (vao != state.vao) {
+		glBindVertexArray(vao);
+		state.vao = vao;
+	}
+	if (_instances != nullptr) {
+		auto const instances_nb = static_cast<GLsizei>(_instances->instances_nb);
+		if (_has_indices)
+			glDrawElementsInstanced(_drawing_mode, _indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0), instances_nb);
+		else
+			glDrawArraysInstanced(_drawing_mode, 0, _vertices_nb, instances_nb);
+	} else if (_has_indices) {
 		glDrawElements(_drawing_mode, _indices_nb, GL_UNSIGNED_INT, reinterpret_cast<GLvoid const*>(0x0));
-	else
+	} else {
 		glDrawArrays(_drawing_mode, 0, _vertices_nb);
-	glBindVertexArray(0u);
+	}
 
-	for (auto const& texture : _textures) {
-		glBindTexture(std::get<2>(texture), 0);
-		glUniform1i(glGetUniformLocation(program, std::get<0>(texture).c_str()), 0);
+	utils::opengl::debug::endDebugGroup();
+}
 
-		std::string texture_presence_var_name = "has_" + std::get<0>(texture);
-		glUniform1i(glGetUniformLocation(program, texture_presence_var_name.c_str()), 0);
+void
+Node::end_render(render_state& state)
+{
+	if (state.vao != 0u)
+		glBindVertexArray(0u);
+
+	if (state.uses_primitive_restart)
+		glDisable(GL_PRIMITIVE_RESTART);
+
+	if (state.textures_owner != nullptr) {
+		auto const& textures = state.textures_owner->_textures;
+		for (size_t i = 0u; i < textures.size(); ++i) {
+			glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+			glBindTexture(textures[i].type, 0);
+			glUniform1i(textures[i].location, 0);
+		}
+		glActiveTexture(GL_TEXTURE0);
 	}
+	release_textures(state);
 
-	glUseProgram(0u);
+	if (state.program != 0u)
+		glUseProgram(0u);
 
-	utils::opengl::debug::endDebugGroup();
+	state = render_state();
+}
+
+bool
+Node::has_same_textures(Node const& other) const
+{
+	if (&other == this)
+		return true;
+	if (other._textures_key != _textures_key || other._textures.size() != _textures.size())
+		return false;
+
+	for (size_t i = 0u; i < _textures.size(); ++i) {
+		auto const& texture = _textures[i];
+		auto const& other_texture = other._textures[i];
+		if (texture.id != other_texture.id || texture.type != other_texture.type || texture.name != other_texture.name)
+			return false;
+	}
+	return true;
+}
+
+void
+Node::release_textures(render_state& state)
+{
+	if (state.textures_owner == nullptr)
+		return;
+
+	for (auto const& texture : state.textures_owner->_textures)
+		glUniform1i(texture.presence_location, 0);
+	state.textures_owner = nullptr;
 }
 
 void
@@ -77,15 +209,40 @@ Node::set_geometry(bonobo::mesh_data const& shape)
 	_vertices_nb = static_cast<GLsizei>(shape.vertices_nb);
 	_indices_nb = static_cast<GLsizei>(shape.indices_nb);
 	_drawing_mode = shape.drawing_mode;
+	_patch_vertices_nb = shape.patch_vertices_nb;
+	_uses_primitive_restart = shape.uses_primitive_restart;
 	_has_indices = shape.ibo != 0u;
+	_bounds = shape.bounds;
 	_name = std::string("Render ") + shape.name;
 
 	if (!shape.bindings.empty()) {
+		_textures.reserve(_textures.size() + shape.bindings.size());
 		for (auto const& binding : shape.bindings)
 			add_texture(binding.first, binding.second, GL_TEXTURE_2D);
 	}
 
+	// Only the layers are of interest here; the other textures were
+	// added above.
+	auto const layered = bonobo::materials::makeMaterial(bonobo::material_data(), bonobo::texture_bindings(), shape.layer_bindings);
+	_layered_texture_flags = layered.texture_flags;
+	_texture_layers = layered.texture_layers;
+
 	_constants = shape.material;
+	_shared_geometry.reset();
+}
+
+void
+Node::set_geometry(std::shared_ptr<bonobo::mesh_data const> const& shape)
+{
+	assert(shape != nullptr);
+	set_geometry(*shape);
+	_shared_geometry = shape;
+}
+
+void
+Node::set_instances(bonobo::instancing::instances_data const* instances)
+{
+	_instances = instances;
 }
 
 void
@@ -94,6 +251,12 @@ Node::set_material_constants(bonobo::material_data const& constants)
 	_constants = constants;
 }
 
+void
+Node::set_material_index(std::int32_t index)
+{
+	_material_index = index;
+}
+
 void
 Node::set_program(GLuint const* const program, std::function<void (GLuint)> const& set_uniforms)
 {
@@ -104,6 +267,9 @@ Node::set_program(GLuint const* const program, std::function<void (GLuint)> cons
 
 	_program = program;
 	_set_uniforms = set_uniforms;
+
+	if (*_program != 0u)
+		update_uniform_locations(*_program);
 }
 
 void
@@ -112,6 +278,30 @@ Node::set_name(std::string const& name)
 	_name = std::string("Render ") + name;
 }
 
+GLuint
+Node::get_program() const
+{
+	return _program != nullptr ? *_program : 0u;
+}
+
+GLuint
+Node::get_vao() const
+{
+	return _instances != nullptr ? _instances->vao : _vao;
+}
+
+std::uint32_t
+Node::get_textures_key() const
+{
+	return _textures_key;
+}
+
+bonobo::bounds_data const&
+Node::get_bounds() const
+{
+	return _instances != nullptr ? _instances->bounds : _bounds;
+}
+
 size_t
 Node::get_indices_nb() const
 {
@@ -144,7 +334,34 @@ Node::add_texture(std::string const& name, GLuint tex_id, GLenum type)
 		return;
 	}
 
-	_textures.emplace_back(name, tex_id, type);
+	texture_binding texture;
+	texture.name = name;
+	texture.presence_name = "has_" + name;
+	texture.id = tex_id;
+	texture.type = type;
+	if (_locations_program != 0u) {
+		texture.location = glGetUniformLocation(_locations_program, texture.name.c_str());
+		texture.presence_location = glGetUniformLocation(_locations_program, texture.presence_name.c_str());
+	}
+	_textures.push_back(std::move(texture));
+
+	// FNV-1a over the texture IDs, types and names, so that it only changes
+	// when the bindings do.
+	for (auto const value : { static_cast<std::uint32_t>(tex_id), static_cast<std::uint32_t>(type) }) {
+		_textures_key ^= value;
+		_textures_key *= 16777619u;
+	}
+	for (auto const c : name) {
+		_textures_key ^= static_cast<std::uint8_t>(c);
+		_textures_key *= 16777619u;
+	}
+}
+
+void
+Node::add_texture_arrays(bonobo::texture_arrays::texture_array_set const& set)
+{
+	for (std::size_t i = 0u; i < set.arrays.size(); ++i)
+		add_texture("texture_arrays[" + std::to_string(i) + "]", set.arrays[i].texture, GL_TEXTURE_2D_ARRAY);
 }
 
 void
@@ -171,6 +388,37 @@ Node::get_child(size_t index) const
 	return _children[index];
 }
 
+void
+Node::update_uniform_locations(GLuint program) const
+{
+	auto const link_count = utils::opengl::shader::get_link_count();
+	if (program == _locations_program && link_count == _locations_link_count)
+		return;
+
+	_locations_program = program;
+	_locations_link_count = link_count;
+
+	_locations.vertex_model_to_world = glGetUniformLocation(program, "vertex_model_to_world");
+	_locations.normal_model_to_world = glGetUniformLocation(program, "normal_model_to_world");
+	_locations.vertex_world_to_clip = glGetUniformLocation(program, "vertex_world_to_clip");
+	_locations.diffuse_colour = glGetUniformLocation(program, "diffuse_colour");
+	_locations.specular_colour = glGetUniformLocation(program, "specular_colour");
+	_locations.ambient_colour = glGetUniformLocation(program, "ambient_colour");
+	_locations.emissive_colour = glGetUniformLocation(program, "emissive_colour");
+	_locations.shininess_value = glGetUniformLocation(program, "shininess_value");
+	_locations.index_of_refraction_value = glGetUniformLocation(program, "index_of_refraction_value");
+	_locations.opacity_value = glGetUniformLocation(program, "opacity_value");
+	_locations.material_index = glGetUniformLocation(program, "material_index");
+	_locations.texture_flags = glGetUniformLocation(program, "texture_flags");
+	_locations.texture_layers = glGetUniformLocation(program, "texture_layers");
+	_locations.has_materials_block = bonobo::materials::bindUniformBlock(program);
+
+	for (auto& texture : _textures) {
+		texture.location = glGetUniformLocation(program, texture.name.c_str());
+		texture.presence_location = glGetUniformLocation(program, texture.presence_name.c_str());
+	}
+}
+
 TRSTransformf const&
 Node::get_transform() const
 {
@@ -182,3 +430,17 @@ Node::get_transform()
 {
 	return _transform;
 }
+
+glm::mat4 const&
+Node::get_world_matrix(glm::mat4 const& parent_transform) const
+{
+	if (!_matrices.has_world
+	    || _transform.GetRevision() != _matrices.transform_revision
+	    || parent_transform != _matrices.parent_transform) {
+		_matrices.parent_transform = parent_transform;
+		_matrices.transform_revision = _transform.GetRevision();
+		_matrices.world = parent_transform * _transform.GetMatrix();
+		_matrices.has_world = true;
+	}
+	return _matrices.world;
+}
@@ -1,15 +1,18 @@
 #pragma once
 
 #include "helpers.hpp"
+#include "instancing.hpp"
+#include "materials.hpp"
 #include "TRSTransform.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
-#include <tuple>
 #include <vector>
 
 //! \brief Represents a node of a scene graph
@@ -37,10 +40,50 @@ public:
 	//! @param [in] set_uniforms function that will take as argument an
 	//!             OpenGL shader program, and will setup that program's
 	//!             uniforms
+	//!
+	//! The locations of the uniforms set by this node are looked up when
+	//! |program| differs from the one of the previous call, or was linked
+	//! again since; otherwise, rendering does not query nor allocate
+	//! anything.
 	void render(glm::mat4 const& view_projection, glm::mat4 const& world,
 	            GLuint program,
 	            std::function<void (GLuint)> const& set_uniforms = [](GLuint /*programID*/){}) const;
 
+	//! \brief OpenGL state left bound by previous renders.
+	//!
+	//! Rendering with a state only changes what differs from the previous
+	//! node rendered with that same state, and leaves everything bound
+	//! afterwards; `end_render()` has to be called once done.
+	struct render_state {
+		GLuint program{0u};
+		GLuint vao{0u};
+		Node const* textures_owner{nullptr}; //!< node whose textures are bound
+		bool uses_primitive_restart{false};
+		GLint patch_vertices_nb{0};
+	};
+
+	//! \brief Render this node with its own program, reusing the
+	//!        bindings of |state|.
+	//!
+	//! @param [in] view_projection Matrix transforming from world-space to clip-space
+	//! @param [in] world Matrix transforming from model-space to
+	//!             world-space; the internal transform of this node is
+	//!             **not** applied on top of it
+	//! @param [in,out] state bindings left by the previous render, and
+	//!                 updated with the ones of this node
+	void render(glm::mat4 const& view_projection, glm::mat4 const& world,
+	            render_state& state) const;
+
+	//! \brief Render this node with a specific shader program, reusing
+	//!        the bindings of |state|.
+	void render(glm::mat4 const& view_projection, glm::mat4 const& world,
+	            GLuint program, std::function<void (GLuint)> const& set_uniforms,
+	            render_state& state) const;
+
+	//! \brief Unbind everything left bound by renders using |state|,
+	//!        and reset it.
+	static void end_render(render_state& state);
+
 	//! \brief Set the geometry of this node.
 	//!
 	//! It will overwrite any constants provided by an earlier call to
@@ -49,9 +92,43 @@ public:
 	//! A node without any geometry will not render itself, but its
 	//! children will be rendered if they have any geometry.
 	//!
+	//! The textures in the `bindings` of |shape| get added to the node,
+	//! and its `layer_bindings` become the layers the node samples from
+	//! the arrays given to |add_texture_arrays()|.
+	//!
+	//! The node only copies the names of the OpenGL objects of |shape|,
+	//! so those have to outlive it; see the overload below for shared
+	//! meshes.
+	//!
 	//! @param [in] shape OpenGL data to use as geometry
 	void set_geometry(bonobo::mesh_data const& shape);
 
+	//! \brief Set the geometry of this node, and keep it alive for as
+	//!        long as the node uses it.
+	//!
+	//! Meant for meshes whose OpenGL objects are released along with
+	//! their last reference, such as the ones returned by the
+	//! `parametric_shapes::get*()` functions.
+	//!
+	//! @param [in] shape OpenGL data to use as geometry; should not be
+	//!             null
+	void set_geometry(std::shared_ptr<bonobo::mesh_data const> const& shape);
+
+	//! \brief Render many instances of the geometry at once, instead of
+	//!        the geometry on its own.
+	//!
+	//! All instances share the program, textures and uniforms of this
+	//! node, and are drawn by a single instanced draw call; the transform
+	//! of each instance is applied before the one of this node. The
+	//! program has to read the per-instance attributes, as described in
+	//! `bonobo::instancing`.
+	//!
+	//! @param [in] instances instances created from the same geometry as
+	//!             given to |set_geometry()|, and kept alive, and updated,
+	//!             by the caller; null to go back to rendering the
+	//!             geometry on its own
+	void set_instances(bonobo::instancing::instances_data const* instances);
+
 	//! \brief Set the material constants of this node.
 	//!
 	//! It will overwrite any constants provided by the geometry.
@@ -62,6 +139,17 @@ public:
 	//! @param [in] constants Material constants to be made available during rendering
 	void set_material_constants(bonobo::material_data const& constants);
 
+	//! \brief Select the material of this node from the uniform buffer
+	//!        bound to `bonobo::materials::uniform_block_binding`.
+	//!
+	//! Programs with a `Materials` block then only get the
+	//! `material_index` uniform set, instead of one uniform per material
+	//! constant; other programs keep receiving the constants.
+	//!
+	//! @param [in] index index of the material in the buffer, or -1 to
+	//!             always use the constants
+	void set_material_index(std::int32_t index);
+
 	//! \brief Get the number of indices to use.
 	//!
 	//! @return how many indices to use when rendering
@@ -72,6 +160,29 @@ public:
 	//! @param [in] indices_nb how many indices to use when rendering
 	void set_indices_nb(size_t const& indices_nb);
 
+	//! \brief Get the program of this node.
+	//!
+	//! @return the OpenGL name of the program, or 0 if none was set
+	GLuint get_program() const;
+
+	//! \brief Get the vertex array of this node.
+	//!
+	//! @return the OpenGL name of the vertex array, the one of the
+	//!         instances if any, or 0 if there is no geometry
+	GLuint get_vao() const;
+
+	//! \brief Get a hash of the textures of this node.
+	//!
+	//! Nodes with the same textures, bound to the same uniforms, have the
+	//! same key.
+	std::uint32_t get_textures_key() const;
+
+	//! \brief Get the model-space bounds of the geometry of this node.
+	//!
+	//! They enclose all instances if there are any, and are invalid if
+	//! there is no geometry, or if it did not come with any.
+	bonobo::bounds_data const& get_bounds() const;
+
 	//! \brief Set the program of this node.
 	//!
 	//! A node without a program will not render itself, but its children
@@ -105,6 +216,23 @@ public:
 	//!                  GL_TEXTURE_CUBE_MAP, etc.
 	void add_texture(std::string const& name, GLuint tex_id, GLenum type);
 
+	//! \brief Add the arrays of |set| to the textures of this node, as
+	//!        the elements of the `texture_arrays` sampler array.
+	//!
+	//! The layers to sample come from the `layer_bindings` of the
+	//! geometry. Programs with a `Materials` block find them in the
+	//! material selected by |set_material_index()|; other programs get
+	//! them through the uniforms
+	//!
+	//!     uniform uint texture_flags;   // see bonobo::materials::texture_flag
+	//!     uniform uvec4 texture_layers; // diffuse, specular, normals and opacity layers
+	//!
+	//! laid out as in the material buffer (see materials.hpp).
+	//!
+	//! @param [in] set the arrays to bind; only their OpenGL names are
+	//!             copied, so the arrays have to outlive the node
+	void add_texture_arrays(bonobo::texture_arrays::texture_array_set const& set);
+
 	//! \brief Add a child to this node.
 	//!
 	//! @param [in] child pointer to the child to add; the pointer has to
@@ -130,25 +258,104 @@ public:
 	TRSTransformf const& get_transform() const;
 	TRSTransformf& get_transform();
 
+	//! \brief Return the matrix from this node's local space to world
+	//!        space.
+	//!
+	//! The result is cached, and only recomputed when |parent_transform|
+	//! or the transform of this node change.
+	//!
+	//! @param [in] parent_transform Matrix transforming from parent-space
+	//!             to world-space
+	glm::mat4 const& get_world_matrix(glm::mat4 const& parent_transform = glm::mat4(1.0f)) const;
+
 private:
+	//! \brief Locations of the uniforms set by `render()`, for the
+	//!        program they were queried from.
+	struct uniform_locations {
+		GLint vertex_model_to_world{-1};
+		GLint normal_model_to_world{-1};
+		GLint vertex_world_to_clip{-1};
+		GLint diffuse_colour{-1};
+		GLint specular_colour{-1};
+		GLint ambient_colour{-1};
+		GLint emissive_colour{-1};
+		GLint shininess_value{-1};
+		GLint index_of_refraction_value{-1};
+		GLint opacity_value{-1};
+		GLint material_index{-1};
+		GLint texture_flags{-1};
+		GLint texture_layers{-1};
+		bool has_materials_block{false};
+	};
+
+	struct texture_binding {
+		std::string name;           //!< name of the sampler uniform
+		std::string presence_name;  //!< name of the boolean uniform set while the texture is bound, i.e. "has_" followed by |name|
+		GLuint id{0u};
+		GLenum type{GL_TEXTURE_2D};
+		GLint location{-1};
+		GLint presence_location{-1};
+	};
+
+	//! \brief Whether |other| binds the same textures to the same
+	//!        uniforms as this node.
+	bool has_same_textures(Node const& other) const;
+
+	//! \brief Set the presence uniforms of the textures of
+	//!        |state.textures_owner| back to 0, and forget about them.
+	static void release_textures(render_state& state);
+
+	//! \brief Query all uniform locations from |program|, unless they
+	//!        were already queried from it since it was last linked.
+	void update_uniform_locations(GLuint program) const;
+
 	// Geometry data
 	GLuint _vao{ 0u };
 	GLsizei _vertices_nb{ 0u };
 	GLsizei _indices_nb{ 0u };
 	GLenum _drawing_mode{ GL_TRIANGLES };
+	GLint _patch_vertices_nb{ 0 };
+	bool _uses_primitive_restart{ false };
 	bool _has_indices{ false };
+	bonobo::bounds_data _bounds;
+	std::shared_ptr<bonobo::mesh_data const> _shared_geometry; //!< keeps shared geometry alive, if any
+	bonobo::instancing::instances_data const* _instances{ nullptr };
 
 	// Program data
 	GLuint const* _program{ nullptr };
 	std::function<void (GLuint)> _set_uniforms;
 
+	// Uniform locations cache; it only remembers the last program used,
+	// as nodes are almost always rendered with the same one.
+	mutable GLuint _locations_program{ 0u };
+	mutable std::uint32_t _locations_link_count{ 0u };
+	mutable uniform_locations _locations;
+
 	// Material data
-	std::vector<std::tuple<std::string, GLuint, GLenum>> _textures;
+	mutable std::vector<texture_binding> _textures;
+	std::uint32_t _textures_key{ 2166136261u };
 	bonobo::material_data _constants;
+	std::int32_t _material_index{ -1 };
+	std::uint32_t _layered_texture_flags{ 0u }; //!< textures of the geometry found in texture arrays, see bonobo::materials::texture_flag
+	glm::uvec4 _texture_layers{ 0u };           //!< where those are, packed as in the material buffer
 
 	// Transformation data
 	TRSTransformf _transform;
 
+	// Matrices of the last render, reused as long as their inputs stay
+	// the same; static nodes thus compute them only once.
+	struct matrices_cache {
+		glm::mat4 parent_transform{1.0f};
+		std::uint32_t transform_revision{0u};
+		glm::mat4 world{1.0f};
+		bool has_world{false};
+
+		glm::mat4 normal_source{1.0f}; //!< world matrix |normal| was computed from
+		glm::mat4 normal{1.0f};
+		bool has_normal{false};
+	};
+	mutable matrices_cache _matrices;
+
 	// Children data
 	std::vector<Node const*> _children;
 
@@ -215,9 +215,12 @@ generate_shader(GLenum type, std::string const& source)
 	}
 }
 
+static auto link_count = std::uint32_t(0u);
+
 bool
 link_program(GLuint id)
 {
+	++link_count;
 	glLinkProgram(id);
 	GLint state = GLint(0);
 	glGetProgramiv(id, GL_LINK_STATUS, &state);
@@ -247,6 +250,12 @@ link_program(GLuint id)
 	return wasLinkingSuccessful;
 }
 
+std::uint32_t
+get_link_count()
+{
+	return link_count;
+}
+
 void
 reload_program(GLuint id, std::vector<GLuint> const& ids, std::vector<std::string> const& sources)
 {
@@ -3,6 +3,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -69,6 +70,14 @@ namespace shader
 bool source_and_build_shader(GLuint id, std::string const& source);
 GLuint generate_shader(GLenum type, std::string const& source);
 bool link_program(GLuint id);
+
+//! \brief Number of times `link_program()` has been called so far.
+//!
+//! Linking a program can change the locations of its uniforms, and a
+//! program deleted and created anew may get back the same name; caches of
+//! uniform locations compare this value to find out when to refresh.
+std::uint32_t get_link_count();
+
 void reload_program(GLuint id, std::vector<GLuint> const& ids, std::vector<std::string> const& sources);
 GLuint generate_program(std::vector<GLuint> const& shaders_id);
 
@@ -0,0 +1,267 @@
+#include "render_queue.hpp"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+	constexpr unsigned int pass_bits = 4u;
+	constexpr unsigned int program_bits = 10u;
+	constexpr unsigned int textures_bits = 16u;
+	constexpr unsigned int vao_bits = 12u;
+	constexpr unsigned int depth_bits = 22u;
+	static_assert(pass_bits + program_bits + textures_bits + vao_bits + depth_bits == 64u,
+	              "The fields of a key should fill it exactly.");
+
+	std::uint64_t
+	field(std::uint64_t value, unsigned int bits)
+	{
+		return value & ((std::uint64_t(1u) << bits) - 1u);
+	}
+
+	//! Positive floats compare like their bit patterns, so the most
+	//! significant bits of those make for a coarse but monotonic depth.
+	std::uint64_t
+	quantizeDepth(float depth)
+	{
+		depth = std::max(depth, 0.0f);
+		std::uint32_t bits = 0u;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return bits >> (32u - 1u - depth_bits);
+	}
+}
+
+void
+RenderQueue::begin(glm::mat4 const& view_projection)
+{
+	_view_projection = view_projection;
+	_frustum = bonobo::culling::extractFrustum(view_projection);
+	_culled_nb = 0u;
+	_packets.clear();
+	_keys.clear();
+}
+
+void
+RenderQueue::submit(Node const& node, glm::mat4 const& parent_transform,
+                    std::uint8_t pass, depth_order order)
+{
+	if (pass >= max_passes_nb) {
+		LogError("Pass %u is out of range, as only %u passes are supported; the node will **not** be rendered.",
+		         static_cast<unsigned int>(pass), static_cast<unsigned int>(max_passes_nb));
+		return;
+	}
+	if (node.get_program() == 0u || node.get_vao() == 0u)
+		return;
+
+	auto const& world = node.get_world_matrix(parent_transform);
+	if (!bonobo::culling::isVisible(_frustum, node.get_bounds(), world)) {
+		++_culled_nb;
+		return;
+	}
+	queue(node, world, pass, order);
+}
+
+void
+RenderQueue::submit_subtree(Node const& node, glm::mat4 const& parent_transform,
+                            std::uint8_t pass, depth_order order)
+{
+	if (pass >= max_passes_nb) {
+		LogError("Pass %u is out of range, as only %u passes are supported; the subtree will **not** be rendered.",
+		         static_cast<unsigned int>(pass), static_cast<unsigned int>(max_passes_nb));
+		return;
+	}
+
+	_subtree.clear();
+	gather_subtree(node, parent_transform);
+
+	std::uint32_t const nodes_nb = static_cast<std::uint32_t>(_subtree.size());
+	std::uint32_t i = 0u;
+	while (i < nodes_nb) {
+		auto const& current = _subtree[i];
+		if (!current.has_geometry) {
+			i = current.end;
+			continue;
+		}
+
+		auto result = bonobo::culling::containment::intersecting;
+		if (current.subtree_bounds.is_valid)
+			result = bonobo::culling::classifyBox(_frustum, current.subtree_bounds.aabb_min,
+			                                      current.subtree_bounds.aabb_max);
+
+		if (result == bonobo::culling::containment::outside) {
+			for (std::uint32_t j = i; j < current.end; ++j)
+				if (_subtree[j].node->get_program() != 0u && _subtree[j].node->get_vao() != 0u)
+					++_culled_nb;
+			i = current.end;
+		} else if (result == bonobo::culling::containment::inside) {
+			for (std::uint32_t j = i; j < current.end; ++j)
+				if (_subtree[j].node->get_program() != 0u && _subtree[j].node->get_vao() != 0u)
+					queue(*_subtree[j].node, _subtree[j].world, pass, order);
+			i = current.end;
+		} else {
+			// Only this node is tested here; its children get their own
+			// chance to be skipped as a whole.
+			auto const& current_node = *current.node;
+			if (current_node.get_program() != 0u && current_node.get_vao() != 0u) {
+				if (bonobo::culling::isVisible(_frustum, current_node.get_bounds(), current.world))
+					queue(current_node, current.world, pass, order);
+				else
+					++_culled_nb;
+			}
+			++i;
+		}
+	}
+}
+
+void
+RenderQueue::gather_subtree(Node const& node, glm::mat4 const& parent_transform)
+{
+	auto const index = _subtree.size();
+	_subtree.push_back({ &node, node.get_world_matrix(parent_transform), bonobo::bounds_data(), false, 0u });
+
+	// Nodes without geometry, or with geometry only placed on the GPU,
+	// make the whole subtree impossible to cull.
+	bool const has_geometry = node.get_program() != 0u && node.get_vao() != 0u;
+	bool can_cull = !has_geometry || node.get_bounds().is_valid;
+	auto subtree_bounds = has_geometry ? bonobo::culling::transformBounds(node.get_bounds(), _subtree[index].world)
+	                                   : bonobo::bounds_data();
+	bool subtree_has_geometry = has_geometry;
+
+	for (size_t i = 0u; i < node.get_children_nb(); ++i) {
+		auto const child_index = _subtree.size();
+		// The vector may grow, so the world matrix is copied first.
+		auto const world = _subtree[index].world;
+		gather_subtree(*node.get_child(i), world);
+
+		auto const& child = _subtree[child_index];
+		if (!child.has_geometry)
+			continue;
+		subtree_has_geometry = true;
+		if (!child.subtree_bounds.is_valid) {
+			can_cull = false;
+			continue;
+		}
+		if (!subtree_bounds.is_valid) {
+			subtree_bounds = child.subtree_bounds;
+			continue;
+		}
+		subtree_bounds.aabb_min = glm::min(subtree_bounds.aabb_min, child.subtree_bounds.aabb_min);
+		subtree_bounds.aabb_max = glm::max(subtree_bounds.aabb_max, child.subtree_bounds.aabb_max);
+	}
+
+	auto& entry = _subtree[index];
+	entry.has_geometry = subtree_has_geometry;
+	entry.end = static_cast<std::uint32_t>(_subtree.size());
+	if (can_cull && subtree_bounds.is_valid) {
+		// Only the box is tested for subtrees, so the sphere is simply
+		// the one enclosing the box.
+		subtree_bounds.sphere_centre = 0.5f * (subtree_bounds.aabb_min + subtree_bounds.aabb_max);
+		subtree_bounds.sphere_radius = 0.5f * glm::length(subtree_bounds.aabb_max - subtree_bounds.aabb_min);
+		entry.subtree_bounds = subtree_bounds;
+	}
+}
+
+void
+RenderQueue::queue(Node const& node, glm::mat4 const& world, std::uint8_t pass,
+                   depth_order order)
+{
+	_packets.push_back({ &node, world });
+
+	// Distance along the view direction, as found in w by perspective
+	// projections.
+	auto const depth = quantizeDepth((_view_projection * world[3]).w);
+
+	std::uint64_t const pass_field = field(pass, pass_bits);
+	std::uint64_t const program_field = field(node.get_program(), program_bits);
+	std::uint64_t const textures_field = field(node.get_textures_key() ^ (node.get_textures_key() >> 16u), textures_bits);
+	std::uint64_t const vao_field = field(node.get_vao(), vao_bits);
+
+	std::uint64_t key = pass_field << (64u - pass_bits);
+	if (order == depth_order::front_to_back) {
+		key |= program_field << (textures_bits + vao_bits + depth_bits)
+		     | textures_field << (vao_bits + depth_bits)
+		     | vao_field << depth_bits
+		     | depth;
+	} else {
+		key |= field(~depth, depth_bits) << (program_bits + textures_bits + vao_bits)
+		     | program_field << (textures_bits + vao_bits)
+		     | textures_field << vao_bits
+		     | vao_field;
+	}
+	_keys.push_back(key);
+}
+
+void
+RenderQueue::execute()
+{
+	sort();
+
+	Node::render_state state;
+	for (auto const index : _order) {
+		auto const& submitted = _packets[index];
+		submitted.node->render(_view_projection, submitted.world, state);
+	}
+	Node::end_render(state);
+}
+
+std::size_t
+RenderQueue::get_packets_nb() const
+{
+	return _packets.size();
+}
+
+std::size_t
+RenderQueue::get_culled_nb() const
+{
+	return _culled_nb;
+}
+
+void
+RenderQueue::sort()
+{
+	auto const packets_nb = _packets.size();
+	_sorted_keys.assign(_keys.begin(), _keys.end());
+	_keys_scratch.resize(packets_nb);
+	_order.resize(packets_nb);
+	_order_scratch.resize(packets_nb);
+	for (std::size_t i = 0u; i < packets_nb; ++i)
+		_order[i] = static_cast<std::uint32_t>(i);
+
+	// Build the histograms of all eight digits in a single pass over the
+	// keys.
+	constexpr std::size_t digits_nb = sizeof(std::uint64_t);
+	std::array<std::array<std::uint32_t, 256u>, digits_nb> histograms{};
+	for (auto const key : _sorted_keys)
+		for (std::size_t d = 0u; d < digits_nb; ++d)
+			++histograms[d][(key >> (8u * d)) & 0xffu];
+
+	// Least significant digit first; each pass is stable, so the order of
+	// the previous digits is kept among keys sharing the current one.
+	for (std::size_t d = 0u; d < digits_nb; ++d) {
+		auto& histogram = histograms[d];
+
+		// All keys share that digit (which is common for the pass and
+		// program fields), so the pass would leave them in place.
+		if (std::find(histogram.begin(), histogram.end(), static_cast<std::uint32_t>(packets_nb)) != histogram.end())
+			continue;
+
+		std::uint32_t offset = 0u;
+		for (auto& count : histogram) {
+			auto const bucket_size = count;
+			count = offset;
+			offset += bucket_size;
+		}
+
+		for (std::size_t i = 0u; i < packets_nb; ++i) {
+			auto const key = _sorted_keys[i];
+			auto const destination = histogram[(key >> (8u * d)) & 0xffu]++;
+			_keys_scratch[destination] = key;
+			_order_scratch[destination] = _order[i];
+		}
+		std::swap(_sorted_keys, _keys_scratch);
+		std::swap(_order, _order_scratch);
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "culling.hpp"
+#include "node.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Collects nodes to render over a frame, and renders them sorted
+//!        so as to change as little OpenGL state as possible.
+//!
+//! Each submitted node gets a 64-bit key, packing from the most to the
+//! least significant bits:
+//!
+//!     | pass (4) | program (10) | textures (16) | vertex array (12) | depth (22) |
+//!
+//! so that nodes are grouped by pass, then by program, and so on, and
+//! drawn front-to-back within a group to benefit from early depth tests.
+//! Passes sorted back-to-front, typically for transparent objects, move
+//! the depth right after the pass instead. Programs, textures and vertex
+//! arrays are only hashed into their fields: collisions can make the
+//! sorting less effective, but not the rendering wrong, as the state
+//! actually bound is what gets compared when rendering.
+//!
+//! Nodes whose bounds lie outside the view frustum are dropped as soon as
+//! they are submitted. Whole subtrees of the scene graph can be submitted
+//! at once, in which case the union of their bounds is tested first, and
+//! none of their nodes get tested individually unless that union
+//! straddles the frustum.
+class RenderQueue
+{
+public:
+	enum class depth_order : std::uint8_t {
+		front_to_back = 0u,
+		back_to_front
+	};
+
+	//! Passes are stored on 4 bits.
+	static constexpr std::uint8_t max_passes_nb = 16u;
+
+	//! \brief Drop all nodes submitted so far, and start collecting new
+	//!        ones seen through |view_projection|.
+	void begin(glm::mat4 const& view_projection);
+
+	//! \brief Queue |node| to be rendered with its own program.
+	//!
+	//! @param [in] node node to render; it has to stay alive until
+	//!             `execute()` is called
+	//! @param [in] parent_transform Matrix transforming from parent-space
+	//!             to world-space, as for `Node::render()`
+	//! @param [in] pass passes are rendered in increasing order; it has
+	//!             to be less than |max_passes_nb|
+	//! @param [in] order how nodes of that pass are sorted by depth
+	void submit(Node const& node,
+	            glm::mat4 const& parent_transform = glm::mat4(1.0f),
+	            std::uint8_t pass = 0u,
+	            depth_order order = depth_order::front_to_back);
+
+	//! \brief Queue |node| and all its descendants, as if each had been
+	//!        `submit()`ted with its parent's world matrix.
+	//!
+	//! Subtrees whose world-space bounds lie outside the view frustum are
+	//! skipped with a single test, and those fully inside it are queued
+	//! without testing any of their nodes.
+	//!
+	//! @param [in] node root of the subtree to render; it, and all its
+	//!             descendants, have to stay alive until `execute()` is
+	//!             called
+	//! @param [in] parent_transform Matrix transforming from the parent
+	//!             space of |node| to world-space
+	//! @param [in] pass passes are rendered in increasing order; it has
+	//!             to be less than |max_passes_nb|
+	//! @param [in] order how nodes of that pass are sorted by depth
+	void submit_subtree(Node const& node,
+	                    glm::mat4 const& parent_transform = glm::mat4(1.0f),
+	                    std::uint8_t pass = 0u,
+	                    depth_order order = depth_order::front_to_back);
+
+	//! \brief Sort and render all submitted nodes, then unbind everything.
+	void execute();
+
+	std::size_t get_packets_nb() const;
+
+	//! \brief Number of nodes dropped by frustum culling since the last
+	//!        call to `begin()`.
+	std::size_t get_culled_nb() const;
+
+private:
+	struct packet {
+		Node const* node;
+		glm::mat4 world;
+	};
+
+	//! \brief A node of a submitted subtree, with the world-space bounds
+	//!        of everything it and its descendants render.
+	struct subtree_node {
+		Node const* node;
+		glm::mat4 world;
+		bonobo::bounds_data subtree_bounds; //!< invalid when nothing below can be culled
+		bool has_geometry;                  //!< whether anything below renders at all
+		std::uint32_t end;                  //!< one past the index of the last descendant
+	};
+
+	//! \brief Append |node| and its descendants to |_subtree|, in
+	//!        depth-first pre-order, filling in their world matrices and
+	//!        subtree bounds.
+	void gather_subtree(Node const& node, glm::mat4 const& parent_transform);
+
+	//! \brief Compute the key of |node|, placed at |world|, and queue it.
+	void queue(Node const& node, glm::mat4 const& world, std::uint8_t pass,
+	           depth_order order);
+
+	//! \brief Sort |_order| by |_keys|, eight bits at a time.
+	void sort();
+
+	glm::mat4 _view_projection{1.0f};
+	bonobo::culling::frustum _frustum;
+	std::size_t _culled_nb{0u};
+	std::vector<packet> _packets;
+	std::vector<std::uint64_t> _keys; //!< one per packet, in submission order
+
+	// Kept from one frame to the next, to avoid reallocating them.
+	std::vector<std::uint64_t> _sorted_keys;
+	std::vector<std::uint64_t> _keys_scratch;
+	std::vector<std::uint32_t> _order;
+	std::vector<std::uint32_t> _order_scratch;
+	std::vector<subtree_node> _subtree;
+};
@@ -0,0 +1,397 @@
+#include "skinning.hpp"
+
+#include "Log.h"
+#include "opengl.hpp"
+
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	include <xmmintrin.h>
+#	define BONOBO_SKINNING_USE_SSE 1
+#endif
+
+namespace
+{
+	// Evaluating a pose costs a few microseconds per dozen joints, so
+	// threads are only worth spawning for several instances each.
+	constexpr std::size_t min_instances_per_thread = 8u;
+
+	bonobo::skinning::affine_transform
+	makeIdentity()
+	{
+		return {{ { 1.0f, 0.0f, 0.0f, 0.0f },
+		          { 0.0f, 1.0f, 0.0f, 0.0f },
+		          { 0.0f, 0.0f, 1.0f, 0.0f } }};
+	}
+
+	// Assimp matrices are stored row-major, like affine_transform.
+	bonobo::skinning::affine_transform
+	makeAffine(aiMatrix4x4 const& m)
+	{
+		return {{ { m.a1, m.a2, m.a3, m.a4 },
+		          { m.b1, m.b2, m.b3, m.b4 },
+		          { m.c1, m.c2, m.c3, m.c4 } }};
+	}
+
+	bonobo::skinning::affine_transform
+	makeAffine(glm::vec3 const& translation, glm::quat const& rotation, glm::vec3 const& scale)
+	{
+		auto const r = glm::mat3_cast(rotation);
+		return {{ { r[0][0] * scale.x, r[1][0] * scale.y, r[2][0] * scale.z, translation.x },
+		          { r[0][1] * scale.x, r[1][1] * scale.y, r[2][1] * scale.z, translation.y },
+		          { r[0][2] * scale.x, r[1][2] * scale.y, r[2][2] * scale.z, translation.z } }};
+	}
+
+	// Compute lhs * rhs, as if both had an implicit (0, 0, 0, 1) last row.
+	inline void
+	multiply(bonobo::skinning::affine_transform const& lhs,
+	         bonobo::skinning::affine_transform const& rhs,
+	         bonobo::skinning::affine_transform& result)
+	{
+#if defined(BONOBO_SKINNING_USE_SSE)
+		auto const rhs_row0 = _mm_load_ps(rhs.rows[0]);
+		auto const rhs_row1 = _mm_load_ps(rhs.rows[1]);
+		auto const rhs_row2 = _mm_load_ps(rhs.rows[2]);
+		for (int i = 0; i < 3; ++i) {
+			auto row = _mm_mul_ps(_mm_set1_ps(lhs.rows[i][0]), rhs_row0);
+			row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(lhs.rows[i][1]), rhs_row1));
+			row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(lhs.rows[i][2]), rhs_row2));
+			row = _mm_add_ps(row, _mm_set_ps(lhs.rows[i][3], 0.0f, 0.0f, 0.0f));
+			_mm_store_ps(result.rows[i], row);
+		}
+#else
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 4; ++j)
+				result.rows[i][j] = lhs.rows[i][0] * rhs.rows[0][j]
+				                  + lhs.rows[i][1] * rhs.rows[1][j]
+				                  + lhs.rows[i][2] * rhs.rows[2][j];
+			result.rows[i][3] += lhs.rows[i][3];
+		}
+#endif
+	}
+
+	// Mark the nodes which are bones or have a bone below them.
+	bool
+	markJointNodes(aiNode const* const node, std::map<std::string, aiMatrix4x4> const& bones,
+	               std::vector<aiNode const*>& joint_nodes)
+	{
+		auto is_needed = bones.find(node->mName.C_Str()) != bones.end();
+		std::vector<aiNode const*> below;
+		for (unsigned int i = 0u; i < node->mNumChildren; ++i)
+			is_needed |= markJointNodes(node->mChildren[i], bones, below);
+		if (is_needed) {
+			joint_nodes.push_back(node);
+			joint_nodes.insert(joint_nodes.end(), below.begin(), below.end());
+		}
+		return is_needed;
+	}
+}
+
+bool
+bonobo::skinning::detail::importRig(aiScene const& scene, rig_data& rig)
+{
+	std::map<std::string, aiMatrix4x4> bones;
+	for (unsigned int m = 0u; m < scene.mNumMeshes; ++m) {
+		auto const mesh = scene.mMeshes[m];
+		for (unsigned int b = 0u; b < mesh->mNumBones; ++b)
+			bones.emplace(mesh->mBones[b]->mName.C_Str(), mesh->mBones[b]->mOffsetMatrix);
+	}
+	if (bones.empty())
+		return false;
+
+	// All ancestors of the bones are kept as joints as well, as they take
+	// part in positioning the bones; pre-order traversal ensures parents
+	// come before their children.
+	std::vector<aiNode const*> joint_nodes;
+	markJointNodes(scene.mRootNode, bones, joint_nodes);
+	if (joint_nodes.size() > max_joints_nb) {
+		LogError("The skeleton has %zu joints, but at most %zu are supported: skinning data will be ignored.", joint_nodes.size(), max_joints_nb);
+		return false;
+	}
+
+	auto& skeleton = rig.skeleton;
+	std::map<aiNode const*, std::int32_t> node_indices;
+	for (auto const node : joint_nodes) {
+		node_indices.emplace(node, static_cast<std::int32_t>(skeleton.joint_names.size()));
+
+		auto const parent = node_indices.find(node->mParent);
+		skeleton.parents.push_back(parent != node_indices.end() ? parent->second : -1);
+		skeleton.joint_names.emplace_back(node->mName.C_Str());
+
+		aiVector3D scale, translation;
+		aiQuaternion rotation;
+		node->mTransformation.Decompose(scale, rotation, translation);
+		skeleton.bind_translations.emplace_back(translation.x, translation.y, translation.z);
+		skeleton.bind_rotations.emplace_back(rotation.w, rotation.x, rotation.y, rotation.z);
+		skeleton.bind_scales.emplace_back(scale.x, scale.y, scale.z);
+
+		auto const bone = bones.find(node->mName.C_Str());
+		skeleton.inverse_bind_matrices.push_back(bone != bones.end() ? makeAffine(bone->second) : makeIdentity());
+	}
+	auto scene_to_mesh = scene.mRootNode->mTransformation;
+	skeleton.scene_to_mesh = makeAffine(scene_to_mesh.Inverse());
+
+	std::map<std::string, std::size_t> joint_indices;
+	for (std::size_t j = 0u; j < skeleton.joint_names.size(); ++j)
+		joint_indices.emplace(skeleton.joint_names[j], j);
+
+	rig.clips.reserve(scene.mNumAnimations);
+	for (unsigned int a = 0u; a < scene.mNumAnimations; ++a) {
+		auto const animation = scene.mAnimations[a];
+		// Files which do not specify it usually assume 25 ticks per second.
+		auto const ticks_per_second = animation->mTicksPerSecond != 0.0 ? animation->mTicksPerSecond : 25.0;
+
+		clip_data clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration_s = static_cast<float>(animation->mDuration / ticks_per_second);
+		clip.joint_tracks.resize(skeleton.joint_names.size());
+		for (unsigned int c = 0u; c < animation->mNumChannels; ++c) {
+			auto const channel = animation->mChannels[c];
+			auto const joint = joint_indices.find(channel->mNodeName.C_Str());
+			if (joint == joint_indices.end())
+				continue;
+
+			auto& track = clip.joint_tracks[joint->second];
+			for (unsigned int k = 0u; k < channel->mNumPositionKeys; ++k) {
+				auto const& key = channel->mPositionKeys[k];
+				track.add_translation_key(static_cast<float>(key.mTime / ticks_per_second), glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for (unsigned int k = 0u; k < channel->mNumRotationKeys; ++k) {
+				auto const& key = channel->mRotationKeys[k];
+				track.add_rotation_key(static_cast<float>(key.mTime / ticks_per_second), glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+			for (unsigned int k = 0u; k < channel->mNumScalingKeys; ++k) {
+				auto const& key = channel->mScalingKeys[k];
+				track.add_scale_key(static_cast<float>(key.mTime / ticks_per_second), glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+			}
+		}
+		rig.clips.push_back(std::move(clip));
+	}
+
+	return true;
+}
+
+void
+bonobo::skinning::detail::quantizeInfluences(aiMesh const& mesh, skeleton_data const& skeleton,
+                                             std::vector<std::array<std::uint8_t, max_influences_per_vertex>>& joint_indices,
+                                             std::vector<std::array<std::uint8_t, max_influences_per_vertex>>& joint_weights)
+{
+	using influences = std::array<std::pair<float, std::uint8_t>, max_influences_per_vertex>;
+	std::vector<influences> vertices_influences(mesh.mNumVertices);
+	for (auto& vertex_influences : vertices_influences)
+		vertex_influences.fill(std::make_pair(0.0f, std::uint8_t(0u)));
+
+	for (unsigned int b = 0u; b < mesh.mNumBones; ++b) {
+		auto const bone = mesh.mBones[b];
+		auto const joint = std::find(skeleton.joint_names.begin(), skeleton.joint_names.end(), bone->mName.C_Str());
+		if (joint == skeleton.joint_names.end())
+			continue;
+		auto const joint_index = static_cast<std::uint8_t>(joint - skeleton.joint_names.begin());
+
+		// Replace the smallest influence kept so far, if lighter.
+		for (unsigned int w = 0u; w < bone->mNumWeights; ++w) {
+			auto const& weight = bone->mWeights[w];
+			auto& vertex_influences = vertices_influences[weight.mVertexId];
+			auto const lightest = std::min_element(vertex_influences.begin(), vertex_influences.end());
+			if (weight.mWeight > lightest->first)
+				*lightest = std::make_pair(weight.mWeight, joint_index);
+		}
+	}
+
+	joint_indices.resize(mesh.mNumVertices);
+	joint_weights.resize(mesh.mNumVertices);
+	for (std::size_t v = 0u; v < vertices_influences.size(); ++v) {
+		auto& vertex_influences = vertices_influences[v];
+		std::sort(vertex_influences.begin(), vertex_influences.end(),
+		          [](std::pair<float, std::uint8_t> const& lhs, std::pair<float, std::uint8_t> const& rhs){
+		                  return lhs.first > rhs.first;
+		          });
+
+		auto total = 0.0f;
+		for (auto const& influence : vertex_influences)
+			total += influence.first;
+
+		auto& indices = joint_indices[v];
+		auto& weights = joint_weights[v];
+		if (total <= 0.0f) {
+			indices.fill(0u);
+			weights = {{ 255u, 0u, 0u, 0u }};
+			continue;
+		}
+
+		// Round each weight, then give the rounding error to the heaviest
+		// one so that the quantised weights still sum to exactly 1.
+		auto sum = 0;
+		for (std::size_t i = 0u; i < max_influences_per_vertex; ++i) {
+			indices[i] = vertex_influences[i].second;
+			weights[i] = static_cast<std::uint8_t>(std::lround(vertex_influences[i].first / total * 255.0f));
+			sum += weights[i];
+		}
+		weights[0] = static_cast<std::uint8_t>(weights[0] + (255 - sum));
+	}
+}
+
+bonobo::skinning::instance
+bonobo::skinning::createInstance(rig_data const& rig, std::size_t clip_index, float time_offset_s)
+{
+	instance character;
+	character.time_offset_s = time_offset_s;
+	if (clip_index >= rig.clips.size()) {
+		// Without any clip, the instance stays in its bind pose.
+		character.joint_tracks.resize(rig.skeleton.joint_names.size());
+		return character;
+	}
+
+	character.clip_index = clip_index;
+	character.joint_tracks = rig.clips[clip_index].joint_tracks;
+	character.duration_s = rig.clips[clip_index].duration_s;
+	return character;
+}
+
+void
+bonobo::skinning::evaluatePose(skeleton_data const& skeleton, instance& character,
+                               float time_s, affine_transform* palette)
+{
+	auto local_time = time_s * character.playback_speed + character.time_offset_s;
+	if (character.duration_s > 0.0f) {
+		local_time = std::fmod(local_time, character.duration_s);
+		if (local_time < 0.0f)
+			local_time += character.duration_s;
+	}
+
+	// |palette| first receives the joint transforms relative to mesh space,
+	// which are needed for placing the children, and gets multiplied by
+	// the inverse bind matrices in a second pass.
+	auto const joints_nb = skeleton.joint_names.size();
+	for (std::size_t j = 0u; j < joints_nb; ++j) {
+		auto& track = character.joint_tracks[j];
+		auto const local = makeAffine(track.has_translation_keys() ? track.eval_translation(local_time) : skeleton.bind_translations[j],
+		                              track.has_rotation_keys() ? track.eval_rotation(local_time) : skeleton.bind_rotations[j],
+		                              track.has_scale_keys() ? track.eval_scale(local_time) : skeleton.bind_scales[j]);
+
+		auto const parent = skeleton.parents[j];
+		multiply(parent >= 0 ? palette[parent] : skeleton.scene_to_mesh, local, palette[j]);
+	}
+	for (std::size_t j = 0u; j < joints_nb; ++j) {
+		auto const joint_to_mesh = palette[j];
+		multiply(joint_to_mesh, skeleton.inverse_bind_matrices[j], palette[j]);
+	}
+}
+
+void
+bonobo::skinning::evaluatePoses(skeleton_data const& skeleton,
+                                std::vector<instance>& characters, float time_s,
+                                std::vector<affine_transform>& palettes)
+{
+	auto const joints_nb = skeleton.joint_names.size();
+	palettes.resize(characters.size() * joints_nb);
+
+	auto const evaluate_range = [&skeleton, &characters, time_s, &palettes, joints_nb](std::size_t first, std::size_t end){
+		for (std::size_t i = first; i < end; ++i)
+			evaluatePose(skeleton, characters[i], time_s, palettes.data() + i * joints_nb);
+	};
+
+	auto const max_useful_threads_nb = characters.size() / min_instances_per_thread;
+	if (max_useful_threads_nb <= 1u) {
+		evaluate_range(0u, characters.size());
+		return;
+	}
+
+	auto const hardware_threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+	auto const threads_nb = std::min<std::size_t>(hardware_threads_nb, max_useful_threads_nb);
+
+	// The calling thread takes care of the last range itself.
+	std::vector<std::thread> workers;
+	workers.reserve(threads_nb - 1u);
+	auto const instances_per_thread = characters.size() / threads_nb;
+	auto const remaining_instances = characters.size() % threads_nb;
+	std::size_t first_instance = 0u;
+	for (std::size_t t = 0u; t < threads_nb; ++t) {
+		auto const end_instance = first_instance + instances_per_thread + (t < remaining_instances ? 1u : 0u);
+		if (t + 1u < threads_nb)
+			workers.emplace_back(evaluate_range, first_instance, end_instance);
+		else
+			evaluate_range(first_instance, end_instance);
+		first_instance = end_instance;
+	}
+	for (auto& worker : workers)
+		worker.join();
+}
+
+bonobo::skinning::palette_buffer
+bonobo::skinning::createPaletteBuffer()
+{
+	palette_buffer buffer;
+
+	glGenBuffers(1, &buffer.bo);
+	assert(buffer.bo != 0u);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer.bo);
+	glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(sizeof(affine_transform)), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0u);
+	buffer.capacity = 1u;
+
+	// Each joint transform takes three texels.
+	GLint max_texels_nb = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels_nb);
+	buffer.max_capacity = static_cast<std::size_t>(std::max(max_texels_nb, 0)) / 3u;
+
+	glGenTextures(1, &buffer.texture);
+	assert(buffer.texture != 0u);
+	glBindTexture(GL_TEXTURE_BUFFER, buffer.texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer.bo);
+	glBindTexture(GL_TEXTURE_BUFFER, 0u);
+
+	utils::opengl::debug::nameObject(GL_BUFFER, buffer.bo, "Joint palettes");
+	utils::opengl::debug::nameObject(GL_TEXTURE, buffer.texture, "Joint palettes texture");
+
+	return buffer;
+}
+
+void
+bonobo::skinning::destroyPaletteBuffer(palette_buffer& buffer)
+{
+	glDeleteTextures(1, &buffer.texture);
+	glDeleteBuffers(1, &buffer.bo);
+	buffer = palette_buffer();
+}
+
+std::size_t
+bonobo::skinning::getMaxInstancesNb(palette_buffer const& buffer,
+                                    std::size_t joints_nb)
+{
+	return joints_nb > 0u ? buffer.max_capacity / joints_nb : 0u;
+}
+
+void
+bonobo::skinning::updatePaletteBuffer(palette_buffer& buffer,
+                                      std::vector<affine_transform> const& palettes)
+{
+	if (buffer.bo == 0u) {
+		LogError("The palette buffer was not created using createPaletteBuffer(); it will not be updated.");
+		return;
+	}
+	if (palettes.empty())
+		return;
+
+	auto transforms_nb = palettes.size();
+	if (transforms_nb > buffer.max_capacity) {
+		LogError("%zu joint transforms were given, but the texture buffer can only address %zu; the remaining ones will be **ignored**.",
+		         transforms_nb, buffer.max_capacity);
+		transforms_nb = buffer.max_capacity;
+	}
+
+	static_assert(sizeof(affine_transform) == 12u * sizeof(float), "Joint transforms are expected to be tightly packed.");
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer.bo);
+	if (transforms_nb > buffer.capacity) {
+		buffer.capacity = std::min(std::max(transforms_nb, 2u * buffer.capacity), buffer.max_capacity);
+		glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(buffer.capacity * sizeof(affine_transform)), nullptr, GL_STREAM_DRAW);
+	}
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(transforms_nb * sizeof(affine_transform)), static_cast<GLvoid const*>(palettes.data()));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0u);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "animation.hpp"
+#include "helpers.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct aiMesh;
+struct aiScene;
+
+//! \brief Skeletal animation: skeletons and clips imported alongside the
+//!        meshes by `bonobo::loadObjects()`, poses evaluated on the CPU,
+//!        and joint palettes uploaded to a texture buffer for skinning in
+//!        the vertex shader.
+//!
+//! Skinned meshes carry, for each vertex, the indices of up to four joints
+//! as unsigned bytes (`shader_bindings::joint_indices`), and their weights
+//! as normalised unsigned bytes (`shader_bindings::joint_weights`).
+//!
+//! A palette holds one `affine_transform` per joint, stored as three
+//! RGBA32F texels; the palette of instance i starts at joint
+//! `i * joints_nb`. Vertex shaders read them as:
+//!
+//!     uniform samplerBuffer joint_palettes;
+//!     uniform int palette_offset;
+//!     // Row r of joint j: texelFetch(joint_palettes, 3 * (palette_offset + j) + r)
+namespace bonobo
+{
+namespace skinning
+{
+	constexpr std::size_t max_influences_per_vertex = 4u;
+
+	//! Joint indices are stored as bytes.
+	constexpr std::size_t max_joints_nb = 256u;
+
+	//! \brief Upper 3×4 part of an affine transform, stored row by row.
+	struct alignas(16) affine_transform {
+		float rows[3][4];
+	};
+
+	//! \brief Joint hierarchy and bind pose.
+	struct skeleton_data {
+		std::vector<std::string> joint_names{};            //!< name of the scene node driving each joint
+		std::vector<std::int32_t> parents{};               //!< index of each joint's parent, or -1 for roots; parents always come before their children
+		std::vector<glm::vec3> bind_translations{};        //!< bind pose of each joint, relative to its parent
+		std::vector<glm::quat> bind_rotations{};           //!< bind pose of each joint, relative to its parent
+		std::vector<glm::vec3> bind_scales{};              //!< bind pose of each joint, relative to its parent
+		std::vector<affine_transform> inverse_bind_matrices{}; //!< from mesh space to the space of each joint in the bind pose
+		affine_transform scene_to_mesh{};                  //!< applied on top of the roots, to bring the animated joints back to mesh space
+	};
+
+	//! \brief Animation of some joints of a skeleton.
+	struct clip_data {
+		std::string name{};
+		float duration_s{0.0f};
+		std::vector<animation::TransformTrack> joint_tracks{}; //!< one per joint; joints without keys stay in their bind pose
+	};
+
+	//! \brief Skeleton and animation clips of a scene.
+	struct rig_data {
+		skeleton_data skeleton{};
+		std::vector<clip_data> clips{};
+	};
+
+	//! \brief Playback state of one animated character.
+	//!
+	//! Each instance keeps its own copy of the tracks it plays, so that
+	//! their cursors stay independent and different instances can be
+	//! evaluated on different threads.
+	struct instance {
+		std::size_t clip_index{0u};
+		std::vector<animation::TransformTrack> joint_tracks{};
+		float duration_s{0.0f};
+		float time_offset_s{0.0f};
+		float playback_speed{1.0f};
+	};
+
+	//! \brief Create an instance playing clip |clip_index| of |rig| in a
+	//!        loop, starting |time_offset_s| seconds into it.
+	instance createInstance(rig_data const& rig, std::size_t clip_index,
+	                        float time_offset_s = 0.0f);
+
+	//! \brief Compute the palette of |character| at |time_s|.
+	//!
+	//! @param [in] skeleton the skeleton the instance's clip animates
+	//! @param [in,out] character the instance to evaluate
+	//! @param [in] time_s global time, in seconds
+	//! @param [out] palette where to write one transform per joint, from
+	//!              bind-pose mesh space to animated mesh space
+	void evaluatePose(skeleton_data const& skeleton, instance& character,
+	                  float time_s, affine_transform* palette);
+
+	//! \brief Compute the palettes of all |characters| at |time_s|,
+	//!        spreading them over several threads.
+	//!
+	//! @param [out] palettes resized to hold the palettes of all
+	//!              instances, one after the other
+	void evaluatePoses(skeleton_data const& skeleton,
+	                   std::vector<instance>& characters, float time_s,
+	                   std::vector<affine_transform>& palettes);
+
+	//! \brief Texture buffer holding the palettes of many instances.
+	struct palette_buffer {
+		GLuint bo{0u};                 //!< OpenGL name of the Buffer Object
+		GLuint texture{0u};            //!< OpenGL name of the RGBA32F texture buffer reading from |bo|
+		std::size_t capacity{0u};      //!< number of joint transforms that fit in |bo|
+		std::size_t max_capacity{0u};  //!< number of joint transforms the texture buffer can address, from GL_MAX_TEXTURE_BUFFER_SIZE
+	};
+
+	palette_buffer createPaletteBuffer();
+	void destroyPaletteBuffer(palette_buffer& buffer);
+
+	//! \brief Number of instances of a skeleton with |joints_nb| joints
+	//!        whose palettes fit in |buffer|.
+	//!
+	//! OpenGL only guarantees 65536 texels per texture buffer, which is
+	//! about 85 instances of a 256-joint skeleton.
+	std::size_t getMaxInstancesNb(palette_buffer const& buffer,
+	                              std::size_t joints_nb);
+
+	//! \brief Upload |palettes|, growing the buffer if needed.
+	//!
+	//! Transforms past |buffer.max_capacity| are dropped, with an error.
+	void updatePaletteBuffer(palette_buffer& buffer,
+	                         std::vector<affine_transform> const& palettes);
+
+	namespace detail
+	{
+		//! \brief Build the skeleton from the bones of all meshes and
+		//!        the nodes above them, and import all animations.
+		//!
+		//! @return false if the scene has no bones or too many joints
+		bool importRig(aiScene const& scene, rig_data& rig);
+
+		//! \brief Keep the |max_influences_per_vertex| largest weights of
+		//!        each vertex, and quantise them to bytes summing to 255.
+		//!
+		//! Vertices without any weight are attached to the first joint.
+		void quantizeInfluences(aiMesh const& mesh, skeleton_data const& skeleton,
+		                        std::vector<std::array<std::uint8_t, max_influences_per_vertex>>& joint_indices,
+		                        std::vector<std::array<std::uint8_t, max_influences_per_vertex>>& joint_weights);
+	}
+}
+}
@@ -0,0 +1,44 @@
+#include "static_meshes.hpp"
+
+#include "core/opengl.hpp"
+
+#include <cassert>
+
+bonobo::mesh_data
+bonobo::static_meshes::upload(float const* positions, std::size_t vertices_nb,
+                              std::uint32_t const* indices, std::size_t indices_nb,
+                              std::string const& name)
+{
+	mesh_data data;
+	data.name = name;
+	data.bounds = computeBounds(reinterpret_cast<glm::vec3 const*>(positions), vertices_nb);
+
+	glGenVertexArrays(1, &data.vao);
+	assert(data.vao != 0u);
+	glBindVertexArray(data.vao);
+
+	glGenBuffers(1, &data.bo);
+	assert(data.bo != 0u);
+	glBindBuffer(GL_ARRAY_BUFFER, data.bo);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices_nb * 3u * sizeof(float)), static_cast<GLvoid const*>(positions), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(static_cast<unsigned int>(shader_bindings::vertices));
+	glVertexAttribPointer(static_cast<unsigned int>(shader_bindings::vertices), 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<GLvoid const*>(0x0));
+
+	glGenBuffers(1, &data.ibo);
+	assert(data.ibo != 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices_nb * sizeof(std::uint32_t)), static_cast<GLvoid const*>(indices), GL_STATIC_DRAW);
+
+	data.vertices_nb = static_cast<GLsizei>(vertices_nb);
+	data.indices_nb = static_cast<GLsizei>(indices_nb);
+
+	utils::opengl::debug::nameObject(GL_VERTEX_ARRAY, data.vao, name + " VAO");
+	utils::opengl::debug::nameObject(GL_BUFFER, data.bo, name + " VBO");
+	utils::opengl::debug::nameObject(GL_BUFFER, data.ibo, name + " IBO");
+
+	glBindVertexArray(0u);
+	glBindBuffer(GL_ARRAY_BUFFER, 0u);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+
+	return data;
+}
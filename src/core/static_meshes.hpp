@@ -0,0 +1,259 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//! \brief Small meshes with a fixed tessellation, generated at compile time.
+//!
+//! All generators are `constexpr`, so declaring their result as a
+//! `constexpr` variable bakes the vertices and indices into the binary;
+//! the only work left at runtime is uploading them with `upload()`.
+namespace bonobo
+{
+namespace static_meshes
+{
+	struct vertex {
+		float x{ 0.0f };
+		float y{ 0.0f };
+		float z{ 0.0f };
+	};
+
+	//! \brief Positions and triangle indices of a mesh.
+	template<std::size_t VerticesNb, std::size_t IndicesNb>
+	struct mesh {
+		static constexpr std::size_t vertices_nb = VerticesNb;
+		static constexpr std::size_t indices_nb = IndicesNb;
+
+		vertex vertices[VerticesNb]{};
+		std::uint32_t indices[IndicesNb]{};
+	};
+
+	namespace detail
+	{
+		constexpr double pi = 3.14159265358979323846;
+
+		//! \brief `constexpr` replacement for `std::sin()`, accurate to
+		//!        about 1e-15 over [-π, π].
+		constexpr double sin(double x)
+		{
+			while (x > pi)
+				x -= 2.0 * pi;
+			while (x < -pi)
+				x += 2.0 * pi;
+
+			double term = x;
+			double sum = x;
+			for (int i = 1; i < 12; ++i) {
+				term *= -x * x / static_cast<double>((2 * i) * (2 * i + 1));
+				sum += term;
+			}
+			return sum;
+		}
+
+		//! \brief `constexpr` replacement for `std::cos()`.
+		constexpr double cos(double x)
+		{
+			return sin(x + 0.5 * pi);
+		}
+
+		constexpr vertex make_vertex(double x, double y, double z)
+		{
+			vertex v{};
+			v.x = static_cast<float>(x);
+			v.y = static_cast<float>(y);
+			v.z = static_cast<float>(z);
+			return v;
+		}
+
+		template<std::size_t VerticesNb, std::size_t IndicesNb>
+		constexpr void set_triangle(mesh<VerticesNb, IndicesNb>& m, std::size_t triangle,
+		                            std::uint32_t a, std::uint32_t b, std::uint32_t c)
+		{
+			m.indices[3u * triangle + 0u] = a;
+			m.indices[3u * triangle + 1u] = b;
+			m.indices[3u * triangle + 2u] = c;
+		}
+	}
+
+	//! \brief Cone of unit radius and unit height, with its apex at the
+	//!        origin and its base, which is closed, at z = -1.
+	//!
+	//! Faces are wound counter-clockwise when seen from the outside.
+	template<std::size_t Segments>
+	constexpr mesh<Segments + 2u, 6u * Segments> make_cone()
+	{
+		static_assert(Segments >= 3u, "A cone needs at least 3 segments.");
+
+		mesh<Segments + 2u, 6u * Segments> m{};
+		auto const apex = 0u;
+		auto const base_centre = 1u;
+		m.vertices[apex] = detail::make_vertex(0.0, 0.0, 0.0);
+		m.vertices[base_centre] = detail::make_vertex(0.0, 0.0, -1.0);
+		for (std::size_t i = 0u; i < Segments; ++i) {
+			auto const angle = 2.0 * detail::pi * static_cast<double>(i) / static_cast<double>(Segments);
+			m.vertices[2u + i] = detail::make_vertex(detail::sin(angle), detail::cos(angle), -1.0);
+		}
+		for (std::size_t i = 0u; i < Segments; ++i) {
+			auto const current = static_cast<std::uint32_t>(2u + i);
+			auto const next = static_cast<std::uint32_t>(2u + (i + 1u) % Segments);
+			detail::set_triangle(m, 2u * i + 0u, current, apex, next);
+			detail::set_triangle(m, 2u * i + 1u, current, next, base_centre);
+		}
+		return m;
+	}
+
+	//! \brief Disk of unit radius in the XY plane, facing +Z.
+	template<std::size_t Segments>
+	constexpr mesh<Segments + 1u, 3u * Segments> make_disk()
+	{
+		static_assert(Segments >= 3u, "A disk needs at least 3 segments.");
+
+		mesh<Segments + 1u, 3u * Segments> m{};
+		auto const centre = 0u;
+		m.vertices[centre] = detail::make_vertex(0.0, 0.0, 0.0);
+		for (std::size_t i = 0u; i < Segments; ++i) {
+			auto const angle = 2.0 * detail::pi * static_cast<double>(i) / static_cast<double>(Segments);
+			m.vertices[1u + i] = detail::make_vertex(detail::cos(angle), detail::sin(angle), 0.0);
+		}
+		for (std::size_t i = 0u; i < Segments; ++i)
+			detail::set_triangle(m, i, centre,
+			                     static_cast<std::uint32_t>(1u + i),
+			                     static_cast<std::uint32_t>(1u + (i + 1u) % Segments));
+		return m;
+	}
+
+	//! \brief Axis-aligned cube going from -1 to 1 along all axes.
+	constexpr mesh<8u, 36u> make_cube()
+	{
+		mesh<8u, 36u> m{};
+		// Vertex i has its x, y and z coordinates given by bits 0, 1 and 2.
+		for (std::size_t i = 0u; i < 8u; ++i)
+			m.vertices[i] = detail::make_vertex((i & 1u) ? 1.0 : -1.0,
+			                                    (i & 2u) ? 1.0 : -1.0,
+			                                    (i & 4u) ? 1.0 : -1.0);
+		std::uint32_t const faces[6][4] = {
+			{ 0u, 4u, 6u, 2u }, // -X
+			{ 1u, 3u, 7u, 5u }, // +X
+			{ 0u, 1u, 5u, 4u }, // -Y
+			{ 2u, 6u, 7u, 3u }, // +Y
+			{ 0u, 2u, 3u, 1u }, // -Z
+			{ 4u, 5u, 7u, 6u }  // +Z
+		};
+		for (std::size_t f = 0u; f < 6u; ++f) {
+			detail::set_triangle(m, 2u * f + 0u, faces[f][0], faces[f][1], faces[f][2]);
+			detail::set_triangle(m, 2u * f + 1u, faces[f][0], faces[f][2], faces[f][3]);
+		}
+		return m;
+	}
+
+	//! \brief Sphere of unit radius, parameterised like
+	//!        `parametric_shapes::createSphere()`.
+	template<std::size_t LongitudeSegments, std::size_t LatitudeSegments>
+	constexpr mesh<(LongitudeSegments + 1u) * (LatitudeSegments + 1u), 6u * LongitudeSegments * LatitudeSegments> make_sphere()
+	{
+		static_assert(LongitudeSegments >= 3u && LatitudeSegments >= 2u, "Too few segments to get a sphere.");
+
+		mesh<(LongitudeSegments + 1u) * (LatitudeSegments + 1u), 6u * LongitudeSegments * LatitudeSegments> m{};
+		auto const latitude_vertices_count = LatitudeSegments + 1u;
+		for (std::size_t i = 0u; i <= LongitudeSegments; ++i) {
+			auto const theta = 2.0 * detail::pi * static_cast<double>(i) / static_cast<double>(LongitudeSegments);
+			for (std::size_t j = 0u; j <= LatitudeSegments; ++j) {
+				auto const phi = detail::pi * static_cast<double>(j) / static_cast<double>(LatitudeSegments);
+				m.vertices[i * latitude_vertices_count + j] = detail::make_vertex(detail::sin(theta) * detail::sin(phi),
+				                                                                  -detail::cos(phi),
+				                                                                  detail::cos(theta) * detail::sin(phi));
+			}
+		}
+		std::size_t triangle = 0u;
+		for (std::size_t i = 0u; i < LongitudeSegments; ++i) {
+			for (std::size_t j = 0u; j < LatitudeSegments; ++j) {
+				auto const v00 = static_cast<std::uint32_t>(latitude_vertices_count * (i + 0u) + (j + 0u));
+				auto const v01 = static_cast<std::uint32_t>(latitude_vertices_count * (i + 0u) + (j + 1u));
+				auto const v10 = static_cast<std::uint32_t>(latitude_vertices_count * (i + 1u) + (j + 0u));
+				auto const v11 = static_cast<std::uint32_t>(latitude_vertices_count * (i + 1u) + (j + 1u));
+				detail::set_triangle(m, triangle++, v11, v01, v00);
+				detail::set_triangle(m, triangle++, v10, v11, v00);
+			}
+		}
+		return m;
+	}
+
+	//! \brief Arrow pointing along +X, made of a square body going from 0
+	//!        to 1 and a pyramidal tip.
+	//!
+	//! @param half_thickness half the thickness of the body; the tip is
+	//!                       twice as thick, and four times as long.
+	constexpr mesh<13u, 48u> make_arrow(float half_thickness)
+	{
+		mesh<13u, 48u> m{};
+		double const t = half_thickness;
+		// Body of the arrow
+		m.vertices[0]  = detail::make_vertex(0.0, -t, -t);
+		m.vertices[1]  = detail::make_vertex(0.0, -t,  t);
+		m.vertices[2]  = detail::make_vertex(0.0,  t,  t);
+		m.vertices[3]  = detail::make_vertex(0.0,  t, -t);
+		m.vertices[4]  = detail::make_vertex(1.0, -t, -t);
+		m.vertices[5]  = detail::make_vertex(1.0, -t,  t);
+		m.vertices[6]  = detail::make_vertex(1.0,  t,  t);
+		m.vertices[7]  = detail::make_vertex(1.0,  t, -t);
+		// Tip of the arrow
+		m.vertices[8]  = detail::make_vertex(1.0, -2.0 * t, -2.0 * t);
+		m.vertices[9]  = detail::make_vertex(1.0, -2.0 * t,  2.0 * t);
+		m.vertices[10] = detail::make_vertex(1.0,  2.0 * t,  2.0 * t);
+		m.vertices[11] = detail::make_vertex(1.0,  2.0 * t, -2.0 * t);
+		m.vertices[12] = detail::make_vertex(1.0 + 4.0 * t, 0.0, 0.0);
+
+		// Body: Left
+		detail::set_triangle(m,  0u,  0u,  1u,  2u);
+		detail::set_triangle(m,  1u,  0u,  2u,  3u);
+		// Body: Back
+		detail::set_triangle(m,  2u,  4u,  0u,  3u);
+		detail::set_triangle(m,  3u,  4u,  3u,  7u);
+		// Body: Bottom
+		detail::set_triangle(m,  4u,  0u,  4u,  5u);
+		detail::set_triangle(m,  5u,  0u,  5u,  1u);
+		// Body: Front
+		detail::set_triangle(m,  6u,  1u,  5u,  6u);
+		detail::set_triangle(m,  7u,  1u,  6u,  2u);
+		// Body: Top
+		detail::set_triangle(m,  8u,  2u,  6u,  7u);
+		detail::set_triangle(m,  9u,  2u,  7u,  3u);
+		// Tip: Left
+		detail::set_triangle(m, 10u,  8u,  9u, 10u);
+		detail::set_triangle(m, 11u,  8u, 10u, 11u);
+		// Tip: Back
+		detail::set_triangle(m, 12u, 12u,  8u, 11u);
+		// Tip: Bottom
+		detail::set_triangle(m, 13u,  8u, 12u,  9u);
+		// Tip: Front
+		detail::set_triangle(m, 14u,  9u, 12u, 10u);
+		// Tip: Top
+		detail::set_triangle(m, 15u, 10u, 12u, 11u);
+		return m;
+	}
+
+	//! \brief Upload positions and indices to OpenGL.
+	//!
+	//! @param [in] positions three floats per vertex
+	//! @param [in] vertices_nb the number of vertices
+	//! @param [in] indices three indices per triangle
+	//! @param [in] indices_nb the number of indices
+	//! @param [in] name name given to the mesh and its OpenGL objects
+	//! @return the resulting mesh, with only the vertices attribute
+	//!         enabled
+	mesh_data upload(float const* positions, std::size_t vertices_nb,
+	                 std::uint32_t const* indices, std::size_t indices_nb,
+	                 std::string const& name);
+
+	//! \brief Upload a compile-time generated mesh to OpenGL.
+	template<std::size_t VerticesNb, std::size_t IndicesNb>
+	mesh_data upload(mesh<VerticesNb, IndicesNb> const& m, std::string const& name)
+	{
+		static_assert(sizeof(vertex) == 3u * sizeof(float), "Vertices are expected to be tightly packed.");
+		return upload(&m.vertices[0].x, VerticesNb, m.indices, IndicesNb, name);
+	}
+}
+}
@@ -0,0 +1,242 @@
+#include "texture_arrays.hpp"
+
+#include "Log.h"
+#include "opengl.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+namespace
+{
+	std::uint32_t
+	nextPowerOfTwo(std::uint32_t value)
+	{
+		std::uint32_t power = 1u;
+		while (power < value)
+			power <<= 1u;
+		return power;
+	}
+
+	int
+	log2Floor(std::uint32_t value)
+	{
+		int result = 0;
+		while (value > 1u) {
+			value >>= 1u;
+			++result;
+		}
+		return result;
+	}
+
+	//! Bilinear resampling of an RGBA8 image; texel centres are mapped
+	//! onto each other, and the edges are clamped.
+	std::vector<std::uint8_t>
+	resampleImage(std::vector<std::uint8_t> const& source,
+	              std::uint32_t source_width, std::uint32_t source_height,
+	              std::uint32_t width, std::uint32_t height)
+	{
+		std::vector<std::uint8_t> resampled(static_cast<std::size_t>(width) * height * 4u);
+		auto const scale_x = static_cast<float>(source_width) / static_cast<float>(width);
+		auto const scale_y = static_cast<float>(source_height) / static_cast<float>(height);
+		for (std::uint32_t y = 0u; y < height; ++y) {
+			auto const source_y = std::max((static_cast<float>(y) + 0.5f) * scale_y - 0.5f, 0.0f);
+			auto const y0 = std::min(static_cast<std::uint32_t>(source_y), source_height - 1u);
+			auto const y1 = std::min(y0 + 1u, source_height - 1u);
+			auto const weight_y = source_y - static_cast<float>(y0);
+			for (std::uint32_t x = 0u; x < width; ++x) {
+				auto const source_x = std::max((static_cast<float>(x) + 0.5f) * scale_x - 0.5f, 0.0f);
+				auto const x0 = std::min(static_cast<std::uint32_t>(source_x), source_width - 1u);
+				auto const x1 = std::min(x0 + 1u, source_width - 1u);
+				auto const weight_x = source_x - static_cast<float>(x0);
+				auto const texel = [&source, source_width](std::uint32_t tx, std::uint32_t ty, std::uint32_t channel){
+					return static_cast<float>(source[4u * (static_cast<std::size_t>(ty) * source_width + tx) + channel]);
+				};
+				for (std::uint32_t channel = 0u; channel < 4u; ++channel) {
+					auto const top = texel(x0, y0, channel) * (1.0f - weight_x) + texel(x1, y0, channel) * weight_x;
+					auto const bottom = texel(x0, y1, channel) * (1.0f - weight_x) + texel(x1, y1, channel) * weight_x;
+					auto const value = top * (1.0f - weight_y) + bottom * weight_y;
+					resampled[4u * (static_cast<std::size_t>(y) * width + x) + channel] = static_cast<std::uint8_t>(std::lround(value));
+				}
+			}
+		}
+		return resampled;
+	}
+}
+
+std::uint32_t
+bonobo::texture_arrays::TextureArrayBuilder::add_image(std::vector<std::uint8_t> data,
+                                                       std::uint32_t width, std::uint32_t height)
+{
+	assert(data.size() == static_cast<std::size_t>(width) * height * 4u);
+
+	image queued;
+	queued.data = std::move(data);
+	queued.width = width;
+	queued.height = height;
+	_images.push_back(std::move(queued));
+
+	return static_cast<std::uint32_t>(_images.size() - 1u);
+}
+
+std::size_t
+bonobo::texture_arrays::TextureArrayBuilder::get_images_nb() const
+{
+	return _images.size();
+}
+
+std::vector<bonobo::texture_layer>
+bonobo::texture_arrays::TextureArrayBuilder::build(texture_array_set& set, bool generate_mipmap)
+{
+	std::vector<texture_layer> layers(_images.size());
+	if (_images.empty())
+		return layers;
+
+	if (set.arrays.size() >= max_arrays_nb) {
+		LogError("The set already holds %zu texture arrays, the maximum supported; the %zu queued images will **not** be uploaded, and their layers are left invalid.",
+		         set.arrays.size(), _images.size());
+		_images.clear();
+		return layers;
+	}
+	auto const available_arrays_nb = max_arrays_nb - set.arrays.size();
+
+	GLint max_texture_size = 0, max_layers_nb = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers_nb);
+
+	struct group {
+		std::uint32_t width;
+		std::uint32_t height;
+		std::vector<std::uint32_t> images;
+	};
+	std::vector<group> groups;
+	for (std::uint32_t i = 0u; i < _images.size(); ++i) {
+		auto const width = std::min(nextPowerOfTwo(_images[i].width), static_cast<std::uint32_t>(max_texture_size));
+		auto const height = std::min(nextPowerOfTwo(_images[i].height), static_cast<std::uint32_t>(max_texture_size));
+		auto it = std::find_if(groups.begin(), groups.end(), [width, height](group const& g){
+			return g.width == width && g.height == height;
+		});
+		if (it == groups.end()) {
+			groups.push_back({ width, height, {} });
+			it = groups.end() - 1;
+		}
+		it->images.push_back(i);
+	}
+
+	// Merge the groups with the fewest images into the ones closest in
+	// size. Only groups at least as large in both dimensions are
+	// considered when there are any, so that images get upscaled rather
+	// than lose details; otherwise, the closest group is used whatever
+	// its size.
+	while (groups.size() > available_arrays_nb) {
+		auto const smallest = std::min_element(groups.begin(), groups.end(), [](group const& lhs, group const& rhs){
+			return lhs.images.size() < rhs.images.size();
+		});
+		auto const distance = [&smallest](group const& g){
+			return std::abs(log2Floor(g.width) - log2Floor(smallest->width))
+			     + std::abs(log2Floor(g.height) - log2Floor(smallest->height));
+		};
+		auto const is_larger = [&smallest](group const& g){
+			return g.width >= smallest->width && g.height >= smallest->height;
+		};
+		auto const has_larger = std::any_of(groups.begin(), groups.end(), [&smallest, &is_larger](group const& g){
+			return &g != &*smallest && is_larger(g);
+		});
+		auto closest = groups.end();
+		for (auto it = groups.begin(); it != groups.end(); ++it) {
+			if (it == smallest || (has_larger && !is_larger(*it)))
+				continue;
+			if (closest == groups.end()
+			    || distance(*it) < distance(*closest)
+			    || (distance(*it) == distance(*closest) && it->width * it->height > closest->width * closest->height))
+				closest = it;
+		}
+		LogInfo("Resampling %zu %ux%u textures to %ux%u, to fit in %zu texture arrays.",
+		        smallest->images.size(), smallest->width, smallest->height,
+		        closest->width, closest->height, max_arrays_nb);
+		closest->images.insert(closest->images.end(), smallest->images.begin(), smallest->images.end());
+		groups.erase(smallest);
+	}
+
+	for (auto const& g : groups) {
+		auto images_nb = g.images.size();
+		if (images_nb > static_cast<std::size_t>(max_layers_nb)) {
+			LogError("%zu textures of %ux%u were loaded, but texture arrays can only hold %d layers; the remaining %zu will **not** be uploaded, and their layers are left invalid.",
+			         images_nb, g.width, g.height, max_layers_nb, images_nb - static_cast<std::size_t>(max_layers_nb));
+			images_nb = static_cast<std::size_t>(max_layers_nb);
+		}
+
+		texture_array array;
+		array.width = g.width;
+		array.height = g.height;
+		array.layers_nb = static_cast<std::uint32_t>(images_nb);
+		auto const array_index = static_cast<std::uint32_t>(set.arrays.size());
+
+		glGenTextures(1, &array.texture);
+		assert(array.texture != 0u);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+		             static_cast<GLsizei>(array.width), static_cast<GLsizei>(array.height), static_cast<GLsizei>(array.layers_nb),
+		             0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		for (std::size_t l = 0u; l < g.images.size(); ++l) {
+			auto const image_index = g.images[l];
+			auto& source = _images[image_index];
+			if (l >= images_nb) {
+				std::vector<std::uint8_t>().swap(source.data);
+				continue;
+			}
+			auto const layer = static_cast<std::uint32_t>(l);
+			layers[image_index].array_index = array_index;
+			layers[image_index].layer = layer;
+			layers[image_index].is_valid = true;
+
+			auto const is_resampled = source.width != array.width || source.height != array.height;
+			auto const resampled = is_resampled
+			                     ? resampleImage(source.data, source.width, source.height, array.width, array.height)
+			                     : std::vector<std::uint8_t>();
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+			                static_cast<GLsizei>(array.width), static_cast<GLsizei>(array.height), 1,
+			                GL_RGBA, GL_UNSIGNED_BYTE,
+			                reinterpret_cast<GLvoid const*>(is_resampled ? resampled.data() : source.data.data()));
+
+			// Images can take a lot of memory, so let them go as soon as
+			// they are uploaded.
+			std::vector<std::uint8_t>().swap(source.data);
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, generate_mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if (generate_mipmap)
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0u);
+
+		utils::opengl::debug::nameObject(GL_TEXTURE, array.texture,
+		                                 "Texture array " + std::to_string(array.width) + "x" + std::to_string(array.height));
+		LogTrivia("Texture array %u: %u layers of %ux%u", array_index, array.layers_nb, array.width, array.height);
+
+		set.arrays.push_back(array);
+	}
+
+	_images.clear();
+	return layers;
+}
+
+void
+bonobo::texture_arrays::destroyTextureArraySet(texture_array_set& set)
+{
+	for (auto& array : set.arrays)
+		glDeleteTextures(1, &array.texture);
+	set = texture_array_set();
+}
+
+void
+bonobo::texture_arrays::bindTextureArrays(texture_array_set const& set, GLuint first_unit)
+{
+	for (std::size_t i = 0u; i < set.arrays.size(); ++i) {
+		glActiveTexture(GL_TEXTURE0 + first_unit + static_cast<GLenum>(i));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, set.arrays[i].texture);
+	}
+	glActiveTexture(GL_TEXTURE0);
+}
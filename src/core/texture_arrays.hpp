@@ -0,0 +1,98 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Textures of a whole scene grouped into a few 2D texture arrays,
+//!        so that all of them can stay bound while drawing it.
+//!
+//! Images are decoded to RGBA8, and grouped by size, non power-of-two
+//! ones being resampled up to the next power of two first. When more
+//! than |max_arrays_nb| sizes remain, the smallest groups get resampled
+//! to the closest size among the others.
+//!
+//! Shaders declare the arrays as
+//!
+//!     uniform sampler2DArray texture_arrays[8];
+//!
+//! and find the layer of each texture through a `texture_layer`, packed
+//! as `(array_index << 16) | layer` in the `texture_layers` of the
+//! material buffer (see `materials.hpp`); indexing `texture_arrays` that
+//! way is allowed as long as the index only depends on uniforms.
+//!
+//! Hand-written draw loops bind all arrays once with
+//! `bindTextureArrays()`; nodes get them through
+//! `Node::add_texture_arrays()`, and the layers from their geometry.
+namespace bonobo
+{
+namespace texture_arrays
+{
+	constexpr std::size_t max_arrays_nb = 8u;
+
+	//! \brief One array, holding all images of a given size.
+	struct texture_array {
+		GLuint texture{0u};          //!< OpenGL name of the GL_TEXTURE_2D_ARRAY texture
+		std::uint32_t width{0u};
+		std::uint32_t height{0u};
+		std::uint32_t layers_nb{0u};
+	};
+
+	//! \brief All arrays of a scene; meshes refer to them by index.
+	struct texture_array_set {
+		std::vector<texture_array> arrays{};
+	};
+
+	//! \brief Collects images while a scene gets loaded, and uploads them
+	//!        all at once, when their sizes are known.
+	//!
+	//! All images are kept in memory until `build()` is called.
+	class TextureArrayBuilder
+	{
+	public:
+		//! \brief Queue an image.
+		//!
+		//! @param [in] data RGBA8 texels, stored row by row
+		//! @return an identifier for the image, to look up where it
+		//!         ended in the result of `build()`
+		std::uint32_t add_image(std::vector<std::uint8_t> data,
+		                        std::uint32_t width, std::uint32_t height);
+
+		std::size_t get_images_nb() const;
+
+		//! \brief Group the queued images into arrays, and upload them.
+		//!
+		//! The builder is left empty afterwards.
+		//!
+		//! @param [out] set where to add the arrays; its existing arrays
+		//!              are kept, and the new ones appended
+		//! @param [in] generate_mipmap whether to generate a mipmap
+		//!             hierarchy for each array
+		//! @return the layer of each image, indexed by the identifiers
+		//!         returned by `add_image()`; they are all invalid if
+		//!         |set| already holds |max_arrays_nb| arrays
+		std::vector<texture_layer> build(texture_array_set& set,
+		                                 bool generate_mipmap = true);
+
+	private:
+		struct image {
+			std::vector<std::uint8_t> data;
+			std::uint32_t width;
+			std::uint32_t height;
+		};
+
+		std::vector<image> _images;
+	};
+
+	//! \brief Release the OpenGL objects of all arrays of a set.
+	void destroyTextureArraySet(texture_array_set& set);
+
+	//! \brief Bind the arrays of |set| to consecutive texture units,
+	//!        starting at |first_unit|.
+	void bindTextureArrays(texture_array_set const& set, GLuint first_unit);
+}
+}
@@ -0,0 +1,296 @@
+#include "transform_hierarchy.hpp"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <utility>
+
+namespace
+{
+	// Composing a world matrix only takes a few dozen nanoseconds, so
+	// threads are only worth spawning for thousands of nodes.
+	constexpr std::size_t min_nodes_per_thread = 4096u;
+
+	template<typename T>
+	void
+	permute(std::vector<T>& values, std::vector<std::uint32_t> const& order)
+	{
+		std::vector<T> permuted;
+		permuted.reserve(values.size());
+		for (auto const old_slot : order)
+			permuted.push_back(values[old_slot]);
+		values = std::move(permuted);
+	}
+}
+
+TransformHierarchy::handle
+TransformHierarchy::add_node(handle parent, TRSTransformf const& local)
+{
+	if (parent != no_parent && parent >= _slots.size()) {
+		LogError("Invalid parent handle %u: only %zu nodes exist; the node will **not** be added.",
+		         parent, _slots.size());
+		return no_parent;
+	}
+
+	auto const node = static_cast<handle>(_slots.size());
+	auto const slot = static_cast<std::uint32_t>(_handles.size());
+	auto const parent_slot = parent != no_parent ? static_cast<std::int32_t>(_slots[parent]) : -1;
+
+	_slots.push_back(slot);
+	_handles.push_back(node);
+	_parents.push_back(parent_slot);
+	_subtree_ends.push_back(slot + 1u);
+	_translations.push_back(local.GetTranslation());
+	_rotations.push_back(local.GetRotation());
+	_scales.push_back(local.GetScale());
+	_world_matrices.emplace_back(1.0f);
+
+	if (parent_slot < 0 || _needs_reordering)
+		return node;
+
+	// Appending a node keeps the pre-order only if its parent's subtree
+	// was the last one; all its ancestors then end there as well.
+	if (_subtree_ends[parent_slot] != slot) {
+		_needs_reordering = true;
+		return node;
+	}
+	for (auto ancestor = parent_slot; ancestor >= 0; ancestor = _parents[ancestor])
+		_subtree_ends[ancestor] = slot + 1u;
+
+	return node;
+}
+
+std::size_t
+TransformHierarchy::get_nodes_nb() const
+{
+	return _handles.size();
+}
+
+void
+TransformHierarchy::set_local_transform(handle node, TRSTransformf const& local)
+{
+	assert(node < _slots.size());
+	auto const slot = _slots[node];
+	_translations[slot] = local.GetTranslation();
+	_rotations[slot] = local.GetRotation();
+	_scales[slot] = local.GetScale();
+}
+
+void
+TransformHierarchy::set_translation(handle node, glm::vec3 const& translation)
+{
+	assert(node < _slots.size());
+	_translations[_slots[node]] = translation;
+}
+
+void
+TransformHierarchy::set_rotation(handle node, glm::mat3 const& rotation)
+{
+	assert(node < _slots.size());
+	_rotations[_slots[node]] = rotation;
+}
+
+void
+TransformHierarchy::set_scale(handle node, glm::vec3 const& scale)
+{
+	assert(node < _slots.size());
+	_scales[_slots[node]] = scale;
+}
+
+glm::vec3 const&
+TransformHierarchy::get_translation(handle node) const
+{
+	assert(node < _slots.size());
+	return _translations[_slots[node]];
+}
+
+glm::mat3 const&
+TransformHierarchy::get_rotation(handle node) const
+{
+	assert(node < _slots.size());
+	return _rotations[_slots[node]];
+}
+
+glm::vec3 const&
+TransformHierarchy::get_scale(handle node) const
+{
+	assert(node < _slots.size());
+	return _scales[_slots[node]];
+}
+
+glm::mat4 const&
+TransformHierarchy::get_world_matrix(handle node) const
+{
+	assert(node < _slots.size());
+	return _world_matrices[_slots[node]];
+}
+
+void
+TransformHierarchy::update_world_matrices(glm::mat4 const& root_transform)
+{
+	if (_needs_reordering)
+		reorder();
+
+	auto const nodes_nb = static_cast<std::uint32_t>(_handles.size());
+	auto const max_useful_threads_nb = nodes_nb / min_nodes_per_thread;
+	if (max_useful_threads_nb <= 1u) {
+		update_range(0u, nodes_nb, root_transform);
+		return;
+	}
+
+	auto const hardware_threads_nb = std::max(std::thread::hardware_concurrency(), 1u);
+	auto const threads_nb = std::min<std::size_t>(hardware_threads_nb, max_useful_threads_nb);
+	auto const nodes_per_thread = static_cast<std::uint32_t>(nodes_nb / threads_nb);
+
+	// Nodes whose subtree is larger than what one thread should take
+	// are updated right away; the remaining subtrees only depend on them,
+	// and are grouped into batches of consecutive slots.
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> batches;
+	std::uint32_t batch_first = 0u;
+	std::uint32_t slot = 0u;
+	while (slot < nodes_nb) {
+		auto const subtree_end = _subtree_ends[slot];
+		if (subtree_end - slot > nodes_per_thread) {
+			if (batch_first < slot)
+				batches.emplace_back(batch_first, slot);
+			update_range(slot, slot + 1u, root_transform);
+			batch_first = ++slot;
+			continue;
+		}
+
+		slot = subtree_end;
+		if (slot - batch_first >= nodes_per_thread) {
+			batches.emplace_back(batch_first, slot);
+			batch_first = slot;
+		}
+	}
+	if (batch_first < nodes_nb)
+		batches.emplace_back(batch_first, nodes_nb);
+	if (batches.empty())
+		return;
+
+	// Large nodes split the batches, so shapes like a long chain with a
+	// leaf on each link produce many small ones: consecutive batches are
+	// handed out together, each worker getting its share of the nodes,
+	// so that there are never more than |threads_nb| workers.
+	std::size_t batched_nodes_nb = 0u;
+	for (auto const& batch : batches)
+		batched_nodes_nb += batch.second - batch.first;
+	auto const nodes_per_worker = (batched_nodes_nb + threads_nb - 1u) / threads_nb;
+	std::vector<std::pair<std::size_t, std::size_t>> workloads; // ranges of batches
+	workloads.reserve(threads_nb);
+	std::size_t workload_first = 0u;
+	std::size_t workload_nodes_nb = 0u;
+	for (std::size_t b = 0u; b < batches.size(); ++b) {
+		workload_nodes_nb += batches[b].second - batches[b].first;
+		if (workload_nodes_nb >= nodes_per_worker) {
+			workloads.emplace_back(workload_first, b + 1u);
+			workload_first = b + 1u;
+			workload_nodes_nb = 0u;
+		}
+	}
+	if (workload_first < batches.size())
+		workloads.emplace_back(workload_first, batches.size());
+	assert(workloads.size() <= threads_nb);
+
+	auto const update_batches = [this, &batches, &root_transform](std::size_t first, std::size_t end){
+		for (auto b = first; b < end; ++b)
+			update_range(batches[b].first, batches[b].second, root_transform);
+	};
+
+	// The calling thread takes care of the last workload itself.
+	std::vector<std::thread> workers;
+	workers.reserve(workloads.size() - 1u);
+	for (std::size_t w = 0u; w + 1u < workloads.size(); ++w)
+		workers.emplace_back(update_batches, workloads[w].first, workloads[w].second);
+	update_batches(workloads.back().first, workloads.back().second);
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void
+TransformHierarchy::reorder()
+{
+	auto const nodes_nb = static_cast<std::uint32_t>(_handles.size());
+
+	// Children of each node, kept in slot order; roots are listed as the
+	// children of a virtual node placed at the end.
+	std::vector<std::uint32_t> children_offsets(nodes_nb + 2u, 0u);
+	for (auto const parent : _parents)
+		++children_offsets[(parent >= 0 ? static_cast<std::uint32_t>(parent) : nodes_nb) + 1u];
+	for (std::uint32_t i = 1u; i < children_offsets.size(); ++i)
+		children_offsets[i] += children_offsets[i - 1u];
+	std::vector<std::uint32_t> children(nodes_nb);
+	{
+		auto next_child = children_offsets;
+		for (std::uint32_t slot = 0u; slot < nodes_nb; ++slot) {
+			auto const parent = _parents[slot] >= 0 ? static_cast<std::uint32_t>(_parents[slot]) : nodes_nb;
+			children[next_child[parent]++] = slot;
+		}
+	}
+
+	// Depth-first traversal; children are pushed in reverse so that they
+	// get visited in slot order.
+	std::vector<std::uint32_t> order;
+	order.reserve(nodes_nb);
+	std::vector<std::uint32_t> stack;
+	stack.reserve(nodes_nb);
+	for (auto c = children_offsets[nodes_nb + 1u]; c > children_offsets[nodes_nb]; --c)
+		stack.push_back(children[c - 1u]);
+	while (!stack.empty()) {
+		auto const slot = stack.back();
+		stack.pop_back();
+		order.push_back(slot);
+		for (auto c = children_offsets[slot + 1u]; c > children_offsets[slot]; --c)
+			stack.push_back(children[c - 1u]);
+	}
+	assert(order.size() == nodes_nb);
+
+	std::vector<std::uint32_t> new_slots(nodes_nb);
+	for (std::uint32_t new_slot = 0u; new_slot < nodes_nb; ++new_slot)
+		new_slots[order[new_slot]] = new_slot;
+
+	permute(_handles, order);
+	permute(_parents, order);
+	permute(_translations, order);
+	permute(_rotations, order);
+	permute(_scales, order);
+	permute(_world_matrices, order);
+	for (auto& parent : _parents)
+		if (parent >= 0)
+			parent = static_cast<std::int32_t>(new_slots[parent]);
+	for (std::uint32_t new_slot = 0u; new_slot < nodes_nb; ++new_slot)
+		_slots[_handles[new_slot]] = new_slot;
+
+	// Children come after their parents, so walking backwards grows each
+	// subtree with the ones of its children before it is used.
+	for (std::uint32_t slot = 0u; slot < nodes_nb; ++slot)
+		_subtree_ends[slot] = slot + 1u;
+	for (auto slot = nodes_nb; slot > 0u; --slot) {
+		auto const parent = _parents[slot - 1u];
+		if (parent >= 0)
+			_subtree_ends[parent] = std::max(_subtree_ends[parent], _subtree_ends[slot - 1u]);
+	}
+
+	_needs_reordering = false;
+}
+
+void
+TransformHierarchy::update_range(std::uint32_t first, std::uint32_t end,
+                                 glm::mat4 const& root_transform)
+{
+	for (auto slot = first; slot < end; ++slot) {
+		// Same as TRSTransform::GetMatrix(), i.e. T * R * S.
+		auto const& rotation = _rotations[slot];
+		auto const& scale = _scales[slot];
+		glm::mat4 const local(glm::vec4(rotation[0] * scale.x, 0.0f),
+		                      glm::vec4(rotation[1] * scale.y, 0.0f),
+		                      glm::vec4(rotation[2] * scale.z, 0.0f),
+		                      glm::vec4(_translations[slot], 1.0f));
+
+		auto const parent = _parents[slot];
+		_world_matrices[slot] = (parent >= 0 ? _world_matrices[parent] : root_transform) * local;
+	}
+}
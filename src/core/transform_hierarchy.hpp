@@ -0,0 +1,78 @@
+#pragma once
+
+#include "TRSTransform.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! \brief Flattened hierarchy of transforms, with their local parts and
+//!        world matrices each stored contiguously.
+//!
+//! Nodes are kept sorted in depth-first pre-order, so that parents always
+//! come before their children and the descendants of a node follow it
+//! contiguously. World matrices are then computed in a single linear
+//! pass, and independent subtrees spread over several threads when there
+//! are enough of them.
+//!
+//! Nodes are referred to by handles which stay valid when the nodes get
+//! reordered.
+class TransformHierarchy
+{
+public:
+	using handle = std::uint32_t;
+	static constexpr handle no_parent = ~handle(0u);
+
+	//! \brief Add a node under |parent|, or as a root if |parent| is
+	//!        |no_parent|.
+	//!
+	//! @return a handle to the new node, or |no_parent| if |parent| is
+	//!         not a valid handle
+	handle add_node(handle parent, TRSTransformf const& local = TRSTransformf());
+
+	std::size_t get_nodes_nb() const;
+
+	void set_local_transform(handle node, TRSTransformf const& local);
+	void set_translation(handle node, glm::vec3 const& translation);
+	void set_rotation(handle node, glm::mat3 const& rotation);
+	void set_scale(handle node, glm::vec3 const& scale);
+
+	glm::vec3 const& get_translation(handle node) const;
+	glm::mat3 const& get_rotation(handle node) const;
+	glm::vec3 const& get_scale(handle node) const;
+
+	//! \brief Matrix from the local space of |node| to world space, as of
+	//!        the last call to `update_world_matrices()`.
+	glm::mat4 const& get_world_matrix(handle node) const;
+
+	//! \brief Recompute all world matrices.
+	//!
+	//! @param [in] root_transform transform applied on top of all roots
+	void update_world_matrices(glm::mat4 const& root_transform = glm::mat4(1.0f));
+
+private:
+	//! \brief Sort all nodes back in depth-first pre-order, after nodes
+	//!        were added out of order.
+	void reorder();
+
+	//! \brief Compute the world matrices of the nodes in [first, end),
+	//!        whose parents (outside that range) are already up to date.
+	void update_range(std::uint32_t first, std::uint32_t end,
+	                  glm::mat4 const& root_transform);
+
+	// Indexed by handle
+	std::vector<std::uint32_t> _slots;        //!< where each node is stored
+
+	// Indexed by slot
+	std::vector<handle> _handles;
+	std::vector<std::int32_t> _parents;       //!< slot of each node's parent, or -1 for roots
+	std::vector<std::uint32_t> _subtree_ends; //!< one past the slot of the last descendant of each node
+	std::vector<glm::vec3> _translations;
+	std::vector<glm::mat3> _rotations;
+	std::vector<glm::vec3> _scales;
+	std::vector<glm::mat4> _world_matrices;
+
+	bool _needs_reordering{false};
+};